@@ -0,0 +1,131 @@
+// Measures how fast Generator writes an output file.
+// The input is a 100 MB data section with a small code section. The
+// Generator, both buffered and with a mapped output, is compared against
+// writing the same bytes one at a time through an fstream, which is how the
+// output used to be emitted.
+//
+// Build with optimizations for meaningful numbers:
+//   make clean && make bench flags=-O2
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <output_gen.hpp>
+
+static constexpr size_t DATA_LEN = 100 * 1024 * 1024;
+static constexpr size_t INSTRUCTIONS = 100000;
+static constexpr int RUNS = 3;
+
+template <typename F> static double best_of(F f) {
+  double best = 1e30;
+  for (int i = 0; i < RUNS; i++) {
+    auto st = std::chrono::steady_clock::now();
+    if (!f())
+      return -1;
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - st;
+    if (d.count() < best)
+      best = d.count();
+  }
+  return best;
+}
+
+static void put_bytewise(std::fstream &file, uint64_t v) {
+  for (size_t i = 0; i < 8; i++, v >>= 8)
+    file << (uint8_t)v;
+}
+
+// The output written byte by byte, as it was before the buffered Generator
+static bool emit_bytewise(masm::GeneratorDetails &d) {
+  std::fstream file(d.output_file_path, std::ios::out | std::ios::binary);
+  if (!file.is_open())
+    return false;
+  file << 'b' << 'e' << 'b' << (unsigned char)(d.type) << (char)0 << (char)0
+       << (char)0 << (char)0;
+  put_bytewise(file, d.instructions.size() * ITIT_HEADER_LEN);
+  put_bytewise(file, d.rodata.size());
+  put_bytewise(file, d.data.size());
+  put_bytewise(file, d.string.size());
+  put_bytewise(file, d.bss_section_length);
+  put_bytewise(file, 0);
+  for (auto I : d.instructions) {
+    put_bytewise(file, (uint64_t)I.first);
+    put_bytewise(file, (I.second.size() + 1) * 8);
+  }
+  uint64_t bef = d.entry_inst.whole_word;
+  for (auto I : d.instructions) {
+    put_bytewise(file, bef);
+    for (auto i : I.second)
+      put_bytewise(file, i.whole_word);
+    bef = 0;
+  }
+  for (auto i : d.rodata)
+    file << i;
+  for (auto i : d.data)
+    file << i;
+  for (auto i : d.string)
+    file << i;
+  return true;
+}
+
+static bool emit(masm::GeneratorDetails &d) {
+  masm::Generator gen(d);
+  return gen.pre_emission() && gen.emit_header() && gen.emit_ITIT() &&
+         gen.emit_Instructions() && gen.emit_rodata_section() &&
+         gen.emit_data_section() &&
+         gen.emit_string_section() && gen.write_out();
+}
+
+static bool same_contents(const std::string &p1, const std::string &p2) {
+  if (std::filesystem::file_size(p1) != std::filesystem::file_size(p2))
+    return false;
+  std::ifstream a(p1, std::ios::binary), b(p2, std::ios::binary);
+  return std::equal(std::istreambuf_iterator<char>(a),
+                    std::istreambuf_iterator<char>(),
+                    std::istreambuf_iterator<char>(b));
+}
+
+int main() {
+  std::filesystem::path dir = std::filesystem::temp_directory_path();
+  std::vector<uint8_t> data(DATA_LEN), string(4096, 'x');
+  for (size_t i = 0; i < DATA_LEN; i++)
+    data[i] = (uint8_t)(i * 31);
+  std::vector<masm::Inst64> code(INSTRUCTIONS);
+  for (size_t i = 0; i < INSTRUCTIONS; i++)
+    code[i].whole_word = i * 0x0101010101010101;
+
+  masm::GeneratorDetails d;
+  d.data = data;
+  d.string = string;
+  d.instructions.push_back({masm::GPC, code});
+
+  d.output_file_path = dir / "masm_emit_bench_old.mbin";
+  double old_t = best_of([&] { return emit_bytewise(d); });
+  std::string old_path = d.output_file_path;
+  d.output_file_path = dir / "masm_emit_bench.mbin";
+  double new_t = best_of([&] { return emit(d); });
+  std::string new_path = d.output_file_path;
+  d.output_file_path = dir / "masm_emit_bench_mapped.mbin";
+  d.mapped_output = true;
+  double mapped_t = best_of([&] { return emit(d); });
+  std::string mapped_path = d.output_file_path;
+
+  bool same = same_contents(old_path, new_path) &&
+              same_contents(old_path, mapped_path);
+  std::filesystem::remove(old_path);
+  std::filesystem::remove(new_path);
+  std::filesystem::remove(mapped_path);
+  if (old_t < 0 || new_t < 0 || mapped_t < 0 || !same) {
+    fprintf(stderr, "The two outputs differ or could not be written\n");
+    return 1;
+  }
+
+  double mb = (DATA_LEN + INSTRUCTIONS * 8) / 1048576.0;
+  printf("emit_bench: %.1f MB\n", mb);
+  printf("  byte at a time %8.2f ms  %8.1f MB/s\n", old_t * 1e3, mb / old_t);
+  printf("  buffered       %8.2f ms  %8.1f MB/s\n", new_t * 1e3, mb / new_t);
+  printf("  mapped         %8.2f ms  %8.1f MB/s\n", mapped_t * 1e3,
+         mb / mapped_t);
+  return 0;
+}
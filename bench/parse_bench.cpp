@@ -0,0 +1,86 @@
+// Measures how fast GPCParser turns a file into nodes.
+// A synthetic file of 1M instructions covering every operand shape is
+// written to the temporary directory and parsed a few times; the best run
+// is reported. Lexing is timed on its own so that it can be told apart from
+// building the nodes.
+//
+// Build with optimizations for meaningful numbers:
+//   make clean && make bench flags=-O2
+
+#include <arena.hpp>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <gpc_parser.hpp>
+#include <lexer.hpp>
+#include <source_file.hpp>
+#include <symboltable.hpp>
+
+static const char *statements[] = {
+    "mov r0, 10",         "add r1, r2",      "add r1, 5",
+    "movb r0, r1",        "inc r2",          "push r3",
+    "nop",                "jmp top",         "jz top",
+    "lea r0, r1, r2, r3", "cmp r0, counter", "loadq r4, counter",
+    "sout msg",           "fadd r5, r6",     "ret",
+};
+
+static constexpr size_t INSTRUCTIONS = 1000000;
+static constexpr int RUNS = 5;
+
+static void write_input(const std::filesystem::path &p) {
+  std::ofstream out(p);
+  out << "counter: dq 0\nmsg: ds \"hello\"\ntop:\n";
+  size_t n = sizeof(statements) / sizeof(statements[0]);
+  for (size_t i = 0; i < INSTRUCTIONS; i++)
+    out << statements[i % n] << '\n';
+}
+
+template <typename F> static double best_of(F f) {
+  double best = 1e30;
+  for (int i = 0; i < RUNS; i++) {
+    auto st = std::chrono::steady_clock::now();
+    if (!f())
+      return -1;
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - st;
+    if (d.count() < best)
+      best = d.count();
+  }
+  return best;
+}
+
+int main() {
+  std::filesystem::path p =
+      std::filesystem::temp_directory_path() / "masm_parse_bench.gpc.masm";
+  write_input(p);
+
+  masm::SourceFile src(p, 0);
+  if (!src.open())
+    return 1;
+  masm::SymbolTable symtable;
+
+  double lex = best_of([&] {
+    masm::TokenStream tokens;
+    masm::Lexer lexer(src, symtable.get_interner());
+    return lexer.tokenize(tokens);
+  });
+  double parse = best_of([&] {
+    masm::Arena arena;
+    masm::GPCParser parser(src, symtable, arena);
+    return parser.parse() && parser.getNodes().size() == INSTRUCTIONS + 3;
+  });
+  std::filesystem::remove(p);
+  if (lex < 0 || parse < 0) {
+    fprintf(stderr, "The benchmark input failed to parse\n");
+    return 1;
+  }
+
+  printf("parse_bench: %zu instructions, %zu bytes\n", INSTRUCTIONS,
+         src.length());
+  printf("  lex only      %8.2f ms\n", lex * 1e3);
+  printf("  lex + parse   %8.2f ms  %8.2f M instructions/s\n", parse * 1e3,
+         INSTRUCTIONS / parse / 1e6);
+  printf("  parse only    %8.2f ms  %8.2f M instructions/s\n",
+         (parse - lex) * 1e3, INSTRUCTIONS / (parse - lex) / 1e6);
+  return 0;
+}
@@ -0,0 +1,67 @@
+// Measures the peak memory of assembling a file with a large reservation.
+// Every run assembles in a child process so that its peak RSS can be read
+// on its own. The peak of a file without it is subtracted to get what the
+// reservation itself costs. Reservations are in the BSS section and only
+// take address space so that should be next to nothing.
+//
+// Build with optimizations for meaningful numbers:
+//   make clean && make bench flags=-O2
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <masm_context.hpp>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr size_t DATA_LEN = 100 * 1024 * 1024;
+
+// Peak RSS of assembling 'input', in bytes; -1 on failure
+static long peak_rss(const std::filesystem::path &dir, const char *input,
+                     bool mapped) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (chdir(dir.c_str()) != 0)
+      _exit(1);
+    const char *argv[] = {"masm", "-f", input, "-o", "out.mbin", "--mmap"};
+    masm::MasmContext context(mapped ? 6 : 5, (char **)argv);
+    _exit(context.prepare_for_assembling() && context.assemble() &&
+                  context.prepare_for_emiting() && context.emit()
+              ? 0
+              : 1);
+  }
+  int status;
+  struct rusage usage;
+  if (pid == -1 || wait4(pid, &status, 0, &usage) != pid ||
+      !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    return -1;
+  return usage.ru_maxrss * 1024;
+}
+
+int main() {
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() / "masm_rss_bench";
+  std::filesystem::create_directories(dir);
+  std::ofstream(dir / "big.gpc.masm")
+      << "big: resq " << DATA_LEN / 8 << "\nmain:\n hlt\n";
+  std::ofstream(dir / "empty.gpc.masm") << "main:\n hlt\n";
+
+  long base = peak_rss(dir, "empty.gpc.masm", false);
+  long buffered = peak_rss(dir, "big.gpc.masm", false);
+  long mapped = peak_rss(dir, "big.gpc.masm", true);
+  std::filesystem::remove_all(dir);
+  if (base < 0 || buffered < 0 || mapped < 0) {
+    fprintf(stderr, "Assembling the benchmark input failed\n");
+    return 1;
+  }
+
+  double mb = DATA_LEN / 1048576.0;
+  printf("rss_bench: %.1f MB reservation, %.1f MB baseline\n", mb,
+         base / 1048576.0);
+  printf("  buffered       %8.1f MB  %5.2f copies of the reservation\n",
+         (buffered - base) / 1048576.0, (double)(buffered - base) / DATA_LEN);
+  printf("  mapped         %8.1f MB  %5.2f copies of the reservation\n",
+         (mapped - base) / 1048576.0, (double)(mapped - base) / DATA_LEN);
+  return 0;
+}
@@ -5,21 +5,33 @@
 #include <vector>
 
 namespace masm {
+// What tree shaking removed, for the report
+struct ShakeReport {
+  struct Removed {
+    uint32_t name; // NO_ID for the code before the first label
+    uint64_t size; // in bytes
+  };
+  std::vector<Removed> procedures, variables;
+};
+
 class Analyzer {
 public:
   Analyzer() = default;
 
   virtual ~Analyzer() = default;
 
-  virtual void set_nodes(std::vector<Node> &&nodes) = 0;
+  virtual void set_nodes(NodeList &&nodes) = 0;
 
-  virtual std::vector<Node> get_result() = 0;
+  virtual NodeList get_result() = 0;
 
   virtual bool first_loop() = 0;
 
   virtual bool first_loop_second_phase() = 0;
 
   virtual bool second_loop() = 0;
+
+  // Drop everything main can't reach(after second_loop)
+  virtual void shake(ShakeReport &report) = 0;
 };
 }; // namespace masm
 
@@ -4,33 +4,32 @@
 #include <algorithm>
 #include <analyzer_base.hpp>
 #include <array>
+#include <gpc_gen_base.hpp>
 #include <nodes.hpp>
+#include <source_file.hpp>
 #include <string>
 #include <symboltable.hpp>
+#include <utils.hpp>
 #include <unordered_map>
 #include <unordered_set>
-#include <utils.hpp>
 #include <vector>
 
 namespace masm {
 class GPCAnalyzer : public Analyzer {
-  std::vector<Node> nodes;
-  std::unordered_map<std::string, std::pair<value_t, std::string>> &consts;
-  std::unordered_set<std::string> &labels;
-  SymbolTable &symtable;
+  NodeList nodes;
+  SymbolTable &symtable; // constants, labels and variables
+  FileTable &files;      // for diagnostics
 
   // Result of analysis
-  std::vector<Node> result;
+  NodeList result;
 
 public:
-  GPCAnalyzer(
-      std::unordered_map<std::string, std::pair<value_t, std::string>> &c,
-      std::unordered_set<std::string> &l, SymbolTable &s);
+  GPCAnalyzer(SymbolTable &s, FileTable &f, Arena &arena);
 
   // bool analyze();
-  void set_nodes(std::vector<Node> &&nodes) override;
+  void set_nodes(NodeList &&nodes) override;
 
-  std::vector<Node> get_result() override;
+  NodeList get_result() override;
 
   bool first_loop() override;
 
@@ -38,22 +37,24 @@ public:
 
   bool second_loop() override;
 
+  void shake(ShakeReport &report) override;
+
   bool validate_defined_variables(Node &n);
 
   bool validate_reserved_variables(Node &n);
 
-  std::pair<bool, std::pair<value_t, std::string>>
-  resolve_if_constant(std::string name, std::vector<value_t> expected);
+  std::pair<bool, Constant>
+  resolve_if_constant(uint32_t name, const std::vector<value_t> &expected);
 
-  bool resolve_variable(std::string name, std::vector<data_t> expected);
+  bool resolve_variable(uint32_t name, const std::vector<data_t> &expected);
 
   bool analyze_stack_based_instructions(Node &n, data_t expected,
-                                        std::vector<value_t> vtlist);
+                                        const std::vector<value_t> &vtlist);
 
   bool analyze_load_store_instructions(Node &n, data_t expected);
 
-  bool analyze_instructions_with_only_const_imm(Node &n,
-                                                std::vector<value_t> expected);
+  bool analyze_instructions_with_only_const_imm(
+      Node &n, const std::vector<value_t> &expected);
 };
 }; // namespace masm
 
@@ -0,0 +1,135 @@
+#ifndef _GPC_CFG_
+#define _GPC_CFG_
+
+#include <cstdint>
+#include <nodes.hpp>
+#include <string>
+#include <symboltable.hpp>
+#include <vector>
+
+namespace masm {
+// A set of the 16 GPC registers; bit 0 is R0, then R1..R12, SP, BP and ACC
+typedef uint16_t RegSet;
+
+static constexpr RegSet ALL_REGS = 0xFFFF;
+
+RegSet register_bit(token_t reg);
+
+// What an instruction does to the registers. 'kill' are the ones written
+// in full; a partial or conditional write is in 'def' and 'use' both.
+struct RegEffect {
+  RegSet use = 0;
+  RegSet def = 0;
+  RegSet kill = 0;
+};
+
+RegEffect register_effect(Node &n);
+
+// Whether the only effect of the node is writing what register_effect
+// says it defines(no memory, flags or control flow)
+bool only_writes_registers(Node &n);
+
+struct BasicBlock {
+  size_t begin = 0, end = 0; // the nodes in it, [begin, end)
+  std::vector<uint32_t> labels;
+  std::vector<size_t> succ, pred;
+  bool entry = false; // control may come from where the graph doesn't show
+  bool exit = false;  // control may go where the graph doesn't show
+};
+
+// The blocks of straight line code in the nodes and how control goes
+// between them. A block starts at a label and ends after a jump,
+// conditional jump, loop, call, ret* or hlt. Calls fall through to the
+// next block; what they call is an entry.
+class CFG {
+  NodeList &nodes;
+  SymbolTable &symtable;
+
+public:
+  std::vector<BasicBlock> blocks;
+
+  CFG(NodeList &nodes, SymbolTable &symtable);
+
+  // DOT, or JSON if 'path' ends with ".json". Every block is given with
+  // its liveness and the definitions reaching it.
+  bool export_to(const std::string &path);
+};
+
+// Solves a dataflow problem over 'cfg' with a worklist until nothing
+// changes. 'P' describes the problem:
+//   Value                    what is known at a point
+//   backward                 whether it flows against control
+//   initial()                the value everywhere to begin with
+//   boundary()               where control enters(leaves when backward)
+//   meet(Value &a, b)        'b' joins 'a'
+//   transfer(block, v)       'v' carried through the block
+// 'in' and 'out' are at the start and end of every block.
+template <typename P> struct Dataflow {
+  std::vector<typename P::Value> in, out;
+};
+
+template <typename P> Dataflow<P> solve(CFG &cfg, P &p) {
+  size_t count = cfg.blocks.size();
+  Dataflow<P> r{std::vector<typename P::Value>(count, p.initial()),
+                std::vector<typename P::Value>(count, p.initial())};
+  // The first block to come off is the first in the direction of flow
+  std::vector<size_t> work;
+  for (size_t b = 0; b < count; b++)
+    work.push_back(P::backward ? b : count - b - 1);
+  std::vector<bool> queued(count, true);
+  while (!work.empty()) {
+    size_t b = work.back();
+    work.pop_back();
+    queued[b] = false;
+    BasicBlock &bb = cfg.blocks[b];
+    bool boundary = P::backward ? bb.exit : bb.entry;
+    typename P::Value v = boundary ? p.boundary() : p.initial();
+    for (size_t f : P::backward ? bb.succ : bb.pred)
+      p.meet(v, P::backward ? r.in[f] : r.out[f]);
+    typename P::Value t = p.transfer(bb, v);
+    (P::backward ? r.out : r.in)[b] = v;
+    typename P::Value &far = (P::backward ? r.in : r.out)[b];
+    if (t == far)
+      continue;
+    far = t;
+    for (size_t d : P::backward ? bb.pred : bb.succ) {
+      if (!queued[d]) {
+        queued[d] = true;
+        work.push_back(d);
+      }
+    }
+  }
+  return r;
+}
+
+// The registers that may be read later. Wherever control leaves the graph
+// they all are.
+struct Liveness {
+  typedef RegSet Value;
+  static constexpr bool backward = true;
+  NodeList &nodes;
+
+  Value initial() { return 0; }
+  Value boundary() { return ALL_REGS; }
+  void meet(Value &a, const Value &b) { a |= b; }
+  Value transfer(BasicBlock &b, Value v);
+};
+
+// The writes to a register that may still hold when control gets somewhere,
+// as a set of node indices. Nothing is known where control enters.
+struct ReachingDefinitions {
+  typedef std::vector<bool> Value;
+  static constexpr bool backward = false;
+  NodeList &nodes;
+  std::vector<size_t> defs_of[16]; // the writes to every register
+
+  ReachingDefinitions(NodeList &nodes);
+
+  Value initial() { return Value(nodes.size(), false); }
+  Value boundary() { return initial(); }
+  void meet(Value &a, const Value &b);
+  Value transfer(BasicBlock &b, Value v);
+};
+}; // namespace masm
+
+#endif
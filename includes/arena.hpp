@@ -0,0 +1,62 @@
+#ifndef _ARENA_
+#define _ARENA_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace masm {
+// A bump allocator for everything that lives as long as the assembly does.
+// Nothing is freed individually; the whole arena goes at once when it is
+// destroyed.
+class Arena {
+  std::vector<std::unique_ptr<char[]>> blocks;
+  char *curr = nullptr, *end = nullptr;
+  size_t used = 0;
+
+  static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+public:
+  Arena() = default;
+
+  Arena(const Arena &) = delete;
+
+  Arena &operator=(const Arena &) = delete;
+
+  void *allocate(size_t size, size_t align);
+
+  size_t bytes_used();
+};
+
+// So that standard containers can live in an Arena.
+// deallocate() is a no-op and memory is only reclaimed with the Arena.
+template <typename T> class ArenaAllocator {
+  template <typename U> friend class ArenaAllocator;
+
+  Arena *arena;
+
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator(Arena &a) : arena(&a) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(size_t n) {
+    return (T *)arena->allocate(n * sizeof(T), alignof(T));
+  }
+
+  void deallocate(T *, size_t) {}
+
+  template <typename U> bool operator==(const ArenaAllocator<U> &other) const {
+    return arena == other.arena;
+  }
+};
+}; // namespace masm
+
+#endif
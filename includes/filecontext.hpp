@@ -11,6 +11,7 @@
 #include <iostream>
 #include <lexer.hpp>
 #include <memory>
+#include <source_file.hpp>
 #include <string>
 #include <symboltable.hpp>
 #include <unordered_map>
@@ -20,18 +21,17 @@
 
 namespace masm {
 class FileContext {
-  std::unordered_map<std::string, std::pair<value_t, std::string>> &CONSTANTS;
-  std::unordered_set<std::string> &LABELS;
-  SymbolTable &symtable;
-  std::unordered_map<std::string, uint64_t> &label_addresses;
-  std::unordered_map<std::string, uint64_t> &data_addresses;
+  SymbolTable &symtable; // constants, labels and variables
+  Arena &arena;          // where the nodes live
   std::vector<std::filesystem::path> &include_paths;
-  std::vector<uint8_t> &data, &string;
+  FileTable &files;
+  std::vector<uint8_t> &rodata, &data, &string;
+  const GenOptions &options;
 
   std::unordered_set<std::filesystem::path> imports;
 
   file_t type;
-  std::vector<Node> nodes, tmp;
+  NodeList nodes, tmp;
 
   std::filesystem::path wp;
 
@@ -41,13 +41,10 @@ class FileContext {
   std::unique_ptr<Gen> gen;
 
 public:
-  FileContext(
-      std::vector<std::filesystem::path> &i_paths,
-      std::unordered_map<std::string, std::pair<value_t, std::string>> &C,
-      std::unordered_set<std::string> &L, SymbolTable &sym,
-      std::unordered_map<std::string, uint64_t> &laddr,
-      std::unordered_map<std::string, uint64_t> &daddr, std::vector<uint8_t> &D,
-      std::vector<uint8_t> &S, uint64_t d_addr);
+  FileContext(std::vector<std::filesystem::path> &i_paths, SymbolTable &sym,
+              Arena &arena, FileTable &files, std::vector<uint8_t> &R,
+              std::vector<uint8_t> &D, std::vector<uint8_t> &S,
+              const GenOptions &options, uint64_t d_addr);
 
   /*File related functions*/
   bool is_file_a_directory(std::filesystem::path path);
@@ -62,11 +59,19 @@ public:
 
   std::unordered_set<std::filesystem::path> get_imports();
 
-  std::vector<Node> get_nodes();
+  NodeList get_nodes();
 
-  std::vector<Inst64> get_instructions();
+  std::span<const Inst64> get_instructions();
 
-  std::vector<uint8_t> get_data();
+  std::span<const uint8_t> get_data();
+
+  const GenStats &get_stats();
+
+  bool is_position_independent();
+
+  bool export_cfg(const std::string &path);
+
+  void collect_layout(std::vector<LayoutItem> &items);
 
   uint64_t get_d_addr();
 
@@ -74,7 +79,7 @@ public:
 
   void set_imports(std::unordered_set<std::filesystem::path> &&f);
 
-  void set_nodes(std::vector<Node> &&n);
+  void set_nodes(NodeList &&n);
 
   /*Processing functions*/
   bool file_prepare(std::string input_file);
@@ -93,10 +98,16 @@ public:
 
   bool analyze_file_second_step();
 
+  void shake(ShakeReport &report);
+
+  bool gen_file_first_step_rodata_phase(uint64_t addr);
+
   bool gen_file_first_step(uint64_t addr);
 
   bool gen_file_first_step_second_phase(uint64_t addr);
 
+  bool gen_file_first_step_bss_phase(uint64_t addr);
+
   bool gen_file_first_step_third_phase(uint64_t addr);
 
   bool gen_file_second_step();
@@ -3,11 +3,17 @@
 
 #include <cstdint>
 #include <nodes.hpp>
+#include <span>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace masm {
+// A single qword of code. b0 is always the most significant byte no matter
+// the byte order of the host. Only meant for building instructions; the
+// output is serialized from 'whole_word'(see store_qwords in output_gen).
 union Inst64 {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
   struct {
     uint8_t b7;
     uint8_t b6;
@@ -35,9 +41,9 @@ union Inst64 {
     uint8_t b0;
     uint8_t b1;
     uint8_t b2;
+    uint8_t b3;
     uint8_t b4;
     uint8_t b5;
-    uint8_t b3;
     uint8_t b6;
     uint8_t b7;
   } bytes;
@@ -57,26 +63,85 @@ union Inst64 {
   uint64_t whole_word = 0;
 };
 
+// The unit the cores share memory in
+#define CACHE_LINE_LEN 64
+
+// Optional behaviour of the generators, from the command line
+struct GenOptions {
+  bool pack_data = false;         // see GPCGen::pack_tail
+  bool isolate_atomics = true;    // see GPCGen::isolate_atomics
+  bool peephole = false;          // see peephole()
+  bool shorten_immediates = true; // see shorten_immediate()
+  bool relative_jumps = false;    // see GPCGen::relative_jump
+  bool dead_writes = false;       // see eliminate_dead_writes()
+  bool thread_jumps = false;      // see thread_jumps()
+};
+
+// A variable's place in memory, for the layout map
+struct LayoutItem {
+  uint32_t name;
+  uint64_t address;
+  uint64_t size;
+};
+
+// What the generator did besides translating, for --stats
+struct GenStats {
+  size_t strings_deduplicated = 0; // identical to another string
+  size_t strings_tail_merged = 0;  // stored as the end of another string
+  size_t string_bytes_saved = 0;
+  size_t constants_merged = 0; // read only values stored only once
+  size_t constant_bytes_saved = 0;
+  size_t immediates_shortened = 0; // a qword each
+  size_t dead_writes_removed = 0;
+  size_t jumps_retargeted = 0;
+  size_t jumps_folded = 0;        // and a jmp removed with each
+  size_t unreachable_removed = 0; // instructions
+  // Instructions removed by each peephole rule, in the order of the rules
+  std::vector<std::pair<const char *, size_t>> peephole_hits;
+};
+
 class Gen {
 public:
   Gen() = default;
 
   virtual ~Gen() = default;
 
-  virtual void set_final_nodes(std::vector<Node> &&nodes) = 0;
+  virtual void set_final_nodes(NodeList &&nodes) = 0;
+
+  // Rewrites the final nodes before anything has an address
+  virtual void optimize() = 0;
 
   virtual uint64_t get_current_address_point() = 0;
 
-  virtual std::vector<Inst64> get_instructions() = 0;
+  // Borrowed; valid for as long as the generator lives
+  virtual std::span<const Inst64> get_instructions() = 0;
 
-  virtual std::vector<uint8_t> get_data() = 0;
+  virtual std::span<const uint8_t> get_data() = 0;
 
   virtual Inst64 get_ENTRY_INSTRUCTION(size_t addr) = 0;
 
+  virtual const GenStats &get_stats() = 0;
+
+  // Whether the code can be loaded at any address; valid after the second
+  // iteration
+  virtual bool is_position_independent() = 0;
+
+  // Writes the control flow graph of the code to 'path'(see CFG::export_to)
+  virtual bool export_cfg(const std::string &path) = 0;
+
+  // Every variable with its address, in no particular order
+  virtual void collect_layout(std::vector<LayoutItem> &items) = 0;
+
+  // The variables that are never written, before everything else
+  virtual bool first_iteration_rodata_phase(uint64_t addr_point) = 0;
+
   virtual bool first_iteration(uint64_t addr_point) = 0;
 
   virtual bool first_iteration_second_phase(uint64_t addr_point) = 0;
 
+  // The reservations(resX) which take no space in the output
+  virtual bool first_iteration_bss_phase(uint64_t addr_point) = 0;
+
   virtual bool first_iteration_third_phase(uint64_t addr_point) = 0;
 
   virtual bool second_iteration() = 0;
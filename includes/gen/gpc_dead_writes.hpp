@@ -0,0 +1,15 @@
+#ifndef _GPC_DEAD_WRITES_
+#define _GPC_DEAD_WRITES_
+
+#include <gen_base.hpp>
+#include <nodes.hpp>
+#include <symboltable.hpp>
+
+namespace masm {
+// Removes the moves and loads to registers that are never read before they
+// are written again, by the liveness over the control flow graph(see
+// gpc_cfg.hpp). Returns how many were removed.
+size_t eliminate_dead_writes(NodeList &nodes, SymbolTable &symtable);
+}; // namespace masm
+
+#endif
@@ -3,53 +3,102 @@
 
 #include <gen_base.hpp>
 #include <gpc_gen_base.hpp>
+#include <map>
 #include <nodes.hpp>
 #include <symboltable.hpp>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace masm {
 typedef Inst64 Data64;
 class GPCGen : public Gen {
-  std::vector<Node> final_nodes; // All we will convert to instructions
+  NodeList final_nodes; // All we will convert to instructions
   SymbolTable &symtable;         // All the data
   uint64_t st_address_data;
 
-  std::unordered_map<std::string, uint64_t> &label_addresses;
-  std::unordered_map<std::string, uint64_t> &data_addresses;
-
   // Results
   std::vector<Inst64> instructions;
-  std::vector<uint8_t> &data, &string;
+  std::vector<uint8_t> &rodata, &data, &string;
+  const GenOptions &options;
+  GenStats stats;
+
+  // Variables placed out of the usual order(in the read only section, by
+  // pack_tail and isolate_atomics) that the other passes must skip
+  std::unordered_set<uint32_t> placed;
+
+  // The read only values placed so far: (length, bits) to the variable
+  // holding them. Pointers use a length of 0 and the ID they point to.
+  std::map<std::pair<uint64_t, uint64_t>, uint32_t> constants;
+
+  void add_read_only(Node &n, size_t len);
+
+  void pack_tail();
+
+  bool is_isolated(uint32_t name);
+
+  void isolate_atomics();
+
+  void isolate_atomic_reservations();
+
+  // Strings that are stored inside another string(see pool_strings)
+  struct StringAlias {
+    uint32_t owner;
+    size_t offset;
+  };
+  std::unordered_map<uint32_t, StringAlias> string_aliases;
+
+  void pool_strings();
+
+  // No instruction or pointer holds the address of any code(see
+  // second_iteration)
+  bool position_independent = false;
+
+  void relative_jump(Node &n);
 
 public:
-  GPCGen(SymbolTable &, std::unordered_map<std::string, uint64_t> &,
-         std::unordered_map<std::string, uint64_t> &, std::vector<uint8_t> &,
-         std::vector<uint8_t> &, uint64_t);
+  GPCGen(SymbolTable &, Arena &, std::vector<uint8_t> &,
+         std::vector<uint8_t> &, std::vector<uint8_t> &, const GenOptions &,
+         uint64_t);
+
+  void set_final_nodes(NodeList &&nodes) override;
 
-  void set_final_nodes(std::vector<Node> &&nodes) override;
+  void optimize() override;
 
   uint64_t get_current_address_point() override;
 
-  std::vector<Inst64> get_instructions() override;
+  std::span<const Inst64> get_instructions() override;
 
-  std::vector<uint8_t> get_data() override;
+  std::span<const uint8_t> get_data() override;
 
   Inst64 get_ENTRY_INSTRUCTION(size_t addr) override;
 
+  const GenStats &get_stats() override;
+
+  bool is_position_independent() override;
+
+  bool export_cfg(const std::string &path) override;
+
+  void collect_layout(std::vector<LayoutItem> &items) override;
+
+  bool first_iteration_rodata_phase(uint64_t addr_point) override;
+
   bool first_iteration(uint64_t addr_point) override;
 
   bool first_iteration_second_phase(uint64_t addr_point) override;
 
+  bool first_iteration_bss_phase(uint64_t addr_point) override;
+
   bool first_iteration_third_phase(uint64_t addr_point) override;
 
   bool second_iteration() override;
 
-  void align_data(uint64_t *addr);
+  void align_data(std::vector<uint8_t> &bytes, uint64_t *addr,
+                  uint64_t to = 8);
 
-  void add_data(std::string value, value_t type, size_t len);
+  void add_data(std::vector<uint8_t> &bytes, NodeDB *n, size_t len);
 
-  void add_reserved_data(std::string len, value_t type, size_t l);
+  void reserve_data(NodeRESB *n, size_t l);
 
   void simple_instructions(uint8_t opcode);
 
@@ -63,22 +112,21 @@ public:
                                        bool label = false, uint8_t op2 = 0,
                                        bool jmp = false);
 
-  void sin_and_sout_instructions(Node &n);
-
-  void single_operand_which_is_variable(uint8_t opcode, std::string name);
+  void single_operand_which_is_variable(uint8_t opcode, uint32_t name);
 
-  void single_operand_which_is_immediate(uint8_t opcode, std::string value,
+  void single_operand_which_is_immediate(uint8_t opcode, const Literal &value,
                                          value_t type, size_t len);
 
+  // 'opcodes' is IsaEntry::mem
   void choose_opcode_according_to_variable(NodeRegrImm *n,
-                                           std::vector<uint8_t> opcodes);
+                                           const uint8_t *opcodes);
 
-  void two_operand_second_is_immediate(uint8_t opcode, std::string value,
+  void two_operand_second_is_immediate(uint8_t opcode, const Literal &value,
                                        value_t type, size_t len, token_t reg1);
 
   void two_operand_second_is_immediate_in_same_qword(uint8_t opcode,
                                                      token_t regr,
-                                                     std::string imm,
+                                                     const Literal &imm,
                                                      value_t type, size_t len);
 };
 }; // namespace masm
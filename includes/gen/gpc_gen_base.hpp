@@ -1,254 +1,332 @@
 #ifndef _GPC_ISA_
 #define _GPC_ISA_
 
+#include <cstdint>
+#include <nodes.hpp>
+
 namespace masm {
-enum {
-  OP_NOP,
-  OP_HALT,
-  OP_ADD_IMM,
-  OP_ADD_REG,
-  OP_SUB_IMM,
-  OP_SUB_REG,
-  OP_MUL_IMM,
-  OP_MUL_REG,
-  OP_DIV_IMM,
-  OP_DIV_REG,
-  OP_MOD_IMM,
-  OP_MOD_REG,
-  OP_IADD_IMM,
-  OP_IADD_REG,
-  OP_ISUB_IMM,
-  OP_ISUB_REG,
-  OP_IMUL_IMM,
-  OP_IMUL_REG,
-  OP_IDIV_IMM,
-  OP_IDIV_REG,
-  OP_IMOD_IMM,
-  OP_IMOD_REG,
-  OP_FADD,
-  OP_FSUB,
-  OP_FMUL,
-  OP_FDIV,
-  OP_FADD32,
-  OP_FSUB32,
-  OP_FMUL32,
-  OP_FDIV32,
-  OP_ADD_MEMB,
-  OP_ADD_MEMW,
-  OP_ADD_MEMD,
-  OP_ADD_MEMQ,
-  OP_SUB_MEMB,
-  OP_SUB_MEMW,
-  OP_SUB_MEMD,
-  OP_SUB_MEMQ,
-  OP_MUL_MEMB,
-  OP_MUL_MEMW,
-  OP_MUL_MEMD,
-  OP_MUL_MEMQ,
-  OP_DIV_MEMB,
-  OP_DIV_MEMW,
-  OP_DIV_MEMD,
-  OP_DIV_MEMQ,
-  OP_MOD_MEMB,
-  OP_MOD_MEMW,
-  OP_MOD_MEMD,
-  OP_MOD_MEMQ,
-  OP_FADD_MEM,
-  OP_FSUB_MEM,
-  OP_FMUL_MEM,
-  OP_FDIV_MEM,
-  OP_FADD32_MEM,
-  OP_FSUB32_MEM,
-  OP_FMUL32_MEM,
-  OP_FDIV32_MEM,
-  OP_INC,
-  OP_DEC,
-  OP_MOVE_IMM_64,
-  OP_MOVE_REG,
-  OP_MOVE_REG8,
-  OP_MOVE_REG16,
-  OP_MOVE_REG32,
-  OP_MOVESX_IMM8,
-  OP_MOVESX_IMM16,
-  OP_MOVESX_IMM32,
-  OP_MOVESX_REG8,
-  OP_MOVESX_REG16,
-  OP_MOVESX_REG32,
-  OP_EXCG8,
-  OP_EXCG16,
-  OP_EXCG32,
-  OP_EXCG,
-  OP_MOV8,
-  OP_MOV16,
-  OP_MOV32,
-  OP_MOVNZ,
-  OP_MOVZ,
-  OP_MOVNE,
-  OP_MOVE,
-  OP_MOVNC,
-  OP_MOVC,
-  OP_MOVNO,
-  OP_MOVO,
-  OP_MOVNN,
-  OP_MOVN,
-  OP_MOVNG,
-  OP_MOVG,
-  OP_MOVNS,
-  OP_MOVS,
-  OP_MOVGE,
-  OP_MOVSE,
-  OP_JMP_OFF,
-  OP_JMP_ADDR,
-  OP_JNZ,
-  OP_JZ,
-  OP_JNE,
-  OP_JE,
-  OP_JNC,
-  OP_JC,
-  OP_JNO,
-  OP_JO,
-  OP_JNN,
-  OP_JN,
-  OP_JNG,
-  OP_JG,
-  OP_JNS,
-  OP_JS,
-  OP_JGE,
-  OP_JSE,
-  OP_CALL,
-  OP_RET,
-  OP_RETNZ,
-  OP_RETZ,
-  OP_RETNE,
-  OP_RETE,
-  OP_RETNC,
-  OP_RETC,
-  OP_RETNO,
-  OP_RETO,
-  OP_RETNN,
-  OP_RETN,
-  OP_RETNG,
-  OP_RETG,
-  OP_RETNS,
-  OP_RETS,
-  OP_RETGE,
-  OP_RETSE,
-  OP_LOOP,
-  OP_CALL_REG,
-  OP_JMP_REGR,
-  OP_INTR,
-  OP_PUSH_IMM8,
-  OP_PUSH_IMM16,
-  OP_PUSH_IMM32,
-  OP_PUSH_IMM64,
-  OP_PUSH_REG,
-  OP_POP8,
-  OP_POP16,
-  OP_POP32,
-  OP_POP64,
-  OP_PUSHA,
-  OP_POPA,
-  OP_PUSH_MEMB,
-  OP_PUSH_MEMW,
-  OP_PUSH_MEMD,
-  OP_PUSH_MEMQ,
-  OP_POP_MEMB,
-  OP_POP_MEMW,
-  OP_POP_MEMD,
-  OP_POP_MEMQ,
-  OP_LOADSB,
-  OP_LOADSW,
-  OP_LOADSD,
-  OP_LOADSQ,
-  OP_STORESB,
-  OP_STORESW,
-  OP_STORESD,
-  OP_STORESQ,
-  OP_AND_IMM,
-  OP_AND_REG,
-  OP_OR_IMM,
-  OP_OR_REG,
-  OP_XOR_IMM,
-  OP_XOR_REG,
-  OP_NOT,
-  OP_LSHIFT,
-  OP_RSHIFT,
-  OP_LSHIFT_REGR,
-  OP_RSHIFT_REGR,
-  OP_CMP_IMM,
-  OP_CMP_REG,
-  OP_CMP_IMM_MEMB,
-  OP_CMP_IMM_MEMW,
-  OP_CMP_IMM_MEMD,
-  OP_CMP_IMM_MEMQ,
-  OP_FCMP,
-  OP_FCMP32,
-  OP_CIN,
-  OP_COUT,
-  OP_SIN,
-  OP_SOUT,
-  OP_IN,
-  OP_OUT,
-  OP_INW,
-  OP_OUTW,
-  OP_IND,
-  OP_OUTD,
-  OP_INQ,
-  OP_OUTQ,
-  OP_UIN,
-  OP_UOUT,
-  OP_UINW,
-  OP_UOUTW,
-  OP_UIND,
-  OP_UOUTD,
-  OP_UINQ,
-  OP_UOUTQ,
-  OP_INF,
-  OP_OUTF,
-  OP_INF32,
-  OP_OUTF32,
-  OP_OUTR,
-  OP_UOUTR,
-  OP_SIN_REG,
-  OP_SOUT_REG,
-  OP_LOADB,
-  OP_LOADW,
-  OP_LOADD,
-  OP_STOREB,
-  OP_STOREW,
-  OP_STORED,
-  OP_LOADQ,
-  OP_STOREQ,
-  OP_LOADB_REG,
-  OP_STOREB_REG,
-  OP_LOADW_REG,
-  OP_STOREW_REG,
-  OP_LOADD_REG,
-  OP_STORED_REG,
-  OP_LOADQ_REG,
-  OP_STOREQ_REG,
-  OP_ATOMIC_LOADB,
-  OP_ATOMIC_LOADW,
-  OP_ATOMIC_LOADD,
-  OP_ATOMIC_LOADQ,
-  OP_ATOMIC_STOREB,
-  OP_ATOMIC_STOREW,
-  OP_ATOMIC_STORED,
-  OP_ATOMIC_STOREQ,
-  OP_ATOMIC_LOADB_REG,
-  OP_ATOMIC_LOADW_REG,
-  OP_ATOMIC_LOADD_REG,
-  OP_ATOMIC_LOADQ_REG,
-  OP_ATOMIC_STOREB_REG,
-  OP_ATOMIC_STOREW_REG,
-  OP_ATOMIC_STORED_REG,
-  OP_ATOMIC_STOREQ_REG,
-  OP_LEA,
-  OP_CFLAGS,
-  OP_RESET,
-  OP_CMPXCHG,
-  OP_CMPXCHG_REGR,
-  OP_WHDLR,
+// Every GPC opcode in the order the VM numbers them. The opcode enum is
+// generated from this and checked against the VM's own list
+// (core_details/gpc.hpp) at compile time so the two cannot drift apart.
+#define GPC_OPCODES(X)                                                       \
+  X(NOP)                                                                     \
+  X(HALT)                                                                    \
+  X(ADD_IMM)                                                                 \
+  X(ADD_REG)                                                                 \
+  X(SUB_IMM)                                                                 \
+  X(SUB_REG)                                                                 \
+  X(MUL_IMM)                                                                 \
+  X(MUL_REG)                                                                 \
+  X(DIV_IMM)                                                                 \
+  X(DIV_REG)                                                                 \
+  X(MOD_IMM)                                                                 \
+  X(MOD_REG)                                                                 \
+  X(IADD_IMM)                                                                \
+  X(IADD_REG)                                                                \
+  X(ISUB_IMM)                                                                \
+  X(ISUB_REG)                                                                \
+  X(IMUL_IMM)                                                                \
+  X(IMUL_REG)                                                                \
+  X(IDIV_IMM)                                                                \
+  X(IDIV_REG)                                                                \
+  X(IMOD_IMM)                                                                \
+  X(IMOD_REG)                                                                \
+  X(FADD)                                                                    \
+  X(FSUB)                                                                    \
+  X(FMUL)                                                                    \
+  X(FDIV)                                                                    \
+  X(FADD32)                                                                  \
+  X(FSUB32)                                                                  \
+  X(FMUL32)                                                                  \
+  X(FDIV32)                                                                  \
+  X(ADD_MEMB)                                                                \
+  X(ADD_MEMW)                                                                \
+  X(ADD_MEMD)                                                                \
+  X(ADD_MEMQ)                                                                \
+  X(SUB_MEMB)                                                                \
+  X(SUB_MEMW)                                                                \
+  X(SUB_MEMD)                                                                \
+  X(SUB_MEMQ)                                                                \
+  X(MUL_MEMB)                                                                \
+  X(MUL_MEMW)                                                                \
+  X(MUL_MEMD)                                                                \
+  X(MUL_MEMQ)                                                                \
+  X(DIV_MEMB)                                                                \
+  X(DIV_MEMW)                                                                \
+  X(DIV_MEMD)                                                                \
+  X(DIV_MEMQ)                                                                \
+  X(MOD_MEMB)                                                                \
+  X(MOD_MEMW)                                                                \
+  X(MOD_MEMD)                                                                \
+  X(MOD_MEMQ)                                                                \
+  X(FADD_MEM)                                                                \
+  X(FSUB_MEM)                                                                \
+  X(FMUL_MEM)                                                                \
+  X(FDIV_MEM)                                                                \
+  X(FADD32_MEM)                                                              \
+  X(FSUB32_MEM)                                                              \
+  X(FMUL32_MEM)                                                              \
+  X(FDIV32_MEM)                                                              \
+  X(INC)                                                                     \
+  X(DEC)                                                                     \
+  X(MOVE_IMM_64)                                                             \
+  X(MOVE_REG)                                                                \
+  X(MOVE_REG8)                                                               \
+  X(MOVE_REG16)                                                              \
+  X(MOVE_REG32)                                                              \
+  X(MOVESX_IMM8)                                                             \
+  X(MOVESX_IMM16)                                                            \
+  X(MOVESX_IMM32)                                                            \
+  X(MOVESX_REG8)                                                             \
+  X(MOVESX_REG16)                                                            \
+  X(MOVESX_REG32)                                                            \
+  X(EXCG8)                                                                   \
+  X(EXCG16)                                                                  \
+  X(EXCG32)                                                                  \
+  X(EXCG)                                                                    \
+  X(MOV8)                                                                    \
+  X(MOV16)                                                                   \
+  X(MOV32)                                                                   \
+  X(MOVNZ)                                                                   \
+  X(MOVZ)                                                                    \
+  X(MOVNE)                                                                   \
+  X(MOVE)                                                                    \
+  X(MOVNC)                                                                   \
+  X(MOVC)                                                                    \
+  X(MOVNO)                                                                   \
+  X(MOVO)                                                                    \
+  X(MOVNN)                                                                   \
+  X(MOVN)                                                                    \
+  X(MOVNG)                                                                   \
+  X(MOVG)                                                                    \
+  X(MOVNS)                                                                   \
+  X(MOVS)                                                                    \
+  X(MOVGE)                                                                   \
+  X(MOVSE)                                                                   \
+  X(JMP_OFF)                                                                 \
+  X(JMP_ADDR)                                                                \
+  X(JNZ)                                                                     \
+  X(JZ)                                                                      \
+  X(JNE)                                                                     \
+  X(JE)                                                                      \
+  X(JNC)                                                                     \
+  X(JC)                                                                      \
+  X(JNO)                                                                     \
+  X(JO)                                                                      \
+  X(JNN)                                                                     \
+  X(JN)                                                                      \
+  X(JNG)                                                                     \
+  X(JG)                                                                      \
+  X(JNS)                                                                     \
+  X(JS)                                                                      \
+  X(JGE)                                                                     \
+  X(JSE)                                                                     \
+  X(CALL)                                                                    \
+  X(RET)                                                                     \
+  X(RETNZ)                                                                   \
+  X(RETZ)                                                                    \
+  X(RETNE)                                                                   \
+  X(RETE)                                                                    \
+  X(RETNC)                                                                   \
+  X(RETC)                                                                    \
+  X(RETNO)                                                                   \
+  X(RETO)                                                                    \
+  X(RETNN)                                                                   \
+  X(RETN)                                                                    \
+  X(RETNG)                                                                   \
+  X(RETG)                                                                    \
+  X(RETNS)                                                                   \
+  X(RETS)                                                                    \
+  X(RETGE)                                                                   \
+  X(RETSE)                                                                   \
+  X(LOOP)                                                                    \
+  X(CALL_REG)                                                                \
+  X(JMP_REGR)                                                                \
+  X(INTR)                                                                    \
+  X(PUSH_IMM8)                                                               \
+  X(PUSH_IMM16)                                                              \
+  X(PUSH_IMM32)                                                              \
+  X(PUSH_IMM64)                                                              \
+  X(PUSH_REG)                                                                \
+  X(POP8)                                                                    \
+  X(POP16)                                                                   \
+  X(POP32)                                                                   \
+  X(POP64)                                                                   \
+  X(PUSHA)                                                                   \
+  X(POPA)                                                                    \
+  X(PUSH_MEMB)                                                               \
+  X(PUSH_MEMW)                                                               \
+  X(PUSH_MEMD)                                                               \
+  X(PUSH_MEMQ)                                                               \
+  X(POP_MEMB)                                                                \
+  X(POP_MEMW)                                                                \
+  X(POP_MEMD)                                                                \
+  X(POP_MEMQ)                                                                \
+  X(LOADSB)                                                                  \
+  X(LOADSW)                                                                  \
+  X(LOADSD)                                                                  \
+  X(LOADSQ)                                                                  \
+  X(STORESB)                                                                 \
+  X(STORESW)                                                                 \
+  X(STORESD)                                                                 \
+  X(STORESQ)                                                                 \
+  X(AND_IMM)                                                                 \
+  X(AND_REG)                                                                 \
+  X(OR_IMM)                                                                  \
+  X(OR_REG)                                                                  \
+  X(XOR_IMM)                                                                 \
+  X(XOR_REG)                                                                 \
+  X(NOT)                                                                     \
+  X(LSHIFT)                                                                  \
+  X(RSHIFT)                                                                  \
+  X(LSHIFT_REGR)                                                             \
+  X(RSHIFT_REGR)                                                             \
+  X(CMP_IMM)                                                                 \
+  X(CMP_REG)                                                                 \
+  X(CMP_IMM_MEMB)                                                            \
+  X(CMP_IMM_MEMW)                                                            \
+  X(CMP_IMM_MEMD)                                                            \
+  X(CMP_IMM_MEMQ)                                                            \
+  X(FCMP)                                                                    \
+  X(FCMP32)                                                                  \
+  X(CIN)                                                                     \
+  X(COUT)                                                                    \
+  X(SIN)                                                                     \
+  X(SOUT)                                                                    \
+  X(IN)                                                                      \
+  X(OUT)                                                                     \
+  X(INW)                                                                     \
+  X(OUTW)                                                                    \
+  X(IND)                                                                     \
+  X(OUTD)                                                                    \
+  X(INQ)                                                                     \
+  X(OUTQ)                                                                    \
+  X(UIN)                                                                     \
+  X(UOUT)                                                                    \
+  X(UINW)                                                                    \
+  X(UOUTW)                                                                   \
+  X(UIND)                                                                    \
+  X(UOUTD)                                                                   \
+  X(UINQ)                                                                    \
+  X(UOUTQ)                                                                   \
+  X(INF)                                                                     \
+  X(OUTF)                                                                    \
+  X(INF32)                                                                   \
+  X(OUTF32)                                                                  \
+  X(OUTR)                                                                    \
+  X(UOUTR)                                                                   \
+  X(SIN_REG)                                                                 \
+  X(SOUT_REG)                                                                \
+  X(LOADB)                                                                   \
+  X(LOADW)                                                                   \
+  X(LOADD)                                                                   \
+  X(STOREB)                                                                  \
+  X(STOREW)                                                                  \
+  X(STORED)                                                                  \
+  X(LOADQ)                                                                   \
+  X(STOREQ)                                                                  \
+  X(LOADB_REG)                                                               \
+  X(STOREB_REG)                                                              \
+  X(LOADW_REG)                                                               \
+  X(STOREW_REG)                                                              \
+  X(LOADD_REG)                                                               \
+  X(STORED_REG)                                                              \
+  X(LOADQ_REG)                                                               \
+  X(STOREQ_REG)                                                              \
+  X(ATOMIC_LOADB)                                                            \
+  X(ATOMIC_LOADW)                                                            \
+  X(ATOMIC_LOADD)                                                            \
+  X(ATOMIC_LOADQ)                                                            \
+  X(ATOMIC_STOREB)                                                           \
+  X(ATOMIC_STOREW)                                                           \
+  X(ATOMIC_STORED)                                                           \
+  X(ATOMIC_STOREQ)                                                           \
+  X(ATOMIC_LOADB_REG)                                                        \
+  X(ATOMIC_LOADW_REG)                                                        \
+  X(ATOMIC_LOADD_REG)                                                        \
+  X(ATOMIC_LOADQ_REG)                                                        \
+  X(ATOMIC_STOREB_REG)                                                       \
+  X(ATOMIC_STOREW_REG)                                                       \
+  X(ATOMIC_STORED_REG)                                                       \
+  X(ATOMIC_STOREQ_REG)                                                       \
+  X(LEA)                                                                     \
+  X(CFLAGS)                                                                  \
+  X(RESET)                                                                   \
+  X(CMPXCHG)                                                                 \
+  X(CMPXCHG_REGR)                                                            \
+  X(WHDLR)
+
+enum opcode_t {
+#define GPC_OPCODE_ENUM(name) OP_##name,
+  GPC_OPCODES(GPC_OPCODE_ENUM)
+#undef GPC_OPCODE_ENUM
+  OP_COUNT, // not an opcode; keep this last
+};
+
+// How the operands of an instruction are laid out in the encoded qwords.
+// Each layout has exactly one emit routine in GPCGen.
+enum layout_t {
+  LAYOUT_NO_CODE,        // labels, data and directives
+  LAYOUT_OP,             // [op]
+  LAYOUT_REG,            // [op ... reg]
+  LAYOUT_REG_REG,        // [op ... reg1 reg2]
+  LAYOUT_LABEL,          // [op | label address]
+  LAYOUT_OP_LABEL64,     // [op] [label address]
+  LAYOUT_MEM,            // [op | variable address]
+  LAYOUT_IMM_OR_MEM,     // [op] [imm] or [mem op | variable address]
+  LAYOUT_REG_IMM,        // [op ... reg] [imm]
+  LAYOUT_REG_IMM_OR_MEM, // LAYOUT_REG_IMM or LAYOUT_REG_MEM
+  LAYOUT_REG_MEM,        // [mem op reg | variable address]
+  LAYOUT_REG_IMM16,      // [op reg imm16 ...]
+  LAYOUT_REG_LABEL,      // [op reg | label address]
+  LAYOUT_INT,            // [op | imm16]
+  LAYOUT_LEA,            // [op ... base index scale dest]
+  LAYOUT_CMPXCHG_MEM,    // [op ... desired expected] [variable address]
+  LAYOUT_CMPXCHG_REG,    // [op ... address desired expected]
 };
+
+// How one kind of node is encoded.
+struct IsaEntry {
+  node_t node;
+  layout_t layout = LAYOUT_NO_CODE;
+  uint8_t op = 0;      // the immediate or register form
+  uint8_t imm_len = 8; // bytes of the immediate that are encoded
+  // The forms taking a variable, by the size of the variable:
+  // byte(also strings and floats), word, dword and qword(also pointers)
+  uint8_t mem[4] = {};
+
+  // In qwords, 'is_var' telling which form is used when there is a choice
+  constexpr uint32_t length(bool is_var) const {
+    switch (layout) {
+    case LAYOUT_NO_CODE:
+      return 0;
+    case LAYOUT_OP_LABEL64:
+    case LAYOUT_REG_IMM:
+    case LAYOUT_CMPXCHG_MEM:
+      return 2;
+    case LAYOUT_IMM_OR_MEM:
+    case LAYOUT_REG_IMM_OR_MEM:
+      return is_var ? 1 : 2;
+    default:
+      return 1;
+    }
+  }
 };
+
+const IsaEntry &isa_entry(node_t node);
+
+// The number of qwords the node is encoded into
+uint32_t encoded_length(Node &n);
+
+// Switches the node to a shorter form that does the same when its
+// immediate allows it; false if there is none
+bool shorten_immediate(Node &n);
+
+// The variable or label an instruction refers to(NO_ID if none)
+uint32_t operand_symbol(Node &n);
+
+// The bytes a data or reservation node takes in memory(0 for the others)
+uint64_t variable_size(Node &n);
+}; // namespace masm
+
 #endif
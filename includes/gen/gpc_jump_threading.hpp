@@ -0,0 +1,15 @@
+#ifndef _GPC_JUMP_THREADING_
+#define _GPC_JUMP_THREADING_
+
+#include <gen_base.hpp>
+#include <nodes.hpp>
+#include <symboltable.hpp>
+
+namespace masm {
+// Sends the jumps and calls to a jmp straight to where it goes, turns a
+// conditional jump over a jmp into the opposite conditional jump and
+// removes the code nothing reaches anymore. Counted in 'stats'.
+void thread_jumps(NodeList &nodes, SymbolTable &symtable, GenStats &stats);
+}; // namespace masm
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef _GPC_PEEPHOLE_
+#define _GPC_PEEPHOLE_
+
+#include <gen_base.hpp>
+#include <nodes.hpp>
+
+namespace masm {
+// Removes the instructions that have no effect(see the rules in
+// gpc_peephole.cpp). Works on the analyzed nodes before anything has an
+// address so that the lengths and labels stay consistent. Every rule
+// applied is counted in 'stats'.
+void peephole(NodeList &nodes, GenStats &stats);
+}; // namespace masm
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _INTERNER_
+#define _INTERNER_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace masm {
+constexpr uint32_t NO_ID = UINT32_MAX;
+
+// Maps every identifier to a dense 32-bit ID.
+// The lexer interns identifiers as it finds them so that everything after
+// it deals with IDs and never hashes the name again.
+class Interner {
+  std::deque<std::string> names; // doesn't move its elements when growing
+  std::unordered_map<std::string_view, uint32_t> ids; // views into 'names'
+
+public:
+  Interner() = default;
+
+  Interner(const Interner &) = delete;
+
+  Interner &operator=(const Interner &) = delete;
+
+  uint32_t intern(std::string_view name);
+
+  // NO_ID if the name was never interned
+  uint32_t find(std::string_view name);
+
+  const std::string &name(uint32_t id);
+
+  size_t size();
+};
+}; // namespace masm
+
+#endif
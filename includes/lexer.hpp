@@ -1,25 +1,33 @@
 #ifndef _LEXER_
 #define _LEXER_
 
-#include <fstream>
 #include <lexer_base.hpp>
+#include <scan.hpp>
+#include <source_file.hpp>
 #include <string>
+#include <token_stream.hpp>
 #include <utils.hpp>
 
 namespace masm {
 class Lexer {
-  std::string stream;
-  std::string::iterator iter;
+  SourceFile &src;
+  Interner &names;
+  const char *iter, *end;
   size_t line = 0;
   std::string file;
   size_t dot_count = 0;
 
+  // The token being built
+  uint32_t tok_offset = 0, tok_len = 0, tok_line = 0;
+  Literal tok_lit;
+
 public:
-  Lexer(std::string path, bool *err);
+  Lexer(SourceFile &source, Interner &interner);
 
-  Token next_token();
+  // Lex the entire file
+  bool tokenize(TokenStream &tokens);
 
-  Token peek_token();
+  token_t next_token();
 
   /* Lexing numbers */
   std::pair<bool, token_t> lex_number();
@@ -33,7 +41,7 @@ public:
   bool is_float_or_double_or_integer();
 
   /* Lexing Strings */
-  std::pair<bool, std::string> lex_string();
+  bool lex_string();
 
   /* Lexing identifiers and keywords */
   token_t lex_identifier_or_token();
@@ -1,8 +1,10 @@
 #ifndef _LEXER_BASE_
 #define _LEXER_BASE_
 
-#include <string>
-#include <unordered_map>
+#include <interner.hpp>
+#include <literal.hpp>
+#include <string_view>
+#include <utility>
 
 namespace masm {
 
@@ -217,213 +219,18 @@ enum token_t {
   TOKEN_LEA,
   TOKEN_CMPXCHG,
   TOKEN_ATM,
+  TOKEN_COUNT, // not a token; keep this last
 };
 
 struct Token {
   token_t type;
-  std::string value;
+  std::string_view value; // points into the SourceFile that produced it
   size_t line;
+  Literal lit;        // only for the numeric tokens
+  uint32_t id = NO_ID; // only for identifiers
 };
 
-static std::unordered_map<std::string, token_t> map = {
-    {"r0", R0},
-    {"r1", R1},
-    {"r2", R2},
-    {"r3", R3},
-    {"r4", R4},
-    {"r5", R5},
-    {"r6", R6},
-    {"r7", R7},
-    {"r8", R8},
-    {"r9", R9},
-    {"r10", R10},
-    {"r11", R11},
-    {"r12", R12},
-    {"sp", SP},
-    {"bp", BP},
-    {"acc", ACC},
-    {"include", TOKEN_INCLUDE},
-    {":", TOKEN_COLON},
-    {"define", TOKEN_DEFINE},
-    {"db", TOKEN_DB},
-    {"dw", TOKEN_DW},
-    {"dd", TOKEN_DD},
-    {"dq", TOKEN_DQ},
-    {"dp", TOKEN_DP},
-    {"df", TOKEN_DF},
-    {"ds", TOKEN_DS},
-    {"df", TOKEN_DF},
-    {"dlf", TOKEN_DLF},
-    {"resb", TOKEN_RESB},
-    {"resw", TOKEN_RESW},
-    {"resd", TOKEN_RESD},
-    {"resq", TOKEN_RESQ},
-    {"resp", TOKEN_RESP},
-    {"resf", TOKEN_RESF},
-    {"reslf", TOKEN_RESLF},
-    {"nop", TOKEN_NOP},
-    {"hlt", TOKEN_HALT},
-    {"add", TOKEN_ADD},
-    {"sub", TOKEN_SUB},
-    {"mul", TOKEN_MUL},
-    {"div", TOKEN_DIV},
-    {"mod", TOKEN_MOD},
-    {"iadd", TOKEN_IADD},
-    {"isub", TOKEN_ISUB},
-    {"imul", TOKEN_IMUL},
-    {"idiv", TOKEN_IDIV},
-    {"imod", TOKEN_IMOD},
-    {"fadd", TOKEN_FADD},
-    {"fsub", TOKEN_FSUB},
-    {"fmul", TOKEN_FMUL},
-    {"fdiv", TOKEN_FDIV},
-    {"fadd32", TOKEN_FADD32},
-    {"fsub32", TOKEN_FSUB32},
-    {"fmul32", TOKEN_FMUL32},
-    {"fdiv32", TOKEN_FDIV32},
-    {"and", TOKEN_AND},
-    {"or", TOKEN_OR},
-    {"xor", TOKEN_XOR},
-    {"shl", TOKEN_SHL},
-    {"shr", TOKEN_SHR},
-    {"cmp", TOKEN_CMP},
-    {"ret", TOKEN_RET},
-    {"retnz", TOKEN_RETNZ},
-    {"retz", TOKEN_RETZ},
-    {"retne", TOKEN_RETNE},
-    {"rete", TOKEN_RETE},
-    {"retnc", TOKEN_RETNC},
-    {"retc", TOKEN_RETC},
-    {"retno", TOKEN_RETNO},
-    {"retnn", TOKEN_RETNN},
-    {"retn", TOKEN_RETN},
-    {"reto", TOKEN_RETO},
-    {"retng", TOKEN_RETNG},
-    {"retg", TOKEN_RETG},
-    {"retns", TOKEN_RETNS},
-    {"rets", TOKEN_RETS},
-    {"retge", TOKEN_RETGE},
-    {"retse", TOKEN_RETSE},
-    {"pusha", TOKEN_PUSHA},
-    {"popa", TOKEN_POPA},
-    {"outr", TOKEN_OUTR},
-    {"uoutr", TOKEN_UOUTR},
-    {"cflags", TOKEN_CFLAGS},
-    {"reset", TOKEN_RESET},
-    {"inc", TOKEN_INC},
-    {"dec", TOKEN_DEC},
-    {"not", TOKEN_NOT},
-    {"mov", TOKEN_MOV},
-    {"movb", TOKEN_MOVB},
-    {"movw", TOKEN_MOVW},
-    {"movd", TOKEN_MOVD},
-    {"movq", TOKEN_MOVQ},
-    {"movf", TOKEN_MOVF},
-    {"movf32", TOKEN_MOVF32},
-    {"movsxb", TOKEN_MOVSXB},
-    {"movsxw", TOKEN_MOVSXW},
-    {"movsxd", TOKEN_MOVSXD},
-    {"excgb", TOKEN_EXCGB},
-    {"excgw", TOKEN_EXCGW},
-    {"excgd", TOKEN_EXCGD},
-    {"excgq", TOKEN_EXCGQ},
-    {"moveb", TOKEN_MOVEB},
-    {"movew", TOKEN_MOVEW},
-    {"moved", TOKEN_MOVED},
-    {"moveq", TOKEN_MOVEQ},
-    {"movnz", TOKEN_MOVNZ},
-    {"movz", TOKEN_MOVZ},
-    {"movne", TOKEN_MOVNE},
-    {"move", TOKEN_MOVE},
-    {"movnc", TOKEN_MOVNC},
-    {"movc", TOKEN_MOVC},
-    {"movno", TOKEN_MOVNO},
-    {"movo", TOKEN_MOVO},
-    {"movnn", TOKEN_MOVNN},
-    {"movn", TOKEN_MOVN},
-    {"movng", TOKEN_MOVNG},
-    {"movg", TOKEN_MOVG},
-    {"movns", TOKEN_MOVNS},
-    {"movs", TOKEN_MOVS},
-    {"movge", TOKEN_MOVGE},
-    {"movse", TOKEN_MOVSE},
-    {"jnz", TOKEN_JNZ},
-    {"jz", TOKEN_JZ},
-    {"jne", TOKEN_JNE},
-    {"je", TOKEN_JE},
-    {"jnc", TOKEN_JNC},
-    {"jc", TOKEN_JC},
-    {"jno", TOKEN_JNO},
-    {"jo", TOKEN_JO},
-    {"jnn", TOKEN_JNN},
-    {"jn", TOKEN_JN},
-    {"jng", TOKEN_JNG},
-    {"jg", TOKEN_JG},
-    {"jns", TOKEN_JNS},
-    {"js", TOKEN_JS},
-    {"jge", TOKEN_JGE},
-    {"jse", TOKEN_JSE},
-    {"int", TOKEN_INT},
-    {"jmp", TOKEN_JMP},
-    {"call", TOKEN_CALL},
-    {"pushb", TOKEN_PUSHB},
-    {"pushw", TOKEN_PUSHW},
-    {"pushd", TOKEN_PUSHD},
-    {"pushq", TOKEN_PUSHQ},
-    {"push", TOKEN_PUSH},
-    {"popb", TOKEN_POPB},
-    {"popw", TOKEN_POPW},
-    {"popd", TOKEN_POPD},
-    {"popq", TOKEN_POPQ},
-    {"loop", TOKEN_LOOP},
-    {"loadsb", TOKEN_LOADSB},
-    {"loadsw", TOKEN_LOADSW},
-    {"loadsd", TOKEN_LOADSD},
-    {"loadsq", TOKEN_LOADSQ},
-    {"storesb", TOKEN_STORESB},
-    {"storesw", TOKEN_STORESW},
-    {"storesd", TOKEN_STORESD},
-    {"storesq", TOKEN_STORESQ},
-    {"fcmp", TOKEN_FCMP},
-    {"fcmp32", TOKEN_FCMP32},
-    {"cin", TOKEN_CIN},
-    {"cout", TOKEN_COUT},
-    {"sin", TOKEN_SIN},
-    {"sout", TOKEN_SOUT},
-    {"in", TOKEN_IN},
-    {"out", TOKEN_OUT},
-    {"inw", TOKEN_INW},
-    {"outw", TOKEN_OUTW},
-    {"ind", TOKEN_IND},
-    {"outd", TOKEN_OUTD},
-    {"inq", TOKEN_INQ},
-    {"outq", TOKEN_OUTQ},
-    {"uin", TOKEN_UIN},
-    {"uout", TOKEN_UOUT},
-    {"uinw", TOKEN_UINW},
-    {"uoutw", TOKEN_UOUTW},
-    {"uind", TOKEN_UIND},
-    {"uoutd", TOKEN_UOUTD},
-    {"uinq", TOKEN_UINQ},
-    {"uoutq", TOKEN_UOUTQ},
-    {"inf", TOKEN_INF},
-    {"outf", TOKEN_OUTF},
-    {"inf32", TOKEN_INF32},
-    {"outf32", TOKEN_OUTF32},
-    {"loadb", TOKEN_LOADB},
-    {"loadw", TOKEN_LOADW},
-    {"loadd", TOKEN_LOADD},
-    {"loadq", TOKEN_LOADQ},
-    {"storeb", TOKEN_STOREB},
-    {"storew", TOKEN_STOREW},
-    {"stored", TOKEN_STORED},
-    {"storeq", TOKEN_STOREQ},
-    {"whdlr", TOKEN_WHDLR},
-    {"lea", TOKEN_LEA},
-    {"cmpxchg", TOKEN_CMPXCHG},
-    {"atm", TOKEN_ATM}};
-
-std::pair<bool, token_t> belongs_to_keymap(std::string name);
+std::pair<bool, token_t> belongs_to_keymap(std::string_view name);
 }; // namespace masm
 
 #endif
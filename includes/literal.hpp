@@ -0,0 +1,32 @@
+#ifndef _LITERAL_
+#define _LITERAL_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace masm {
+// A numeric literal, converted to its binary value once by the lexer.
+// Integers are kept as they would come out of strtoull(negative values wrap
+// around) and floats are kept both as double and float since the
+// instruction decides which one gets encoded.
+struct Literal {
+  union {
+    uint64_t u = 0; // !is_float
+    double f64;     // is_float
+  };
+  float f32 = 0;
+  bool is_float = false;
+  bool negative = false;
+  uint8_t base = 10; // 2, 8, 10 or 16; for diagnostics
+
+  // The bits to encode for an operand 'len' bytes long
+  uint64_t bits(size_t len) const;
+};
+
+// 'text' is the literal as written(with the sign and the 0x, 0o or 0b
+// prefix, if any)
+Literal parse_literal(std::string_view text, uint8_t base, bool is_float);
+}; // namespace masm
+
+#endif
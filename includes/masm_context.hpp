@@ -18,6 +18,27 @@ static std::string HELP_MSG =
     "-I                      - Add a new include path\n"
     "-o                      - Provide a output path along for the generated "
     "binary\n"
+    "--mmap                  - Write the output through a memory mapped "
+    "file, filling the sections in parallel\n"
+    "--stats                 - Display statistics about the output\n"
+    "--pack                  - Fill the alignment padding of the data "
+    "section with byte sized variables\n"
+    "--map                   - Display the address of every variable\n"
+    "--shake                 - Drop the procedures and variables that "
+    "main never reaches\n"
+    "--peephole              - Remove the instructions that have no effect\n"
+    "--no-shorten            - Don't encode the moves of small immediates "
+    "in one qword\n"
+    "--relative              - Encode jmp with an offset; code without "
+    "any other reference to code is marked position independent\n"
+    "--thread                - Send jumps and calls to a jmp straight to "
+    "where it goes and remove the code that is no longer reached\n"
+    "--dce                   - Remove the moves and loads to registers that "
+    "are never read\n"
+    "--cfg                   - Write the control flow graph to the given "
+    "file as DOT(JSON if it ends with .json)\n"
+    "--no-isolate            - Don't give the variables used by the atomic "
+    "instructions a cache line each\n"
     "\nMasm - An assembler for the Merry Virtual Machine\n";
 
 static std::string VERSION =
@@ -42,20 +63,22 @@ static std::string DISCLAIMER =
 
 class MasmContext {
   uint64_t d_address = 0;
+  uint64_t bss_start = 0; // the end of the strings
 
-  std::unordered_map<std::string, std::pair<value_t, std::string>> CONSTANTS;
-  std::unordered_set<std::string> LABELS;
   SymbolTable symtable;
-  std::unordered_map<std::string, uint64_t> label_addresses;
-  std::unordered_map<std::string, uint64_t> data_addresses;
+  Arena arena; // the nodes of every file
   std::vector<std::filesystem::path> include_paths;
+  std::vector<uint8_t> rodata; // the variables that are never written
   std::vector<uint8_t> data;
   std::vector<uint8_t> string;
 
+  FileTable files; // every parsed file
+
   std::vector<FileContext> contexts;
   std::vector<std::string> input_files;
 
   std::string output_file = "./M.mbin";
+  std::string cfg_file; // --cfg
 
   std::vector<std::string> cmd_options;
 
@@ -66,8 +89,14 @@ class MasmContext {
   struct {
     bool help = false, version = false;
     bool disclaimer = false;
+    bool mmap = false;
+    bool stats = false;
+    bool map = false;
+    bool shake = false;
   } CMD;
 
+  GenOptions gen_options;
+
 public:
   MasmContext(int, char **);
 
@@ -77,6 +106,12 @@ public:
 
   void display_version();
 
+  void display_stats();
+
+  void display_layout();
+
+  void display_shake_report(ShakeReport &report);
+
   // preparing for assembling
   bool parse_cmd_options();
 
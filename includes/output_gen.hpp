@@ -3,11 +3,12 @@
 
 #include <consts.hpp>
 #include <filesystem>
-#include <fstream>
 #include <gen_base.hpp>
+#include <span>
 #include <utils.hpp>
 #include <vector>
 
+#define HEADER_LEN 56
 #define ITIT_HEADER_LEN 16
 #define DATA_HEADER_LEN 8
 #define STRING_HEADER_LEN 8
@@ -19,24 +20,82 @@ struct GeneratorDetails {
   std::string magic = "beb"; // bROADLY eMTTED bINARY
   output_file_t type = NORMAL_FILE_TYPE;
   size_t number_of_different_ISA_used; // FOR ITIT
+  size_t rodata_section_length; // loaded at address 0, never written
   size_t data_section_length;
   size_t string_section_length;
+  size_t bss_section_length = 0; // zero filled by the VM; not in the file
   size_t DIT_len = 0; // For proper Assemblers
-  std::vector<std::pair<file_t, std::vector<Inst64>>> instructions;
-  std::vector<uint8_t> data;
-  std::vector<uint8_t> string;
+  // The code can be loaded at any address(the 5th byte of the magic)
+  bool position_independent = false;
+  // The sections are borrowed from the contexts that generated them, which
+  // must outlive the Generator
+  std::vector<std::pair<file_t, std::span<const Inst64>>> instructions;
+  std::span<const uint8_t> rodata;
+  std::span<const uint8_t> data;
+  std::span<const uint8_t> string;
 
   Inst64 entry_inst;
   std::string output_file_path;
+
+  // Map the output file and fill its sections from several threads
+  bool mapped_output = false;
 };
 
+// Store 'count' qwords at 'dst' in the byte order of the output
+// file(little endian). On little endian hosts this is a plain copy;
+// otherwise every qword is byte swapped, which the compiler vectorizes.
+void store_qwords(uint8_t *dst, const uint64_t *src, size_t count);
+
+// The output file is described as a list of pieces in file order: small
+// ones(the header, ITIT and entry jumps) are serialized by emit_* into a
+// side buffer while the sections are borrowed from GeneratorDetails as
+// they are. write_out then puts the pieces in the file.
+// Normally that is a single writev straight from the sections. With
+// 'mapped_output' the file is a temporary one next to the output,
+// truncated to its final size(known after pre_emission) and mapped; the
+// pieces are copied into the mapping by several threads and the file is
+// renamed over the output once complete so that a reader never sees a
+// partial file.
+// All the values in the file are little endian.
 class Generator {
-  std::fstream file;
+  struct Piece {
+    const uint8_t *src; // nullptr: 'at' into 'small'
+    size_t at;
+    size_t len;  // in bytes
+    bool qwords; // needs store_qwords rather than a plain copy
+  };
+
+  int fd = -1;
   GeneratorDetails &details;
 
+  std::vector<uint8_t> small;
+  std::vector<Piece> pieces;
+  size_t image_len = 0;
+
+  uint8_t *image = nullptr; // with mapped_output
+  std::string temp_path;    // with mapped_output, until it is renamed
+
+  void put(uint64_t value);
+
+  void put(const uint8_t *bytes, size_t len);
+
+  void plan(const void *src, size_t len, bool qwords);
+
+  bool map_image();
+
+  void fill_image();
+
+  bool write_pieces();
+
 public:
   Generator(GeneratorDetails &);
 
+  Generator(const Generator &) = delete;
+
+  Generator &operator=(const Generator &) = delete;
+
+  ~Generator();
+
   bool pre_emission();
 
   bool emit_header();
@@ -45,9 +104,13 @@ public:
 
   bool emit_Instructions();
 
+  bool emit_rodata_section();
+
   bool emit_data_section();
 
   bool emit_string_section();
+
+  bool write_out();
 };
 
 }; // namespace masm
@@ -5,56 +5,62 @@
 #include <lexer.hpp>
 #include <memory>
 #include <nodes.hpp>
+#include <source_file.hpp>
 #include <string>
 #include <utils.hpp>
 #include <vector>
 
 namespace masm {
 class GPCParser {
-  std::vector<Node> nodes;
+  NodeList nodes;
+  SourceFile &src;
+  SymbolTable &symtable;
   std::filesystem::path file;
+  TokenStream tokens;
 
 public:
-  GPCParser(std::string path);
+  GPCParser(SourceFile &source, SymbolTable &table, Arena &arena);
 
   bool parse();
 
-  std::vector<Node> getNodes();
+  NodeList getNodes();
+
+  TokenStream &get_tokens();
 
   value_t figure_out_type(token_t t);
 
-  bool handle_simple_instructions(node_t type);
+  bool handle_simple_instructions(Token inst, node_t type);
 
-  bool handle_include_directory(Lexer &lexer);
+  bool handle_include_directory(TokenStream &tokens);
 
-  bool handle_const_definition(Lexer &lexer);
+  bool handle_const_definition(TokenStream &tokens);
 
-  bool handle_variable_defn(Lexer &lexer, Token name);
+  bool handle_variable_defn(TokenStream &tokens, Token name);
 
   bool handle_label(Token name);
-  bool handle_dX(Lexer &lexer, Token name);
-  bool handle_ds(Lexer &lexer, Token name);
-  bool handle_df_dlf(Lexer &lexer, Token name);
-  bool handle_resX(Lexer &lexer, Token name);
+  bool handle_dX(TokenStream &tokens, Token name);
+  bool handle_ds(TokenStream &tokens, Token name);
+  bool handle_df_dlf(TokenStream &tokens, Token name);
+  bool handle_resX(TokenStream &tokens, Token name);
 
-  bool handle_instructions_with_reg_reg_or_reg_imm(Lexer &lexer, Token inst,
+  bool handle_instructions_with_reg_reg_or_reg_imm(TokenStream &tokens, Token inst,
                                                    node_t t);
 
-  bool handle_instructions_with_reg(Lexer &lexer, node_t t);
+  bool handle_instructions_with_reg(TokenStream &tokens, node_t t);
 
-  bool handle_instructions_with_reg_reg(Lexer &lexer, node_t type);
+  bool handle_instructions_with_reg_reg(TokenStream &tokens, node_t type);
 
-  bool handle_instructions_with_reg_imm(Lexer &lexer, node_t type);
+  bool handle_instructions_with_reg_imm(TokenStream &tokens, node_t type);
 
-  bool handle_instructions_with_imm(Lexer &lexer, node_t type);
+  bool handle_instructions_with_imm(TokenStream &tokens, node_t type);
 
-  bool handle_instructions_with_imm_or_reg(Lexer &lexer, node_t type);
+  bool handle_instructions_with_imm_or_reg(TokenStream &tokens, node_t type);
 
-  bool handle_lea(Lexer &lexer);
+  bool handle_lea(TokenStream &tokens);
 
-  bool handle_cmpxchg(Lexer &lexer);
+  bool handle_cmpxchg(TokenStream &tokens);
 
-  bool handle_atm_inst(Lexer &lexer);
+  bool handle_atm_inst(TokenStream &tokens);
 };
 }; // namespace masm
 
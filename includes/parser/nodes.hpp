@@ -1,10 +1,13 @@
 #ifndef _NODES_
 #define _NODES_
 
-#include <filesystem>
+#include <arena.hpp>
 #include <lexer_base.hpp>
-#include <memory>
+#include <source_file.hpp>
+#include <string_view>
 #include <symboltable.hpp>
+#include <type_traits>
+#include <vector>
 
 namespace masm {
 enum node_t {
@@ -246,24 +249,32 @@ enum node_t {
   NODE_WHDLR,
   NODE_LEA,
   NODE_CMPXCHG_IMM,
-  NODE_CMPXCHG_REG
+  NODE_CMPXCHG_REG,
+  NODE_COUNT, // not a node; keep this last
 };
 
+// Every string in a node is a view into the SourceFile it was parsed from.
+// Numeric values are carried in 'lit' and the matching string is just the
+// text they were written as.
+// Identifiers are their IDs in the SymbolTable.
 struct NodeBase {};
 
 struct NodeIncDir : public NodeBase {
-  std::string path_included;
+  std::string_view path_included;
 };
 
 struct NodeConstDef : public NodeBase {
-  std::string const_name;
-  std::string const_value;
+  uint32_t const_name;
+  std::string_view const_value;
+  Literal lit;
   value_t type;
 };
 
 struct NodeDB : public NodeBase {
-  std::string name;
-  std::string value;
+  uint32_t name;
+  std::string_view value;
+  uint32_t value_id = NO_ID; // when the value is an identifier
+  Literal lit;
   value_t type;
 };
 
@@ -284,13 +295,14 @@ struct NodeRESS : public NodeRESB {};
 struct NodeRESF : public NodeRESB {};
 
 struct NodeLabel : public NodeBase {
-  std::string name;
+  uint32_t name;
 };
 
 // GPC Instruction Nodes
 struct NodeRegrImm : public NodeBase {
   token_t regr;
-  std::string immediate;
+  uint32_t name = NO_ID; // when the operand is an identifier
+  Literal lit;
   value_t type;
   bool is_var = false;
 };
@@ -304,7 +316,8 @@ struct NodeReg : public NodeBase {
 };
 
 struct NodeImm : public NodeBase {
-  std::string imm;
+  uint32_t name = NO_ID; // when the operand is an identifier
+  Literal lit;
   value_t type;
   bool is_var = false;
 };
@@ -315,7 +328,8 @@ struct NodeLea : public NodeBase {
 
 struct NodeCMPXCHGImm : public NodeBase {
   token_t r1, r2;
-  std::string imm;
+  uint32_t name = NO_ID;
+  Literal lit;
   value_t type;
 };
 
@@ -323,13 +337,37 @@ struct NodeCMPXCHGReg : public NodeBase {
   token_t r1, r2, r3;
 };
 
+// The operands of every kind of node
+union NodeOperands {
+  NodeIncDir inc;
+  NodeConstDef const_def;
+  NodeDB db;
+  NodeLabel label;
+  NodeRegrImm regr_imm;
+  NodeRegReg regr_regr;
+  NodeReg regr;
+  NodeImm imm;
+  NodeLea lea;
+  NodeCMPXCHGImm cmpxchg_imm;
+  NodeCMPXCHGReg cmpxchg_reg;
+
+  NodeOperands() {}
+};
+
+// A node is fixed size with the operands inline so that the nodes of a
+// file are one contiguous array(in the Arena) instead of one allocation per
+// node. The operands are constructed in place(see GPCParser).
 struct Node {
-  size_t len = 1;
   node_t type;
-  size_t line;
-  std::filesystem::path file;
-  std::unique_ptr<NodeBase> node;
+  uint32_t len = 1;
+  SourceLoc loc;
+  NodeOperands node; // which one depends on 'type'
 };
+
+static_assert(std::is_trivially_copyable_v<Node>,
+              "Nodes are moved around as plain bytes");
+
+typedef std::vector<Node, ArenaAllocator<Node>> NodeList;
 }; // namespace masm
 
 #endif
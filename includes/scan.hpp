@@ -0,0 +1,27 @@
+#ifndef _SCAN_
+#define _SCAN_
+
+#include <cstddef>
+
+namespace masm {
+// Vectorized scanning used by the lexer.
+// There are AVX2 and SSE2 versions on x86 and a portable one everywhere
+// else. The best one the CPU supports is picked once at startup.
+// Every function returns 'end' if nothing was found.
+
+// Skip whitespace and ','. 'line' is incremented for every '\n' skipped.
+const char *skip_blank(const char *iter, const char *end, size_t &line);
+
+// Find the '\n' that ends a comment.
+const char *find_newline(const char *iter, const char *end);
+
+// Find the next '"' or '\\' in a string literal. 'line' is incremented for
+// every '\n' before it.
+const char *find_string_special(const char *iter, const char *end,
+                                size_t &line);
+
+// The name of the implementation in use("avx2", "sse2" or "portable")
+const char *scan_implementation();
+}; // namespace masm
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef _SOURCE_FILE_
+#define _SOURCE_FILE_
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utils.hpp>
+#include <vector>
+
+namespace masm {
+// The contents of an input file.
+// The file is memory mapped whenever possible so that tokens can simply be
+// views into it. Files that cannot be mapped(empty files, pipes etc) are read
+// into a buffer instead.
+// Every view handed out by this is valid for as long as this object lives.
+class SourceFile {
+  std::filesystem::path path;
+  uint32_t id; // in the FileTable
+  const char *contents = nullptr;
+  size_t size = 0;
+  bool mapped = false;
+
+  std::string buffer; // when the file couldn't be mapped
+
+  // Unescaped string literals. Offsets into this start right after the
+  // contents so that a single (offset, length) pair can refer to either.
+  // Only appended to while lexing; views are handed out after that.
+  std::string literals;
+
+public:
+  SourceFile(std::filesystem::path p, uint32_t id);
+
+  SourceFile(const SourceFile &) = delete;
+
+  SourceFile &operator=(const SourceFile &) = delete;
+
+  ~SourceFile();
+
+  bool open();
+
+  const char *begin();
+
+  const char *end();
+
+  size_t length();
+
+  std::filesystem::path &get_path();
+
+  uint32_t get_id();
+
+  uint32_t keep_literal(std::string_view lit);
+
+  std::string_view view(uint32_t offset, uint32_t len);
+};
+
+// Where a node came from. The file is an ID into the FileTable and only
+// turned back into a path when a diagnostic is printed.
+struct SourceLoc {
+  uint32_t file = 0;
+  uint32_t line = 0;
+};
+
+// Every file that was parsed, in the order they were parsed.
+// The files are kept alive until emission since the nodes refer to them.
+class FileTable {
+  std::vector<std::unique_ptr<SourceFile>> files;
+
+public:
+  FileTable() = default;
+
+  FileTable(const FileTable &) = delete;
+
+  FileTable &operator=(const FileTable &) = delete;
+
+  SourceFile &add(std::filesystem::path p);
+
+  SourceFile &operator[](uint32_t id);
+
+  const char *path(uint32_t id);
+
+  const char *path(SourceLoc loc);
+
+  size_t size();
+};
+}; // namespace masm
+
+#endif
@@ -1,8 +1,10 @@
 #ifndef _SYMTABLE_
 #define _SYMTABLE_
 
-#include <string>
-#include <unordered_map>
+#include <interner.hpp>
+#include <literal.hpp>
+#include <string_view>
+#include <vector>
 #include <utils.hpp>
 
 namespace masm {
@@ -31,24 +33,51 @@ enum data_t {
   RESQ
 };
 
+// A constant from 'define'
+struct Constant {
+  value_t type;
+  std::string_view value; // as written
+  Literal lit;
+};
+
+// Everything known about one identifier, indexed by its ID.
+// A name may be a constant and a variable(or label) at the same time; the
+// analyzer decides which one an operand refers to.
 struct Symbol {
+  bool is_const = false;
+  bool is_label = false;
+  bool is_var = false;
+
+  Constant constant;
+
+  // variables
   data_t type;
-  std::string value;
   value_t val_type;
+  uint64_t data_address = 0;
+  bool is_atomic = false;  // operand of an atomic instruction somewhere
+  bool is_written = false; // stored to somewhere or pointed to
+
+  // labels
+  uint64_t label_address = 0;
 };
 
 class SymbolTable {
-  std::unordered_map<std::string, Symbol> table;
+  Interner names;
+  std::vector<Symbol> symbols;
 
 public:
   SymbolTable() = default;
 
-  void add_symbol(std::string name, Symbol value);
+  uint32_t intern(std::string_view name);
+
+  // NO_ID if the name was never seen
+  uint32_t find(std::string_view name);
+
+  const std::string &name(uint32_t id);
 
-  bool symbol_exists(std::string name);
+  Interner &get_interner();
 
-  std::unordered_map<std::string, Symbol>::iterator
-  find_symbol(std::string name);
+  Symbol &operator[](uint32_t id);
 
   void list_symbols(); // debugging function
 };
@@ -0,0 +1,63 @@
+#ifndef _TOKEN_STREAM_
+#define _TOKEN_STREAM_
+
+#include <cstdint>
+#include <lexer_base.hpp>
+#include <source_file.hpp>
+#include <vector>
+
+namespace masm {
+// The tokens of an entire file, lexed once.
+// Stored as separate arrays(kind, offset, length and line) so that a pass
+// only interested in the kinds doesn't have to walk through the rest.
+// The offsets are into the SourceFile(see SourceFile::view) except for the
+// numeric tokens whose offset is an index into 'numbers' and identifiers
+// whose offset is their interned ID.
+// The last token is always TOKEN_EOF.
+class TokenStream {
+  std::vector<uint8_t> kinds;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> lengths;
+  std::vector<uint32_t> lines;
+
+  struct Number {
+    Literal lit;
+    uint32_t offset; // of the text
+  };
+  std::vector<Number> numbers;
+
+  SourceFile *src = nullptr;
+  Interner *names = nullptr;
+  size_t pos = 0;
+
+public:
+  TokenStream() = default;
+
+  void set_source(SourceFile *source, Interner *interner);
+
+  void reserve(size_t n);
+
+  void push(token_t kind, uint32_t offset, uint32_t len, uint32_t line);
+
+  void push_number(token_t kind, uint32_t offset, uint32_t len, uint32_t line,
+                   Literal lit);
+
+  size_t size();
+
+  token_t kind(size_t i);
+
+  Token at(size_t i);
+
+  Token next_token();
+
+  Token peek_token();
+
+  void rewind();
+};
+
+bool is_numeric_token(token_t t);
+
+static_assert(TOKEN_ATM <= UINT8_MAX, "token_t doesn't fit in a byte anymore");
+}; // namespace masm
+
+#endif
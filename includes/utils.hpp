@@ -3,7 +3,7 @@
 
 #include <stdio.h>
 
-#define detailed_message(file, line,  msg, ...) fprintf(stderr, "%s: %zu: " msg "\n", file, line, __VA_ARGS__)
+#define detailed_message(file, line,  msg, ...) fprintf(stderr, "%s: %zu: " msg "\n", file, (size_t)(line), __VA_ARGS__)
 
 #define simple_message(msg, ...) fprintf(stderr, msg "\n", __VA_ARGS__)
 
@@ -0,0 +1,22 @@
+#include <arena.hpp>
+
+void *masm::Arena::allocate(size_t size, size_t align) {
+  used += size;
+  // Anything big gets a block of its own so that the current block isn't
+  // thrown away for it
+  if (size > BLOCK_SIZE / 4) {
+    blocks.push_back(std::unique_ptr<char[]>(new char[size]));
+    return blocks.back().get();
+  }
+  uintptr_t at = ((uintptr_t)curr + align - 1) & ~(uintptr_t)(align - 1);
+  if (curr == nullptr || at + size > (uintptr_t)end) {
+    blocks.push_back(std::unique_ptr<char[]>(new char[BLOCK_SIZE]));
+    curr = blocks.back().get();
+    end = curr + BLOCK_SIZE;
+    at = ((uintptr_t)curr + align - 1) & ~(uintptr_t)(align - 1);
+  }
+  curr = (char *)(at + size);
+  return (void *)at;
+}
+
+size_t masm::Arena::bytes_used() { return used; }
@@ -1,14 +1,14 @@
 #include <filecontext.hpp>
 
-masm::FileContext::FileContext(
-    std::vector<std::filesystem::path> &i_paths,
-    std::unordered_map<std::string, std::pair<value_t, std::string>> &C,
-    std::unordered_set<std::string> &L, SymbolTable &sym,
-    std::unordered_map<std::string, uint64_t> &laddr,
-    std::unordered_map<std::string, uint64_t> &daddr, std::vector<uint8_t> &D,
-    std::vector<uint8_t> &S, uint64_t d_addr)
-    : CONSTANTS(C), LABELS(L), symtable(sym), label_addresses(laddr),
-      data_addresses(daddr), include_paths(i_paths), data(D), string(S) {
+masm::FileContext::FileContext(std::vector<std::filesystem::path> &i_paths,
+                               SymbolTable &sym, Arena &arena,
+                               FileTable &files, std::vector<uint8_t> &R,
+                               std::vector<uint8_t> &D,
+                               std::vector<uint8_t> &S,
+                               const GenOptions &options, uint64_t d_addr)
+    : symtable(sym), arena(arena), include_paths(i_paths), files(files),
+      rodata(R), data(D), string(S), options(options),
+      nodes(ArenaAllocator<Node>(arena)), tmp(ArenaAllocator<Node>(arena)) {
   this->d_addr = d_addr;
 }
 
@@ -25,10 +25,9 @@ bool masm::FileContext::deduce_file_type(std::filesystem::path path) {
 
   if (fpath.ends_with(".gpc.masm")) {
     type = GPC;
-    analyzer =
-        std::make_unique<GPCAnalyzer>(GPCAnalyzer(CONSTANTS, LABELS, symtable));
-    gen = std::make_unique<GPCGen>(GPCGen(
-        symtable, label_addresses, data_addresses, data, string, d_addr));
+    analyzer = std::make_unique<GPCAnalyzer>(GPCAnalyzer(symtable, files, arena));
+    gen = std::make_unique<GPCGen>(
+        GPCGen(symtable, arena, rodata, data, string, options, d_addr));
   } else {
     simple_message("Unknown File Type: %s", fpath.c_str());
     return false;
@@ -55,7 +54,7 @@ std::unordered_set<std::filesystem::path> masm::FileContext::get_imports() {
   return std::move(imports);
 }
 
-std::vector<masm::Node> masm::FileContext::get_nodes() {
+masm::NodeList masm::FileContext::get_nodes() {
   return std::move(nodes);
 }
 
@@ -68,7 +67,7 @@ void masm::FileContext::set_imports(
   imports = std::move(f);
 }
 
-void masm::FileContext::set_nodes(std::vector<Node> &&n) {
+void masm::FileContext::set_nodes(NodeList &&n) {
   nodes = std::move(n);
 }
 
@@ -110,8 +109,13 @@ bool masm::FileContext::should_process_file() {
 }
 
 bool masm::FileContext::parse_file() {
+  // The nodes refer to the source so it must live until the generation is
+  // done. MasmContext owns it.
+  SourceFile &src = files.add(wp);
+  if (!src.open())
+    return false;
 
-  GPCParser parser(wp.string());
+  GPCParser parser(src, symtable, arena);
 
   if (!parser.parse()) {
     simple_message("While processing file %s...", wp.c_str());
@@ -124,6 +128,7 @@ bool masm::FileContext::parse_file() {
 }
 
 bool masm::FileContext::pre_analysis() {
+  nodes.reserve(nodes.size() + tmp.size());
   for (auto &n : tmp) {
     switch (n.type) {
     case INCLUDE_DIR: {
@@ -156,8 +161,19 @@ bool masm::FileContext::analyze_file_second_step() {
   return analyzer->second_loop();
 }
 
-bool masm::FileContext::gen_file_first_step(uint64_t addr_point) {
+void masm::FileContext::shake(ShakeReport &report) {
+  analyzer->shake(report);
+}
+
+bool masm::FileContext::gen_file_first_step_rodata_phase(uint64_t addr) {
   gen->set_final_nodes(analyzer->get_result());
+  gen->optimize();
+  bool ret = gen->first_iteration_rodata_phase(addr);
+  d_addr = gen->get_current_address_point();
+  return ret;
+}
+
+bool masm::FileContext::gen_file_first_step(uint64_t addr_point) {
   bool ret = gen->first_iteration(addr_point);
   d_addr = gen->get_current_address_point();
   return ret;
@@ -169,6 +185,12 @@ bool masm::FileContext::gen_file_first_step_second_phase(uint64_t addr) {
   return ret;
 }
 
+bool masm::FileContext::gen_file_first_step_bss_phase(uint64_t addr) {
+  bool ret = gen->first_iteration_bss_phase(addr);
+  d_addr = gen->get_current_address_point();
+  return ret;
+}
+
 bool masm::FileContext::gen_file_first_step_third_phase(uint64_t addr) {
   bool ret = gen->first_iteration_third_phase(addr);
   d_addr = gen->get_current_address_point();
@@ -179,18 +201,36 @@ bool masm::FileContext::gen_file_second_step() {
   return gen->second_iteration();
 }
 
-std::vector<masm::Inst64> masm::FileContext::get_instructions() {
+std::span<const masm::Inst64> masm::FileContext::get_instructions() {
   return gen->get_instructions();
 }
 
-std::vector<uint8_t> masm::FileContext::get_data() { return gen->get_data(); }
+std::span<const uint8_t> masm::FileContext::get_data() {
+  return gen->get_data();
+}
+
+const masm::GenStats &masm::FileContext::get_stats() {
+  return gen->get_stats();
+}
+
+bool masm::FileContext::is_position_independent() {
+  return gen->is_position_independent();
+}
+
+bool masm::FileContext::export_cfg(const std::string &path) {
+  return gen->export_cfg(path);
+}
+
+void masm::FileContext::collect_layout(std::vector<LayoutItem> &items) {
+  gen->collect_layout(items);
+}
 
 bool masm::FileContext::file_includes_another_file(Node &node) {
-  NodeIncDir *dir = (NodeIncDir *)node.node.get();
-  FileContext child(include_paths, CONSTANTS, LABELS, symtable, label_addresses,
-                    data_addresses, data, string, d_addr);
+  NodeIncDir *dir = (NodeIncDir *)&node.node;
+  FileContext child(include_paths, symtable, arena, files, rodata, data,
+                    string, options, d_addr);
 
-  if (!child.file_prepare(dir->path_included)) {
+  if (!child.file_prepare(std::string(dir->path_included))) {
     simple_message("While processing file %s...", wp.c_str());
     return false;
   }
@@ -199,9 +239,10 @@ bool masm::FileContext::file_includes_another_file(Node &node) {
     return true;
 
   if (!child.child_file_type_valid(type)) {
-    detailed_message(wp.c_str(), node.line,
-                     "Included file is not of the same type as parent[%s].",
-                     dir->path_included.c_str());
+    detailed_message(files.path(node.loc), node.loc.line,
+                     "Included file is not of the same type as parent[%.*s].",
+                     (int)dir->path_included.length(),
+                     dir->path_included.data());
     return false;
   }
 
@@ -225,13 +266,15 @@ bool masm::FileContext::file_includes_another_file(Node &node) {
 }
 
 bool masm::FileContext::constant_definition(Node &node) {
-  NodeConstDef *def = (NodeConstDef *)node.node.get();
+  NodeConstDef *def = (NodeConstDef *)&node.node;
 
   // Re-declaring a constant will just change its value.
   // We just have to check that the constant is not defined as a variable
   // already But we cannot check that just yet since we have yet to populate the
   // symtable. This part of processing is only to resolve include dependencies
   // and constant values
-  CONSTANTS[def->const_name] = std::make_pair(def->type, def->const_value);
+  Symbol &sym = symtable[def->const_name];
+  sym.is_const = true;
+  sym.constant = {def->type, def->const_value, def->lit};
   return true;
 }
@@ -1,11 +1,10 @@
 #include <gpc_analyzer.hpp>
 
-masm::GPCAnalyzer::GPCAnalyzer(
-    std::unordered_map<std::string, std::pair<value_t, std::string>> &c,
-    std::unordered_set<std::string> &l, SymbolTable &s)
-    : consts(c), labels(l), symtable(s) {}
+masm::GPCAnalyzer::GPCAnalyzer(SymbolTable &s, FileTable &f, Arena &arena)
+    : nodes(ArenaAllocator<Node>(arena)), symtable(s), files(f),
+      result(ArenaAllocator<Node>(arena)) {}
 
-void masm::GPCAnalyzer::set_nodes(std::vector<Node> &&nodes) {
+void masm::GPCAnalyzer::set_nodes(NodeList &&nodes) {
   this->nodes = std::move(nodes);
 }
 
@@ -15,72 +14,72 @@ bool masm::GPCAnalyzer::validate_defined_variables(Node &n) {
   case NODE_DD:
   case NODE_DW:
   case NODE_DB: {
-    NodeDB *b = (NodeDB *)n.node.get();
+    NodeDB *b = (NodeDB *)&n.node;
     if (b->type == VALUE_IDEN) {
-      std::unordered_map<std::string, std::pair<value_t, std::string>>::iterator
-          C = consts.find(b->value);
-      if (C == consts.end()) {
-        detailed_message(n.file.c_str(), n.line,
+      Symbol &C = symtable[b->value_id];
+      if (!C.is_const) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Unknown constant used in variable definition '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      std::pair<value_t, std::string> val = C->second;
-      if (val.first == VALUE_STRING || val.first == VALUE_FLOAT) {
-        detailed_message(n.file.c_str(), n.line,
+      Constant val = C.constant;
+      if (val.type == VALUE_STRING || val.type == VALUE_FLOAT) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Variable type and constant type doesn't match '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      b->value = val.second;
-      b->type = val.first;
+      b->value = val.value;
+      b->lit = val.lit;
+      b->type = val.type;
     }
     break;
   }
   case NODE_DS: {
-    NodeDS *b = (NodeDS *)n.node.get();
+    NodeDS *b = (NodeDS *)&n.node;
     if (b->type == VALUE_IDEN) {
-      std::unordered_map<std::string, std::pair<value_t, std::string>>::iterator
-          C = consts.find(b->value);
-      if (C == consts.end()) {
-        detailed_message(n.file.c_str(), n.line,
+      Symbol &C = symtable[b->value_id];
+      if (!C.is_const) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Unknown constant used in variable definition '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      std::pair<value_t, std::string> val = C->second;
-      if (val.first != VALUE_STRING) {
-        detailed_message(n.file.c_str(), n.line,
+      Constant val = C.constant;
+      if (val.type != VALUE_STRING) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Variable type and constant type doesn't match '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      b->value = val.second;
-      b->type = val.first;
+      b->value = val.value;
+      b->lit = val.lit;
+      b->type = val.type;
     }
     break;
   }
   case NODE_DLF:
   case NODE_DF: {
-    NodeDF *b = (NodeDF *)n.node.get();
+    NodeDF *b = (NodeDF *)&n.node;
     if (b->type == VALUE_IDEN) {
-      std::unordered_map<std::string, std::pair<value_t, std::string>>::iterator
-          C = consts.find(b->value);
-      if (C == consts.end()) {
-        detailed_message(n.file.c_str(), n.line,
+      Symbol &C = symtable[b->value_id];
+      if (!C.is_const) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Unknown constant used in variable definition '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      std::pair<value_t, std::string> val = C->second;
-      if (val.first != VALUE_FLOAT) {
-        detailed_message(n.file.c_str(), n.line,
+      Constant val = C.constant;
+      if (val.type != VALUE_FLOAT) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Variable type and constant type doesn't match '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      b->value = val.second;
-      b->type = val.first;
+      b->value = val.value;
+      b->lit = val.lit;
+      b->type = val.type;
     }
     break;
   }
@@ -99,47 +98,47 @@ bool masm::GPCAnalyzer::validate_reserved_variables(Node &n) {
   case NODE_RESD:
   case NODE_RESW:
   case NODE_RESB: {
-    NodeRESB *b = (NodeRESB *)n.node.get();
+    NodeRESB *b = (NodeRESB *)&n.node;
     if (b->type == VALUE_IDEN) {
-      std::unordered_map<std::string, std::pair<value_t, std::string>>::iterator
-          C = consts.find(b->value);
-      if (C == consts.end()) {
-        detailed_message(n.file.c_str(), n.line,
+      Symbol &C = symtable[b->value_id];
+      if (!C.is_const) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Unknown constant used in variable definition '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      std::pair<value_t, std::string> val = C->second;
-      if (val.first != VALUE_INTEGER) {
-        detailed_message(n.file.c_str(), n.line,
-                         "Not a valid length for resX '%s'.", b->value.c_str());
+      Constant val = C.constant;
+      if (val.type != VALUE_INTEGER) {
+        detailed_message(files.path(n.loc), n.loc.line,
+                         "Not a valid length for resX '%s'.", symtable.name(b->value_id).c_str());
         return false;
       }
-      if (val.second.starts_with('-')) {
-        detailed_message(n.file.c_str(), n.line,
+      if (val.lit.negative) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Cannot have negative length for resX '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      if (val.second == "0") {
-        detailed_message(n.file.c_str(), n.line,
+      if (val.lit.u == 0) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Cannot have zero length for resX '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      b->value = val.second;
-      b->type = val.first;
+      b->value = val.value;
+      b->lit = val.lit;
+      b->type = val.type;
     } else {
-      if (b->value.starts_with('-')) {
-        detailed_message(n.file.c_str(), n.line,
+      if (b->lit.negative) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Cannot have negative length for resX '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
-      if (b->value == "0") {
-        detailed_message(n.file.c_str(), n.line,
+      if (b->lit.u == 0) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Cannot have zero length for resX '%s'.",
-                         b->value.c_str());
+                         symtable.name(b->value_id).c_str());
         return false;
       }
     }
@@ -151,7 +150,7 @@ bool masm::GPCAnalyzer::validate_reserved_variables(Node &n) {
   return true;
 }
 
-std::vector<masm::Node> masm::GPCAnalyzer::get_result() {
+masm::NodeList masm::GPCAnalyzer::get_result() {
   return std::move(result);
 }
 
@@ -159,19 +158,19 @@ bool masm::GPCAnalyzer::first_loop() {
   for (Node &n : nodes) {
     switch (n.type) {
     case NODE_LABEL: {
-      NodeLabel *label = (NodeLabel *)n.node.get();
-      if (labels.find(label->name) != labels.end()) {
-        detailed_message(n.file.c_str(), n.line,
-                         "Re-declaration of label '%s'.", label->name.c_str());
+      NodeLabel *label = (NodeLabel *)&n.node;
+      if (symtable[label->name].is_label) {
+        detailed_message(files.path(n.loc), n.loc.line,
+                         "Re-declaration of label '%s'.", symtable.name(label->name).c_str());
         return false;
       }
-      if (symtable.symbol_exists(label->name)) {
-        detailed_message(n.file.c_str(), n.line,
+      if (symtable[label->name].is_var) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Re-declaration of variable as label '%s'.",
-                         label->name.c_str());
+                         symtable.name(label->name).c_str());
         return false;
       }
-      labels.insert(label->name);
+      symtable[label->name].is_label = true;
       break;
     }
     case NODE_DB:
@@ -181,22 +180,23 @@ bool masm::GPCAnalyzer::first_loop() {
     case NODE_DS:
     case NODE_DF:
     case NODE_DLF: {
-      NodeDB *dX = (NodeDB *)n.node.get();
-      if (labels.find(dX->name) != labels.end()) {
-        detailed_message(n.file.c_str(), n.line,
+      NodeDB *dX = (NodeDB *)&n.node;
+      if (symtable[dX->name].is_label) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Re-declaration of label as variable '%s'.",
-                         dX->name.c_str());
+                         symtable.name(dX->name).c_str());
         return false;
       }
-      if (symtable.symbol_exists(dX->name)) {
-        detailed_message(n.file.c_str(), n.line,
+      if (symtable[dX->name].is_var) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Variable '%s' already exists- redeclaration.",
-                         dX->name.c_str());
+                         symtable.name(dX->name).c_str());
         return false;
       }
       if (!validate_defined_variables(n))
         return false;
-      Symbol sym;
+      Symbol &sym = symtable[dX->name];
+      sym.is_var = true;
       sym.type = (n.type == NODE_DB)   ? BYTE
                  : (n.type == NODE_DW) ? WORD
                  : (n.type == NODE_DD) ? DWORD
@@ -204,8 +204,6 @@ bool masm::GPCAnalyzer::first_loop() {
                  : (n.type == NODE_DS) ? STRING
                                        : FLOAT;
       sym.val_type = dX->type;
-      sym.value = dX->value;
-      symtable.add_symbol(dX->name, sym);
       break;
     }
     case NODE_RESB:
@@ -215,22 +213,23 @@ bool masm::GPCAnalyzer::first_loop() {
     case NODE_RESF:
     case NODE_RESP:
     case NODE_RESLF: {
-      NodeRESB *resX = (NodeRESB *)n.node.get();
-      if (labels.find(resX->name) != labels.end()) {
-        detailed_message(n.file.c_str(), n.line,
+      NodeRESB *resX = (NodeRESB *)&n.node;
+      if (symtable[resX->name].is_label) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Re-declaration of label as variable '%s'.",
-                         resX->name.c_str());
+                         symtable.name(resX->name).c_str());
         return false;
       }
-      if (symtable.symbol_exists(resX->name)) {
-        detailed_message(n.file.c_str(), n.line,
+      if (symtable[resX->name].is_var) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Variable '%s' already exists- redeclaration.",
-                         resX->name.c_str());
+                         symtable.name(resX->name).c_str());
         return false;
       }
       if (!validate_reserved_variables(n))
         return false;
-      Symbol sym;
+      Symbol &sym = symtable[resX->name];
+      sym.is_var = true;
       sym.type = (n.type == NODE_RESB)   ? BYTE
                  : (n.type == NODE_RESW) ? WORD
                  : (n.type == NODE_RESD) ? DWORD
@@ -238,8 +237,6 @@ bool masm::GPCAnalyzer::first_loop() {
                  : (n.type == NODE_RESQ) ? QWORD
                                          : FLOAT;
       sym.val_type = resX->type;
-      sym.value = resX->value;
-      symtable.add_symbol(resX->name, sym);
       break;
     }
     default:
@@ -253,28 +250,28 @@ bool masm::GPCAnalyzer::first_loop() {
 bool masm::GPCAnalyzer::first_loop_second_phase() {
   for (auto &n : nodes) {
     if (n.type == NODE_DP) {
-      NodeDP *dp = (NodeDP *)n.node.get();
-      if (symtable.symbol_exists(dp->name)) {
-        detailed_message(n.file.c_str(), n.line,
+      NodeDP *dp = (NodeDP *)&n.node;
+      if (symtable[dp->name].is_var) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Variable '%s' already exists- redeclaration.",
-                         dp->name.c_str());
+                         symtable.name(dp->name).c_str());
         return false;
       }
-      auto if_label = labels.find(dp->value);
-      if (if_label == labels.end()) {
-        if (!symtable.symbol_exists(dp->value)) {
-          detailed_message(n.file.c_str(), n.line,
-                           "Variable '%s' for the pointer '%s' doesn't exist.",
-                           dp->value.c_str(), dp->name.c_str());
-          return false;
-        }
+      if (!symtable[dp->value_id].is_label &&
+          !symtable[dp->value_id].is_var) {
+        detailed_message(files.path(n.loc), n.loc.line,
+                         "Variable '%s' for the pointer '%s' doesn't exist.",
+                         symtable.name(dp->value_id).c_str(),
+                         symtable.name(dp->name).c_str());
+        return false;
       }
-      Symbol sym;
+      // Anything could be stored through the pointer
+      symtable[dp->value_id].is_written = true;
+      Symbol &sym = symtable[dp->name];
+      sym.is_var = true;
       sym.type = POINTER;
       sym.val_type = VALUE_INTEGER;
       dp->type = VALUE_INTEGER;
-      sym.value = dp->value;
-      symtable.add_symbol(dp->name, sym);
     }
   }
   return true;
@@ -298,25 +295,23 @@ bool masm::GPCAnalyzer::second_loop() {
     case NODE_MUL_IMM:
     case NODE_SUB_IMM:
     case NODE_ADD_IMM: {
-      NodeRegrImm *ri = (NodeRegrImm *)n.node.get();
+      NodeRegrImm *ri = (NodeRegrImm *)&n.node;
       if (ri->type == VALUE_IDEN) {
-        std::pair<bool, std::pair<masm::value_t, std::string>> c =
-            resolve_if_constant(ri->immediate, {VALUE_INTEGER, VALUE_BINARY,
+        std::pair<bool, masm::Constant> c =
+            resolve_if_constant(ri->name, {VALUE_INTEGER, VALUE_BINARY,
                                                 VALUE_HEX, VALUE_OCTAL});
 
         if (c.first) {
           // Indeed a constant
-          n.len = 2;
-          ri->immediate = c.second.second;
-          ri->type = c.second.first;
+          ri->lit = c.second.lit;
+          ri->type = c.second.type;
         } else {
           // Not a constant but could be a variable
-          if (resolve_variable(ri->immediate,
+          if (resolve_variable(ri->name,
                                {BYTE, WORD, DWORD, QWORD, POINTER})) {
             ri->is_var = true;
-            n.len = 1;
           } else {
-            detailed_message(n.file.c_str(), n.line,
+            detailed_message(files.path(n.loc), n.loc.line,
                              "Unknwon IMMEDIATE value type: Not a constant and "
                              "not a variable.",
                              NULL);
@@ -335,19 +330,18 @@ bool masm::GPCAnalyzer::second_loop() {
     case NODE_FMUL_IMM:
     case NODE_FSUB_IMM:
     case NODE_FADD_IMM: {
-      NodeRegrImm *ri = (NodeRegrImm *)n.node.get();
+      NodeRegrImm *ri = (NodeRegrImm *)&n.node;
       if (ri->type == VALUE_IDEN) {
-        if (resolve_variable(ri->immediate, {FLOAT})) {
+        if (resolve_variable(ri->name, {FLOAT})) {
           ri->is_var = true;
-          n.len = 1;
         } else {
           detailed_message(
-              n.file.c_str(), n.line,
+              files.path(n.loc), n.loc.line,
               "Expected VARIABLE as operand but got something else.", NULL);
           return false;
         }
       } else {
-        detailed_message(n.file.c_str(), n.line,
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Expected VARIABLE as operand but got something else.",
                          NULL);
         return false;
@@ -376,24 +370,21 @@ bool masm::GPCAnalyzer::second_loop() {
     case NODE_MOVGE:
     case NODE_MOVSE:
     case NODE_MOV: {
-      NodeRegrImm *ri = (NodeRegrImm *)n.node.get();
+      NodeRegrImm *ri = (NodeRegrImm *)&n.node;
       if (ri->type == VALUE_IDEN) {
         bool f = n.type == NODE_MOVF || n.type == NODE_MOVF32;
-        std::pair<bool, std::pair<masm::value_t, std::string>> c =
+        std::pair<bool, masm::Constant> c =
             resolve_if_constant(
-                ri->immediate,
+                ri->name,
                 f ? std::vector<value_t>{VALUE_FLOAT}
                   : std::vector<value_t>(
                         {VALUE_INTEGER, VALUE_BINARY, VALUE_HEX, VALUE_OCTAL}));
 
         if (c.first) {
-          if (n.type != NODE_MOVSXB_IMM && n.type != NODE_MOVSXW_IMM &&
-              n.type != NODE_MOVSXD_IMM)
-            n.len = 2;
-          ri->immediate = c.second.second;
-          ri->type = c.second.first;
+          ri->lit = c.second.lit;
+          ri->type = c.second.type;
         } else {
-          detailed_message(n.file.c_str(), n.line,
+          detailed_message(files.path(n.loc), n.loc.line,
                            "Unknwon IMMEDIATE value type: Not a constant when "
                            "expected a constant.",
                            NULL);
@@ -421,38 +412,36 @@ bool masm::GPCAnalyzer::second_loop() {
     case NODE_JGE:
     case NODE_JSE:
     case NODE_JMP_IMM: {
-      NodeImm *i = (NodeImm *)n.node.get();
-      if (labels.find(i->imm) == labels.end()) {
-        detailed_message(n.file.c_str(), n.line,
+      NodeImm *i = (NodeImm *)&n.node;
+      if (i->name == NO_ID || !symtable[i->name].is_label) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Unknwon LABEL to jump to: Not a valid label.", NULL);
         return false;
       }
       i->is_var = true;
-      if (n.type == NODE_WHDLR)
-        n.len = 2;
       break;
     }
     case NODE_LOOP: {
-      NodeRegrImm *i = (NodeRegrImm *)n.node.get();
-      if (labels.find(i->immediate) == labels.end()) {
-        detailed_message(n.file.c_str(), n.line,
+      NodeRegrImm *i = (NodeRegrImm *)&n.node;
+      if (i->name == NO_ID || !symtable[i->name].is_label) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Unknwon LABEL to jump to: Not a valid label.", NULL);
         return false;
       }
       break;
     }
     case NODE_INT: {
-      NodeRegrImm *ri = (NodeRegrImm *)n.node.get();
+      NodeImm *ri = (NodeImm *)&n.node;
       if (ri->type == VALUE_IDEN) {
-        std::pair<bool, std::pair<masm::value_t, std::string>> c =
-            resolve_if_constant(ri->immediate, {VALUE_INTEGER, VALUE_BINARY,
+        std::pair<bool, masm::Constant> c =
+            resolve_if_constant(ri->name, {VALUE_INTEGER, VALUE_BINARY,
                                                 VALUE_HEX, VALUE_OCTAL});
 
         if (c.first) {
-          ri->immediate = c.second.second;
-          ri->type = c.second.first;
+          ri->lit = c.second.lit;
+          ri->type = c.second.type;
         } else {
-          detailed_message(n.file.c_str(), n.line,
+          detailed_message(files.path(n.loc), n.loc.line,
                            "Unknwon IMMEDIATE value type: Not a constant.",
                            NULL);
           return false;
@@ -514,7 +503,6 @@ bool masm::GPCAnalyzer::second_loop() {
       if (!analyze_instructions_with_only_const_imm(
               n, {VALUE_INTEGER, VALUE_BINARY, VALUE_HEX, VALUE_OCTAL}))
         return false;
-      n.len = 2;
       break;
     case NODE_SHL_IMM:
     case NODE_SHR_IMM:
@@ -524,10 +512,16 @@ bool masm::GPCAnalyzer::second_loop() {
       break;
     case NODE_SOUT_IMM:
     case NODE_SIN_IMM: {
-      NodeImm *i = (NodeImm *)n.node.get();
-      if (!symtable.symbol_exists(i->imm)) {
-        detailed_message(n.file.c_str(), n.line,
-                         "This variable doesn't exists '%s'.", i->imm.c_str());
+      NodeImm *i = (NodeImm *)&n.node;
+      if (i->name == NO_ID) {
+        detailed_message(files.path(n.loc), n.loc.line,
+                         "Expected a variable as operand here.", NULL);
+        return false;
+      }
+      if (!symtable[i->name].is_var) {
+        detailed_message(files.path(n.loc), n.loc.line,
+                         "This variable doesn't exists '%s'.",
+                         symtable.name(i->name).c_str());
         return false;
       }
       break;
@@ -597,66 +591,178 @@ bool masm::GPCAnalyzer::second_loop() {
         return false;
       break;
     case NODE_CMPXCHG_IMM: {
-      NodeCMPXCHGImm *i = (NodeCMPXCHGImm *)n.node.get();
-      if (!resolve_variable(i->imm, {BYTE})) {
-        detailed_message(n.file.c_str(), n.line,
+      NodeCMPXCHGImm *i = (NodeCMPXCHGImm *)&n.node;
+      if (!resolve_variable(i->name, {BYTE})) {
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Invalid CMPXCHG Instruction format.", NULL);
         return false;
       }
-      n.len = 2;
       break;
     }
     default:
       break;
     }
-    result.push_back(std::move(n));
+    // Remember which variables are written and which the atomic
+    // instructions work on; the generator places them accordingly
+    switch (n.type) {
+    case NODE_ATM_LOADB_IMM:
+    case NODE_ATM_LOADW_IMM:
+    case NODE_ATM_LOADD_IMM:
+    case NODE_ATM_LOADQ_IMM:
+      symtable[((NodeRegrImm *)&n.node)->name].is_atomic = true;
+      break;
+    case NODE_ATM_STOREB_IMM:
+    case NODE_ATM_STOREW_IMM:
+    case NODE_ATM_STORED_IMM:
+    case NODE_ATM_STOREQ_IMM:
+      symtable[((NodeRegrImm *)&n.node)->name].is_atomic = true;
+      symtable[((NodeRegrImm *)&n.node)->name].is_written = true;
+      break;
+    case NODE_STOREB_IMM:
+    case NODE_STOREW_IMM:
+    case NODE_STORED_IMM:
+    case NODE_STOREQ_IMM:
+      symtable[((NodeRegrImm *)&n.node)->name].is_written = true;
+      break;
+    case NODE_CMPXCHG_IMM:
+      symtable[((NodeCMPXCHGImm *)&n.node)->name].is_atomic = true;
+      symtable[((NodeCMPXCHGImm *)&n.node)->name].is_written = true;
+      break;
+    case NODE_SIN_IMM:
+    case NODE_POPB_IMM:
+    case NODE_POPW_IMM:
+    case NODE_POPD_IMM:
+    case NODE_POPQ_IMM:
+      symtable[((NodeImm *)&n.node)->name].is_written = true;
+      break;
+    default:
+      break;
+    }
+    n.len = encoded_length(n);
   }
+  // Nothing is dropped here so the nodes are the result as they are
+  result = std::move(nodes);
   return true;
 }
 
-std::pair<bool, std::pair<masm::value_t, std::string>>
-masm::GPCAnalyzer::resolve_if_constant(std::string name,
-                                       std::vector<value_t> expected) {
-  std::unordered_map<std::string, std::pair<value_t, std::string>>::iterator
-      res = consts.find(name);
-  if (res == consts.end())
-    return std::make_pair(false, std::make_pair(VALUE_ERR, ""));
+void masm::GPCAnalyzer::shake(ShakeReport &report) {
+  // The code is split into regions at the labels. A region is reached when
+  // any of its labels is referred to from reached code or when the region
+  // before it is reached and falls through into it. Variables are reached
+  // through the operands of reached code and through reached pointers.
+  // Nothing has an address yet so whatever isn't reached is simply dropped.
+  uint32_t main_proc = symtable.find("main");
+  if (main_proc == NO_ID || !symtable[main_proc].is_label)
+    return; // reported later
+  std::vector<size_t> starts{0}; // of every region
+  std::unordered_map<uint32_t, size_t> region_of;   // label -> region
+  std::unordered_map<uint32_t, uint32_t> points_to; // pointer -> target
+  for (size_t i = 0; i < result.size(); i++) {
+    Node &n = result[i];
+    if (n.type == NODE_LABEL) {
+      region_of[((NodeLabel *)&n.node)->name] = starts.size();
+      starts.push_back(i);
+    } else if (n.type == NODE_DP) {
+      NodeDP *dp = (NodeDP *)&n.node;
+      points_to[dp->name] = dp->value_id;
+    }
+  }
+  size_t regions = starts.size();
+  starts.push_back(result.size());
+
+  std::vector<bool> live(regions, false);
+  std::unordered_set<uint32_t> live_vars;
+  std::vector<uint32_t> referred{main_proc}; // not looked at yet
+  while (!referred.empty()) {
+    uint32_t name = referred.back();
+    referred.pop_back();
+    if (name == NO_ID)
+      continue;
+    Symbol &sym = symtable[name];
+    if (sym.is_var && live_vars.insert(name).second) {
+      auto p = points_to.find(name);
+      if (p != points_to.end())
+        referred.push_back(p->second);
+    }
+    auto r = region_of.find(name);
+    if (!sym.is_label || r == region_of.end())
+      continue;
+    bool falls = true;
+    for (size_t at = r->second; falls && at < regions && !live[at]; at++) {
+      live[at] = true;
+      for (size_t i = starts[at]; i < starts[at + 1]; i++) {
+        Node &n = result[i];
+        if (isa_entry(n.type).layout == LAYOUT_NO_CODE)
+          continue;
+        referred.push_back(operand_symbol(n));
+        falls = n.type != NODE_HALT && n.type != NODE_RET &&
+                n.type != NODE_JMP_IMM && n.type != NODE_JMP_REG;
+      }
+    }
+  }
 
-  if (std::find(expected.begin(), expected.end(), res->second.first) ==
-      expected.end())
-    return std::make_pair(false, std::make_pair(VALUE_ERR, ""));
-  return std::make_pair(true, res->second);
+  size_t kept = 0;
+  for (size_t r = 0; r < regions; r++) {
+    // before the nodes are moved over it
+    uint32_t label =
+        r == 0 ? NO_ID : ((NodeLabel *)&result[starts[r]].node)->name;
+    uint64_t code = 0;
+    for (size_t i = starts[r]; i < starts[r + 1]; i++) {
+      Node &n = result[i];
+      bool keep = live[r];
+      if (n.type >= NODE_DB && n.type <= NODE_RESLF) {
+        uint32_t name = ((NodeDB *)&n.node)->name;
+        keep = live_vars.count(name);
+        if (!keep)
+          report.variables.push_back({name, variable_size(n)});
+      } else if (!keep) {
+        code += n.len * 8;
+      }
+      if (keep)
+        result[kept++] = n;
+    }
+    if (!live[r] && (r != 0 || code != 0))
+      report.procedures.push_back({label, code});
+  }
+  result.erase(result.begin() + kept, result.end());
 }
 
-bool masm::GPCAnalyzer::resolve_variable(std::string name,
-                                         std::vector<data_t> expected) {
-  if (!symtable.symbol_exists(name))
-    return false;
-  auto res = symtable.find_symbol(name);
-  if (std::find(expected.begin(), expected.end(), res->second.type) ==
-      expected.end())
+std::pair<bool, masm::Constant>
+masm::GPCAnalyzer::resolve_if_constant(uint32_t name,
+                                       const std::vector<value_t> &expected) {
+  if (name == NO_ID || !symtable[name].is_const)
+    return std::make_pair(false, Constant{VALUE_ERR, "", {}});
+  Constant &c = symtable[name].constant;
+  if (std::find(expected.begin(), expected.end(), c.type) == expected.end())
+    return std::make_pair(false, Constant{VALUE_ERR, "", {}});
+  return std::make_pair(true, c);
+}
+
+bool masm::GPCAnalyzer::resolve_variable(uint32_t name,
+                                         const std::vector<data_t> &expected) {
+  if (name == NO_ID || !symtable[name].is_var)
     return false;
-  return true;
+  return std::find(expected.begin(), expected.end(), symtable[name].type) !=
+         expected.end();
 }
 
 bool masm::GPCAnalyzer::analyze_stack_based_instructions(
-    Node &n, data_t expected, std::vector<value_t> vtlist) {
-  NodeImm *imm = (NodeImm *)n.node.get();
+    Node &n, data_t expected, const std::vector<value_t> &vtlist) {
+  NodeImm *imm = (NodeImm *)&n.node;
   if (imm->type == VALUE_IDEN) {
-    if (resolve_variable(imm->imm, {expected, POINTER})) {
+    if (resolve_variable(imm->name, {expected, POINTER})) {
       imm->is_var = true;
       return true;
     } else {
-      std::pair<bool, std::pair<masm::value_t, std::string>> res =
-          resolve_if_constant(imm->imm, vtlist);
+      std::pair<bool, masm::Constant> res =
+          resolve_if_constant(imm->name, vtlist);
       if (!res.first) {
-        detailed_message(n.file.c_str(), n.line,
+        detailed_message(files.path(n.loc), n.loc.line,
                          "Invalid Operand For Instruction", NULL);
         return false;
       } else {
-        imm->imm = res.second.second;
-        imm->type = res.second.first;
-        n.len = 2;
+        imm->lit = res.second.lit;
+        imm->type = res.second.type;
       }
     }
   }
@@ -666,7 +772,7 @@ bool masm::GPCAnalyzer::analyze_stack_based_instructions(
   case NODE_POPD_IMM:
   case NODE_POPQ_IMM:
     if (!imm->is_var) {
-      detailed_message(n.file.c_str(), n.line,
+      detailed_message(files.path(n.loc), n.loc.line,
                        "Invalid Operand For Instruction", NULL);
       return false;
     }
@@ -678,12 +784,12 @@ bool masm::GPCAnalyzer::analyze_stack_based_instructions(
 
 bool masm::GPCAnalyzer::analyze_load_store_instructions(Node &n,
                                                         data_t expected) {
-  NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
+  NodeRegrImm *imm = (NodeRegrImm *)&n.node;
   if (imm->type == VALUE_IDEN) {
-    if (resolve_variable(imm->immediate, {expected})) {
+    if (resolve_variable(imm->name, {expected})) {
       imm->is_var = true;
       return true;
-    } else if (resolve_variable(imm->immediate, {POINTER})) {
+    } else if (resolve_variable(imm->name, {POINTER})) {
       imm->is_var = true;
       switch (n.type) {
       case NODE_LOADB_IMM:
@@ -713,13 +819,13 @@ bool masm::GPCAnalyzer::analyze_load_store_instructions(Node &n,
       }
       return true;
     } else {
-      detailed_message(n.file.c_str(), n.line,
+      detailed_message(files.path(n.loc), n.loc.line,
                        "Invalid Operand For Instruction", NULL);
       return false;
     }
   } else {
     detailed_message(
-        n.file.c_str(), n.line,
+        files.path(n.loc), n.loc.line,
         "Instruction doesn't accept anything other than a variable.", NULL);
     return false;
   }
@@ -727,18 +833,18 @@ bool masm::GPCAnalyzer::analyze_load_store_instructions(Node &n,
 }
 
 bool masm::GPCAnalyzer::analyze_instructions_with_only_const_imm(
-    Node &n, std::vector<value_t> expected) {
-  NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
+    Node &n, const std::vector<value_t> &expected) {
+  NodeRegrImm *imm = (NodeRegrImm *)&n.node;
   if (imm->type == VALUE_IDEN) {
-    std::pair<bool, std::pair<masm::value_t, std::string>> res =
-        resolve_if_constant(imm->immediate, expected);
+    std::pair<bool, masm::Constant> res =
+        resolve_if_constant(imm->name, expected);
     if (!res.first) {
-      detailed_message(n.file.c_str(), n.line,
+      detailed_message(files.path(n.loc), n.loc.line,
                        "Invalid Operand For Instruction", NULL);
       return false;
     } else {
-      imm->immediate = res.second.second;
-      imm->type = res.second.first;
+      imm->lit = res.second.lit;
+      imm->type = res.second.type;
     }
   }
   return true;
@@ -0,0 +1,560 @@
+#include <fstream>
+#include <gpc_cfg.hpp>
+#include <gpc_gen_base.hpp>
+#include <unordered_map>
+#include <utils.hpp>
+
+masm::RegSet masm::register_bit(token_t reg) {
+  switch (reg) {
+  case SP:
+    return 1 << 13;
+  case BP:
+    return 1 << 14;
+  case ACC:
+    return 1 << 15;
+  default:
+    return 1 << (reg - R0);
+  }
+}
+
+masm::RegEffect masm::register_effect(Node &n) {
+  RegEffect e;
+  RegSet r = 0, r1 = 0, r2 = 0;
+  switch (isa_entry(n.type).layout) {
+  case LAYOUT_REG:
+    r = register_bit(((NodeReg *)&n.node)->reg);
+    break;
+  case LAYOUT_REG_REG:
+    r1 = register_bit(((NodeRegReg *)&n.node)->r1);
+    r2 = register_bit(((NodeRegReg *)&n.node)->r2);
+    break;
+  case LAYOUT_REG_IMM:
+  case LAYOUT_REG_IMM_OR_MEM:
+  case LAYOUT_REG_MEM:
+  case LAYOUT_REG_IMM16:
+  case LAYOUT_REG_LABEL:
+    r = register_bit(((NodeRegrImm *)&n.node)->regr);
+    break;
+  default:
+    break;
+  }
+  RegSet stack = register_bit(SP);
+  switch (n.type) {
+  // Whatever runs next or handles them may read any register and what
+  // they write is not known
+  case NODE_CALL_IMM:
+  case NODE_CALL_REG:
+  case NODE_INT:
+  case NODE_RESET:
+  case NODE_POPA:
+    e.use = e.def = ALL_REGS;
+    break;
+  case NODE_RET:
+  case NODE_RETNZ:
+  case NODE_RETZ:
+  case NODE_RETNE:
+  case NODE_RETE:
+  case NODE_RETNC:
+  case NODE_RETC:
+  case NODE_RETNO:
+  case NODE_RETO:
+  case NODE_RETNN:
+  case NODE_RETN:
+  case NODE_RETNG:
+  case NODE_RETG:
+  case NODE_RETNS:
+  case NODE_RETS:
+  case NODE_RETGE:
+  case NODE_RETSE:
+  case NODE_JMP_REG:
+  case NODE_PUSHA:
+  case NODE_OUTR:
+  case NODE_UOUTR:
+  case NODE_SIN_IMM:
+  case NODE_SIN_REG:
+  case NODE_SOUT_IMM:
+  case NODE_SOUT_REG:
+    e.use = ALL_REGS;
+    break;
+  case NODE_INC:
+  case NODE_DEC:
+  case NODE_NOT:
+  case NODE_LOOP:
+  case NODE_IADD_IMM:
+  case NODE_ISUB_IMM:
+  case NODE_IMUL_IMM:
+  case NODE_IDIV_IMM:
+  case NODE_IMOD_IMM:
+  case NODE_ADD_IMM:
+  case NODE_SUB_IMM:
+  case NODE_MUL_IMM:
+  case NODE_DIV_IMM:
+  case NODE_MOD_IMM:
+  case NODE_AND_IMM:
+  case NODE_OR_IMM:
+  case NODE_XOR_IMM:
+  case NODE_SHL_IMM:
+  case NODE_SHR_IMM:
+  case NODE_FADD_IMM:
+  case NODE_FSUB_IMM:
+  case NODE_FMUL_IMM:
+  case NODE_FDIV_IMM:
+  case NODE_FADD32_IMM:
+  case NODE_FSUB32_IMM:
+  case NODE_FMUL32_IMM:
+  case NODE_FDIV32_IMM:
+  case NODE_MOVNZ:
+  case NODE_MOVZ:
+  case NODE_MOVNE:
+  case NODE_MOVE:
+  case NODE_MOVNC:
+  case NODE_MOVC:
+  case NODE_MOVNO:
+  case NODE_MOVO:
+  case NODE_MOVNN:
+  case NODE_MOVN:
+  case NODE_MOVNG:
+  case NODE_MOVG:
+  case NODE_MOVNS:
+  case NODE_MOVS:
+  case NODE_MOVGE:
+  case NODE_MOVSE:
+    e.use = e.def = r;
+    break;
+  case NODE_MOV:
+  case NODE_MOVF:
+  case NODE_MOVF32:
+  case NODE_MOVSXB_IMM:
+  case NODE_MOVSXW_IMM:
+  case NODE_MOVSXD_IMM:
+  case NODE_LOADQ_IMM:
+  case NODE_ATM_LOADQ_IMM:
+    e.def = e.kill = r;
+    break;
+  // The smaller loads and inputs may leave the rest of the register as it is
+  case NODE_LOADB_IMM:
+  case NODE_LOADW_IMM:
+  case NODE_LOADD_IMM:
+  case NODE_ATM_LOADB_IMM:
+  case NODE_ATM_LOADW_IMM:
+  case NODE_ATM_LOADD_IMM:
+  case NODE_CIN:
+  case NODE_IN:
+  case NODE_INW:
+  case NODE_IND:
+  case NODE_INQ:
+  case NODE_UIN:
+  case NODE_UINW:
+  case NODE_UIND:
+  case NODE_UINQ:
+  case NODE_INF:
+  case NODE_INF32:
+    e.use = e.def = r;
+    break;
+  case NODE_CMP_IMM:
+  case NODE_STOREB_IMM:
+  case NODE_STOREW_IMM:
+  case NODE_STORED_IMM:
+  case NODE_STOREQ_IMM:
+  case NODE_ATM_STOREB_IMM:
+  case NODE_ATM_STOREW_IMM:
+  case NODE_ATM_STORED_IMM:
+  case NODE_ATM_STOREQ_IMM:
+  case NODE_COUT:
+  case NODE_OUT:
+  case NODE_OUTW:
+  case NODE_OUTD:
+  case NODE_OUTQ:
+  case NODE_UOUT:
+  case NODE_UOUTW:
+  case NODE_UOUTD:
+  case NODE_UOUTQ:
+  case NODE_OUTF:
+  case NODE_OUTF32:
+    e.use = r;
+    break;
+  case NODE_PUSH:
+    e.use = r | stack;
+    e.def = stack;
+    break;
+  case NODE_PUSHB:
+  case NODE_PUSHW:
+  case NODE_PUSHD:
+  case NODE_PUSHQ:
+  case NODE_POPB_IMM:
+  case NODE_POPW_IMM:
+  case NODE_POPD_IMM:
+  case NODE_POPQ_IMM:
+    e.use = e.def = stack;
+    break;
+  case NODE_POPQ_REG:
+    e.use = stack;
+    e.def = r | stack;
+    e.kill = r;
+    break;
+  case NODE_POPB_REG:
+  case NODE_POPW_REG:
+  case NODE_POPD_REG:
+    e.use = e.def = r | stack;
+    break;
+  // Relative to the stack
+  case NODE_LOADSQ:
+    e.use = stack | register_bit(BP);
+    e.def = e.kill = r;
+    break;
+  case NODE_LOADSB:
+  case NODE_LOADSW:
+  case NODE_LOADSD:
+    e.use = r | stack | register_bit(BP);
+    e.def = r;
+    break;
+  case NODE_STORESB:
+  case NODE_STORESW:
+  case NODE_STORESD:
+  case NODE_STORESQ:
+    e.use = r | stack | register_bit(BP);
+    break;
+  case NODE_MOVQ:
+  case NODE_MOVEQ:
+  case NODE_MOVSXB_REG:
+  case NODE_MOVSXW_REG:
+  case NODE_MOVSXD_REG:
+  case NODE_LOADQ_REG:
+    e.use = r2;
+    e.def = e.kill = r1;
+    break;
+  case NODE_MOVB:
+  case NODE_MOVW:
+  case NODE_MOVD:
+  case NODE_MOVEB:
+  case NODE_MOVEW:
+  case NODE_MOVED:
+  case NODE_LOADB_REG:
+  case NODE_LOADW_REG:
+  case NODE_LOADD_REG:
+    e.use = r1 | r2;
+    e.def = r1;
+    break;
+  case NODE_EXCGB:
+  case NODE_EXCGW:
+  case NODE_EXCGD:
+  case NODE_EXCGQ:
+    e.use = e.def = r1 | r2;
+    break;
+  case NODE_CMP_REGR:
+  case NODE_FCMP:
+  case NODE_FCMP32:
+  case NODE_STOREB_REG:
+  case NODE_STOREW_REG:
+  case NODE_STORED_REG:
+  case NODE_STOREQ_REG:
+    e.use = r1 | r2;
+    break;
+  case NODE_LEA: {
+    NodeLea *l = (NodeLea *)&n.node;
+    e.use = register_bit(l->r1) | register_bit(l->r2) | register_bit(l->r3);
+    e.def = e.kill = register_bit(l->r4);
+    break;
+  }
+  // 'expected' gets what was there when the exchange fails
+  case NODE_CMPXCHG_IMM: {
+    NodeCMPXCHGImm *c = (NodeCMPXCHGImm *)&n.node;
+    e.use = register_bit(c->r1) | register_bit(c->r2);
+    e.def = register_bit(c->r2);
+    break;
+  }
+  case NODE_CMPXCHG_REG: {
+    NodeCMPXCHGReg *c = (NodeCMPXCHGReg *)&n.node;
+    e.use = register_bit(c->r1) | register_bit(c->r2) | register_bit(c->r3);
+    e.def = register_bit(c->r2);
+    break;
+  }
+  default:
+    // The arithmetic on two registers writes the first
+    if (isa_entry(n.type).layout == LAYOUT_REG_REG) {
+      e.use = r1 | r2;
+      e.def = r1;
+    }
+    break;
+  }
+  return e;
+}
+
+bool masm::only_writes_registers(Node &n) {
+  switch (n.type) {
+  case NODE_MOV:
+  case NODE_MOVF:
+  case NODE_MOVF32:
+  case NODE_MOVSXB_IMM:
+  case NODE_MOVSXW_IMM:
+  case NODE_MOVSXD_IMM:
+  case NODE_MOVSXB_REG:
+  case NODE_MOVSXW_REG:
+  case NODE_MOVSXD_REG:
+  case NODE_MOVB:
+  case NODE_MOVW:
+  case NODE_MOVD:
+  case NODE_MOVQ:
+  case NODE_MOVEB:
+  case NODE_MOVEW:
+  case NODE_MOVED:
+  case NODE_MOVEQ:
+  case NODE_LEA:
+  case NODE_LOADB_IMM:
+  case NODE_LOADW_IMM:
+  case NODE_LOADD_IMM:
+  case NODE_LOADQ_IMM:
+  case NODE_LOADB_REG:
+  case NODE_LOADW_REG:
+  case NODE_LOADD_REG:
+  case NODE_LOADQ_REG:
+  case NODE_LOADSB:
+  case NODE_LOADSW:
+  case NODE_LOADSD:
+  case NODE_LOADSQ:
+    return true;
+  default:
+    return false;
+  }
+}
+
+masm::CFG::CFG(NodeList &nodes, SymbolTable &symtable)
+    : nodes(nodes), symtable(symtable) {
+  std::unordered_map<uint32_t, size_t> block_of; // label -> block
+  // 'fresh' while the last block has only labels
+  bool fresh = false, closed = true;
+  auto open = [&](size_t at) {
+    blocks.emplace_back();
+    blocks.back().begin = at;
+  };
+  for (size_t i = 0; i < nodes.size(); i++) {
+    Node &n = nodes[i];
+    if (n.type == NODE_LABEL) {
+      if (!fresh)
+        open(i);
+      fresh = true;
+      closed = false;
+      uint32_t name = ((NodeLabel *)&n.node)->name;
+      blocks.back().labels.push_back(name);
+      block_of[name] = blocks.size() - 1;
+      continue;
+    }
+    if (isa_entry(n.type).layout == LAYOUT_NO_CODE)
+      continue;
+    if (closed)
+      open(i);
+    fresh = false;
+    switch (n.type) {
+    case NODE_HALT:
+    case NODE_JMP_IMM:
+    case NODE_JMP_REG:
+    case NODE_CALL_IMM:
+    case NODE_CALL_REG:
+    case NODE_LOOP:
+      closed = true;
+      break;
+    default:
+      closed = (n.type >= NODE_JNZ && n.type <= NODE_JSE) ||
+               (n.type >= NODE_RET && n.type <= NODE_RETSE);
+    }
+  }
+  for (size_t b = 0; b < blocks.size(); b++)
+    blocks[b].end = b + 1 < blocks.size() ? blocks[b + 1].begin : nodes.size();
+
+  auto edge = [&](size_t from, size_t to) {
+    for (size_t s : blocks[from].succ)
+      if (s == to)
+        return;
+    blocks[from].succ.push_back(to);
+    blocks[to].pred.push_back(from);
+  };
+  // Code that is not the target of a jump may be reached through its address
+  auto entered = [&](uint32_t name) {
+    auto at = block_of.find(name);
+    if (at != block_of.end())
+      blocks[at->second].entry = true;
+  };
+  for (Node &n : nodes) {
+    if (n.type == NODE_DP)
+      entered(((NodeDP *)&n.node)->value_id);
+  }
+  entered(symtable.find("main"));
+  if (!blocks.empty())
+    blocks[0].entry = true;
+  for (size_t b = 0; b < blocks.size(); b++) {
+    bool falls = true, jumps = false;
+    size_t last = blocks[b].begin;
+    for (size_t i = blocks[b].begin; i < blocks[b].end; i++) {
+      Node &n = nodes[i];
+      if (isa_entry(n.type).layout == LAYOUT_NO_CODE)
+        continue;
+      last = i;
+      jumps = n.type == NODE_JMP_IMM || n.type == NODE_LOOP ||
+              (n.type >= NODE_JNZ && n.type <= NODE_JSE);
+      falls = n.type != NODE_HALT && n.type != NODE_RET &&
+              n.type != NODE_JMP_IMM && n.type != NODE_JMP_REG;
+      // Whoever looks at the core after it halts may read any register
+      if (n.type == NODE_HALT)
+        blocks[b].exit = true;
+      if (jumps)
+        continue;
+      entered(operand_symbol(n));
+      if (n.type == NODE_JMP_REG ||
+          (n.type >= NODE_RET && n.type <= NODE_RETSE))
+        blocks[b].exit = true;
+    }
+    if (jumps) {
+      uint32_t target = operand_symbol(nodes[last]);
+      auto at = block_of.find(target);
+      if (at != block_of.end())
+        edge(b, at->second);
+      else
+        blocks[b].exit = true;
+    }
+    if (falls) {
+      if (b + 1 < blocks.size())
+        edge(b, b + 1);
+      else
+        blocks[b].exit = true;
+    }
+  }
+}
+
+masm::RegSet masm::Liveness::transfer(BasicBlock &b, Value v) {
+  for (size_t i = b.end; i-- > b.begin;) {
+    if (isa_entry(nodes[i].type).layout == LAYOUT_NO_CODE)
+      continue;
+    RegEffect e = register_effect(nodes[i]);
+    v = (v & ~e.kill) | e.use;
+  }
+  return v;
+}
+
+masm::ReachingDefinitions::ReachingDefinitions(NodeList &nodes)
+    : nodes(nodes) {
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (isa_entry(nodes[i].type).layout == LAYOUT_NO_CODE)
+      continue;
+    RegSet def = register_effect(nodes[i]).def;
+    for (size_t r = 0; r < 16; r++)
+      if (def & (1 << r))
+        defs_of[r].push_back(i);
+  }
+}
+
+void masm::ReachingDefinitions::meet(Value &a, const Value &b) {
+  for (size_t i = 0; i < a.size(); i++)
+    if (b[i])
+      a[i] = true;
+}
+
+masm::ReachingDefinitions::Value
+masm::ReachingDefinitions::transfer(BasicBlock &b, Value v) {
+  for (size_t i = b.begin; i < b.end; i++) {
+    if (isa_entry(nodes[i].type).layout == LAYOUT_NO_CODE)
+      continue;
+    RegEffect e = register_effect(nodes[i]);
+    for (size_t r = 0; r < 16; r++) {
+      if (e.kill & (1 << r))
+        for (size_t d : defs_of[r])
+          v[d] = false;
+    }
+    if (e.def)
+      v[i] = true;
+  }
+  return v;
+}
+
+namespace masm {
+namespace cfg_export {
+static const char *register_names[16] = {
+    "r0", "r1", "r2",  "r3",  "r4", "r5", "r6", "r7",
+    "r8", "r9", "r10", "r11", "r12", "sp", "bp", "acc"};
+
+static std::string registers(RegSet set, const char *sep) {
+  std::string s;
+  for (size_t r = 0; r < 16; r++) {
+    if (!(set & (1 << r)))
+      continue;
+    if (!s.empty())
+      s += sep;
+    s += register_names[r];
+  }
+  return s;
+}
+
+// The source lines of the definitions in 'defs'
+static std::vector<size_t> lines(NodeList &nodes, std::vector<bool> &defs) {
+  std::vector<size_t> l;
+  for (size_t i = 0; i < defs.size(); i++)
+    if (defs[i])
+      l.push_back(nodes[i].loc.line);
+  return l;
+}
+}; // namespace cfg_export
+}; // namespace masm
+
+bool masm::CFG::export_to(const std::string &path) {
+  using namespace cfg_export;
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    simple_message("Failed to OPEN file '%s'", path.c_str());
+    return false;
+  }
+  Liveness live{nodes};
+  Dataflow<Liveness> liveness = solve(*this, live);
+  ReachingDefinitions reach(nodes);
+  Dataflow<ReachingDefinitions> reaching = solve(*this, reach);
+  bool json =
+      path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+
+  file << (json ? "{\"blocks\": [\n" : "digraph cfg {\n  node [shape=box "
+                                       "fontname=monospace];\n");
+  for (size_t b = 0; b < blocks.size(); b++) {
+    BasicBlock &bb = blocks[b];
+    size_t code = 0, first = 0, last = 0;
+    for (size_t i = bb.begin; i < bb.end; i++) {
+      if (isa_entry(nodes[i].type).layout == LAYOUT_NO_CODE)
+        continue;
+      if (code++ == 0)
+        first = nodes[i].loc.line;
+      last = nodes[i].loc.line;
+    }
+    std::vector<size_t> defs = lines(nodes, reaching.in[b]);
+    if (json) {
+      file << "  {\"id\": " << b << ", \"labels\": [";
+      for (size_t l = 0; l < bb.labels.size(); l++)
+        file << (l ? ", " : "") << '"' << symtable.name(bb.labels[l]) << '"';
+      file << "], \"instructions\": " << code << ", \"lines\": [" << first
+           << ", " << last << "], \"entry\": " << (bb.entry ? "true" : "false")
+           << ", \"exit\": " << (bb.exit ? "true" : "false")
+           << ", \"successors\": [";
+      for (size_t s = 0; s < bb.succ.size(); s++)
+        file << (s ? ", " : "") << bb.succ[s];
+      file << "], \"live_in\": [";
+      std::string in = registers(liveness.in[b], "\", \"");
+      std::string out = registers(liveness.out[b], "\", \"");
+      file << (in.empty() ? "" : "\"" + in + "\"") << "], \"live_out\": ["
+           << (out.empty() ? "" : "\"" + out + "\"")
+           << "], \"reaching_definitions\": [";
+      for (size_t d = 0; d < defs.size(); d++)
+        file << (d ? ", " : "") << defs[d];
+      file << "]}" << (b + 1 < blocks.size() ? "," : "") << "\n";
+      continue;
+    }
+    file << "  b" << b << " [label=\"";
+    for (uint32_t l : bb.labels)
+      file << symtable.name(l) << ":\\l";
+    file << code << " instructions, lines " << first << "-" << last << "\\l"
+         << "live in: " << registers(liveness.in[b], " ") << "\\l"
+         << "live out: " << registers(liveness.out[b], " ") << "\\l"
+         << "reaching definitions: " << defs.size() << "\\l\"";
+    if (bb.entry || bb.exit)
+      file << " peripheries=2";
+    file << "];\n";
+    for (size_t s : bb.succ)
+      file << "  b" << b << " -> b" << s << ";\n";
+  }
+  file << (json ? "]}\n" : "}\n");
+  return true;
+}
@@ -0,0 +1,40 @@
+#include <gpc_cfg.hpp>
+#include <gpc_dead_writes.hpp>
+#include <gpc_gen_base.hpp>
+
+size_t masm::eliminate_dead_writes(NodeList &nodes, SymbolTable &symtable) {
+  // Removing a write also removes what it reads, which can make the writes
+  // before it dead in other blocks, so this goes until nothing changes
+  size_t removed = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    CFG cfg(nodes, symtable);
+    Liveness live{nodes};
+    Dataflow<Liveness> liveness = solve(cfg, live);
+    std::vector<bool> dropped(nodes.size(), false);
+    for (size_t b = 0; b < cfg.blocks.size(); b++) {
+      BasicBlock &bb = cfg.blocks[b];
+      RegSet after = liveness.out[b];
+      for (size_t i = bb.end; i-- > bb.begin;) {
+        if (isa_entry(nodes[i].type).layout == LAYOUT_NO_CODE)
+          continue;
+        RegEffect e = register_effect(nodes[i]);
+        if (only_writes_registers(nodes[i]) && !(e.def & after)) {
+          dropped[i] = true;
+          removed++;
+          changed = true;
+          continue;
+        }
+        after = (after & ~e.kill) | e.use;
+      }
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      if (!dropped[i])
+        nodes[kept++] = nodes[i];
+    }
+    nodes.erase(nodes.begin() + kept, nodes.end());
+  }
+  return removed;
+}
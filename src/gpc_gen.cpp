@@ -1,38 +1,148 @@
+#include <algorithm>
+#include <gpc_cfg.hpp>
+#include <gpc_dead_writes.hpp>
 #include <gpc_gen.hpp>
+#include <gpc_jump_threading.hpp>
+#include <gpc_peephole.hpp>
 
-masm::GPCGen::GPCGen(SymbolTable &t,
-                     std::unordered_map<std::string, uint64_t> &laddr,
-                     std::unordered_map<std::string, uint64_t> &daddr,
+masm::GPCGen::GPCGen(SymbolTable &t, Arena &arena, std::vector<uint8_t> &r,
                      std::vector<uint8_t> &d, std::vector<uint8_t> &s,
-                     uint64_t a)
-    : symtable(t), st_address_data(a), label_addresses(laddr),
-      data_addresses(daddr), data(d), string(s) {}
+                     const GenOptions &o, uint64_t a)
+    : final_nodes(ArenaAllocator<Node>(arena)), symtable(t),
+      st_address_data(a), rodata(r), data(d), string(s), options(o) {}
 
 uint64_t masm::GPCGen::get_current_address_point() { return st_address_data; }
 
-std::vector<masm::Inst64> masm::GPCGen::get_instructions() {
-  return std::move(instructions);
+std::span<const masm::Inst64> masm::GPCGen::get_instructions() {
+  return instructions;
 }
 
-void masm::GPCGen::set_final_nodes(std::vector<Node> &&nodes) {
+void masm::GPCGen::set_final_nodes(NodeList &&nodes) {
   final_nodes = std::move(nodes);
 }
 
-std::vector<uint8_t> masm::GPCGen::get_data() { return std::move(data); }
+void masm::GPCGen::optimize() {
+  // Threading leaves jumps to the next instruction for the peephole pass
+  if (options.thread_jumps)
+    thread_jumps(final_nodes, symtable, stats);
+  if (options.peephole)
+    peephole(final_nodes, stats);
+  if (options.dead_writes)
+    stats.dead_writes_removed += eliminate_dead_writes(final_nodes, symtable);
+  if (options.shorten_immediates) {
+    // The addresses are given out after this so nothing has to be moved
+    for (Node &n : final_nodes) {
+      if (shorten_immediate(n))
+        stats.immediates_shortened++;
+    }
+  }
+}
+
+std::span<const uint8_t> masm::GPCGen::get_data() { return data; }
+
+bool masm::GPCGen::is_position_independent() {
+  return position_independent;
+}
+
+bool masm::GPCGen::export_cfg(const std::string &path) {
+  CFG cfg(final_nodes, symtable);
+  return cfg.export_to(path);
+}
+
+const masm::GenStats &masm::GPCGen::get_stats() { return stats; }
 
 masm::Inst64 masm::GPCGen::get_ENTRY_INSTRUCTION(size_t addr) {
   Inst64 i;
   i.whole_word = (addr & 0xFFFFFFFFFFFF) - 8;
-  i.bytes.b0 = OP_JMP_ADDR;
+  // This is the first qword so the offset to main is its address
+  i.bytes.b0 = options.relative_jumps ? OP_JMP_OFF : OP_JMP_ADDR;
   return i;
 }
 
-void masm::GPCGen::align_data(uint64_t *addr) {
-  if ((*addr % 8) != 0) {
-    uint64_t diff = (8 - (*addr % 8));
+void masm::GPCGen::align_data(std::vector<uint8_t> &bytes, uint64_t *addr,
+                              uint64_t to) {
+  if ((*addr % to) != 0) {
+    uint64_t diff = (to - (*addr % to));
     for (size_t i = 0; i < diff; i++, (*addr)++)
-      data.push_back(0);
+      bytes.push_back(0);
+  }
+}
+
+bool masm::GPCGen::first_iteration_rodata_phase(uint64_t addr_point) {
+  // Variables that are never written go to the read only section which
+  // the VM can share between cores and instances. It is laid out like the
+  // data section(largest first) with the bytes and strings at the end
+  // where they need no alignment.
+  st_address_data = addr_point;
+  pool_strings();
+  for (Node &n : final_nodes) {
+    if (n.type == NODE_DQ || n.type == NODE_DP || n.type == NODE_DLF)
+      add_read_only(n, 8);
+  }
+  for (Node &n : final_nodes) {
+    if (n.type == NODE_DD || n.type == NODE_DF)
+      add_read_only(n, 4);
   }
+  for (Node &n : final_nodes) {
+    if (n.type == NODE_DW)
+      add_read_only(n, 2);
+  }
+  for (Node &n : final_nodes) {
+    if (n.type == NODE_DB)
+      add_read_only(n, 1);
+    else if (n.type == NODE_DS)
+      add_read_only(n, ((NodeDS *)&n.node)->value.length());
+  }
+  for (auto &[name, alias] : string_aliases)
+    symtable[name].data_address =
+        symtable[alias.owner].data_address + alias.offset;
+  align_data(rodata, &st_address_data);
+  return true;
+}
+
+void masm::GPCGen::add_read_only(Node &n, size_t len) {
+  NodeDB *d = (NodeDB *)&n.node;
+  if (symtable[d->name].is_written)
+    return;
+  placed.insert(d->name);
+  if (n.type == NODE_DS) {
+    // pool_strings already merged these
+    if (string_aliases.count(d->name))
+      return;
+    symtable[d->name].data_address = st_address_data;
+    add_data(rodata, d, 0);
+    st_address_data += len;
+    return;
+  }
+  // A value that is already in the section is not stored again
+  bool known = true;
+  std::pair<uint64_t, uint64_t> key;
+  switch (d->type) {
+  case VALUE_HEX:
+  case VALUE_OCTAL:
+  case VALUE_BINARY:
+  case VALUE_INTEGER:
+  case VALUE_FLOAT:
+    if (n.type == NODE_DP)
+      key = {0, d->value_id};
+    else
+      key = {len, d->lit.bits(len)};
+    break;
+  default:
+    known = false;
+  }
+  if (known) {
+    auto [owner, inserted] = constants.emplace(key, d->name);
+    if (!inserted) {
+      symtable[d->name].data_address = symtable[owner->second].data_address;
+      stats.constants_merged++;
+      stats.constant_bytes_saved += len;
+      return;
+    }
+  }
+  symtable[d->name].data_address = st_address_data;
+  add_data(rodata, d, n.type == NODE_DP ? 0 : len);
+  st_address_data += len;
 }
 
 bool masm::GPCGen::first_iteration(uint64_t addr_point) {
@@ -64,6 +174,9 @@ bool masm::GPCGen::first_iteration(uint64_t addr_point) {
   st_address_data = addr_point;
   uint64_t i = 8;
 
+  if (options.isolate_atomics)
+    isolate_atomics();
+
   // Intelligent putting of variables
   // qwords, lfloats and pointers -> dwords, floats ->(add some if it isn't
   // 8-byte aligned)
@@ -82,1322 +195,512 @@ bool masm::GPCGen::first_iteration(uint64_t addr_point) {
     case NODE_RESW:
     case NODE_RESD:
     case NODE_RESF:
-      break;
-    case NODE_LABEL: {
-      NodeLabel *lbl = (NodeLabel *)n.node.get();
-      label_addresses[lbl->name] = i;
-      break;
-    }
-    case NODE_DQ: {
-      NodeDQ *dq = (NodeDQ *)n.node.get();
-      data_addresses[dq->name] = st_address_data;
-      add_data(dq->value, dq->type, 8);
-      st_address_data += 8;
-      break;
-    }
-    case NODE_DP: {
-      NodeDP *dp = (NodeDP *)n.node.get();
-      data_addresses[dp->name] = st_address_data;
-      add_data(dp->value, dp->type, 0);
-      st_address_data += 8;
-      break;
-    }
-    case NODE_DLF: {
-      NodeDF *dlf = (NodeDF *)n.node.get();
-      data_addresses[dlf->name] = st_address_data;
-      add_data(dlf->value, dlf->type, 8);
-      st_address_data += 8;
-      break;
-    }
     case NODE_RESP:
-    case NODE_RESQ: {
-      NodeRESQ *res = (NodeRESQ *)n.node.get();
-      data_addresses[res->name] = st_address_data;
-      add_reserved_data(res->value, res->type, 8);
-      break;
-    }
-    case NODE_RESLF: {
-      NodeRESF *res = (NodeRESF *)n.node.get();
-      data_addresses[res->name] = st_address_data;
-      add_reserved_data(res->value, res->type, 8);
-      break;
-    }
-    default:
-      i += n.len * 8;
-    }
-  }
-  // dwords, floats
-  for (Node &n : final_nodes) {
-    switch (n.type) {
-    case NODE_RESF: {
-      NodeRESF *res = (NodeRESF *)n.node.get();
-      data_addresses[res->name] = st_address_data;
-      add_reserved_data(res->value, res->type, 4);
-      break;
-    }
-    case NODE_RESD: {
-      NodeRESD *res = (NodeRESD *)n.node.get();
-      data_addresses[res->name] = st_address_data;
-      add_reserved_data(res->value, res->type, 4);
-      break;
-    }
-    case NODE_DF: {
-      NodeDF *df = (NodeDF *)n.node.get();
-      data_addresses[df->name] = st_address_data;
-      add_data(df->value, df->type, 4);
-      st_address_data += 4;
-      break;
-    }
-    case NODE_DD: {
-      NodeDD *dd = (NodeDD *)n.node.get();
-      data_addresses[dd->name] = st_address_data;
-      add_data(dd->value, dd->type, 4);
-      st_address_data += 4;
-      break;
-    }
-    default:
-      break;
-    }
-  }
-  align_data(&st_address_data);
-  // words
-  for (Node &n : final_nodes) {
-    switch (n.type) {
-    case NODE_RESW: {
-      NodeRESW *res = (NodeRESW *)n.node.get();
-      data_addresses[res->name] = st_address_data;
-      add_reserved_data(res->value, res->type, 2);
-      break;
-    }
-    case NODE_DW: {
-      NodeDW *dw = (NodeDW *)n.node.get();
-      data_addresses[dw->name] = st_address_data;
-      add_data(dw->value, dw->type, 2);
-      st_address_data += 2;
-      break;
-    }
-    default:
-      break;
-    }
-  }
-  align_data(&st_address_data);
-  return true;
-}
-
-bool masm::GPCGen::first_iteration_second_phase(uint64_t addr_point) {
-  st_address_data = addr_point;
-  for (auto &n : final_nodes) {
-    switch (n.type) {
-    case NODE_DS: {
-      NodeDS *ds = (NodeDS *)n.node.get();
-      data_addresses[ds->name] = st_address_data;
-      add_data(ds->value, ds->type, 0);
-      st_address_data += ds->value.length();
-      break;
-    }
-    case NODE_RESB: {
-      NodeRESB *res = (NodeRESB *)n.node.get();
-      data_addresses[res->name] = st_address_data;
-      add_reserved_data(res->value, res->type, 1);
-      break;
-    }
-    case NODE_DB: {
-      NodeDB *db = (NodeDB *)n.node.get();
-      data_addresses[db->name] = st_address_data;
-      add_data(db->value, db->type, 1);
-      st_address_data++;
-      break;
-    }
-    default:
-      break;
-    }
-  }
-  return true;
-}
-
-bool masm::GPCGen::first_iteration_third_phase(uint64_t addr_point) {
-  st_address_data = addr_point;
-  for (Node &n : final_nodes) {
-    if (n.type == NODE_DP) {
-      NodeDP *dp = (NodeDP *)n.node.get();
-      Data64 d;
-      d.whole_word = data_addresses[dp->value];
-      size_t this_ptr = data_addresses[dp->name];
-      data[this_ptr] = d.bytes.b7;
-      data[this_ptr + 1] = d.bytes.b6;
-      data[this_ptr + 2] = d.bytes.b5;
-      data[this_ptr + 3] = d.bytes.b4;
-      data[this_ptr + 4] = d.bytes.b3;
-      data[this_ptr + 5] = d.bytes.b2;
-      data[this_ptr + 6] = d.bytes.b1;
-      data[this_ptr + 7] = d.bytes.b0;
-    }
-  }
-  return true;
-}
-
-bool masm::GPCGen::second_iteration() {
-  // Now we can go through the nodes and generate Instructions
-  // First instruction is actually a jump instruction to the
-  // entry procedure named main which must be defined
-  // otherwise there will be errors.
-
-  // Due to MY lack of brain power during the design of the
-  // assembler, we have to deal with insanity.
-  // We could have grouped the instructions tight enough such
-  // that a very small amount of logic would have sufficed
-  // to cover the entire ISA but now we need a lot more logic
-  // There are still groups that can be made but they are small
-  // and not dense enough.
-  // If I had TRULY separated entire backends for every core
-  // from the very beginning then every step could have been
-  // simplified.
-
-  for (Node &n : final_nodes) {
-    switch (n.type) {
-    case NODE_LABEL:
-    case NODE_DB:
-    case NODE_DW:
-    case NODE_DD:
-    case NODE_DQ:
-    case NODE_DP:
-    case NODE_DS:
-    case NODE_DF:
-    case NODE_DLF:
-    case NODE_RESB:
-    case NODE_RESW:
-    case NODE_RESD:
     case NODE_RESQ:
-    case NODE_RESP:
-    case NODE_RESF:
     case NODE_RESLF:
       break;
-    case NODE_NOP:
-      simple_instructions(OP_NOP);
-      break;
-    case NODE_HALT:
-      simple_instructions(OP_HALT);
-      break;
-    case NODE_RET:
-      simple_instructions(OP_RET);
-      break;
-    case NODE_RETNZ:
-      simple_instructions(OP_RETNZ);
-      break;
-    case NODE_RETZ:
-      simple_instructions(OP_RETZ);
-      break;
-    case NODE_RETNE:
-      simple_instructions(OP_RETNE);
-      break;
-    case NODE_RETE:
-      simple_instructions(OP_RETE);
-      break;
-    case NODE_RETNC:
-      simple_instructions(OP_RETNC);
-      break;
-    case NODE_RETC:
-      simple_instructions(OP_RETC);
-      break;
-    case NODE_RETNO:
-      simple_instructions(OP_RETNO);
-      break;
-    case NODE_RETO:
-      simple_instructions(OP_RETO);
-      break;
-    case NODE_RETNN:
-      simple_instructions(OP_RETNN);
-      break;
-    case NODE_RETN:
-      simple_instructions(OP_RETN);
-      break;
-    case NODE_RETNG:
-      simple_instructions(OP_RETNG);
-      break;
-    case NODE_RETG:
-      simple_instructions(OP_RETG);
-      break;
-    case NODE_RETNS:
-      simple_instructions(OP_RETNS);
-      break;
-    case NODE_RETS:
-      simple_instructions(OP_RETS);
-      break;
-    case NODE_RETGE:
-      simple_instructions(OP_RETGE);
-      break;
-    case NODE_RETSE:
-      simple_instructions(OP_RETSE);
-      break;
-    case NODE_PUSHA:
-      simple_instructions(OP_PUSHA);
-      break;
-    case NODE_POPA:
-      simple_instructions(OP_POPA);
-      break;
-    case NODE_OUTR:
-      simple_instructions(OP_OUTR);
-      break;
-    case NODE_UOUTR:
-      simple_instructions(OP_UOUTR);
-      break;
-    case NODE_CFLAGS:
-      simple_instructions(OP_CFLAGS);
-      break;
-    case NODE_RESET:
-      simple_instructions(OP_RESET);
-      break;
-    case NODE_INC: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_INC, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_DEC: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_DEC, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_CALL_REG: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_CALL_REG, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_JMP_REG: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_JMP_REGR, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_PUSH: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_PUSH_REG, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_POPB_REG: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_POP8, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_POPW_REG: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_POP16, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_POPD_REG: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_POP32, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_POPQ_REG: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_POP64, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_NOT: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_NOT, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_CIN: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_CIN, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_COUT: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_COUT, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_IN: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_IN, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_OUT: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_OUT, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_INW: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_INW, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_OUTW: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_OUTW, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_IND: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_IND, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_OUTD: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_OUTD, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_INQ: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_INQ, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_OUTQ: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_OUTQ, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_UIN: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_UIN, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_UOUT: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_UOUT, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_UINW: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_UINW, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_UOUTW: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_UOUTW, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_UIND: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_UIND, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_UOUTD: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_UOUTD, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_UINQ: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_UINQ, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_UOUTQ: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_UOUTQ, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_INF: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_INF, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_INF32: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_INF32, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_OUTF: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_OUTF, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_OUTF32: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_OUTF32, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_SOUT_REG: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_SOUT_REG, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_SIN_REG: {
-      NodeReg *r = (NodeReg *)n.node.get();
-      instructions_with_single_regr(OP_SIN_REG, token_to_regr(r->reg));
-      break;
-    }
-    case NODE_ADD_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_ADD_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_SUB_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_SUB_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MUL_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MUL_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_DIV_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_DIV_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOD_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOD_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_IADD_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_IADD_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_ISUB_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_ISUB_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_IMUL_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_IMUL_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_IDIV_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_IDIV_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_IMOD_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_IMOD_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FADD_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FADD, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FSUB_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FSUB, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FMUL_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FMUL, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FDIV_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FDIV, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FADD32_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FADD32, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FSUB32_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FSUB32, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FMUL32_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FMUL32, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FDIV32_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FDIV32, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVB: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOVE_REG8, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVW: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOVE_REG16, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVD: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOVE_REG32, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVQ: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOVE_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVSXB_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOVESX_REG8, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVSXW_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOVESX_REG16, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVSXD_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOVESX_REG32, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_EXCGB: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_EXCG8, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_EXCGW: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_EXCG16, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_EXCGD: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_EXCG32, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_EXCGQ: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_EXCG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVEB: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOV8, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVEW: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOV16, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVED: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOV32, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_MOVEQ: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_MOVE_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_AND_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_AND_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_OR_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_OR_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_XOR_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_XOR_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_SHL_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_LSHIFT_REGR, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_SHR_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_RSHIFT_REGR, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FCMP: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FCMP, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_FCMP32: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_FCMP32, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_LOADB_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_LOADB_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_LOADW_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_LOADW_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_LOADD_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_LOADD_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_LOADQ_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_LOADQ_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_STOREB_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_STOREB_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_STOREW_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_STOREW_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_STORED_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_STORED_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_STOREQ_REG: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_STOREQ_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_CMP_REGR: {
-      NodeRegReg *rr = (NodeRegReg *)n.node.get();
-      instructions_with_two_regr(OP_CMP_REG, token_to_regr(rr->r1),
-                                 token_to_regr(rr->r2));
-      break;
-    }
-    case NODE_JMP_IMM: {
-      instructions_with_one_immediate(OP_JMP_ADDR, n, 0, true, true);
-      break;
-    }
-    case NODE_WHDLR: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      auto label = label_addresses.find(imm->imm);
-      Inst64 i;
-      i.bytes.b0 = OP_WHDLR;
-      instructions.push_back(i);
-      i.whole_word = label->second;
-      instructions.push_back(i);
-      break;
-    }
-    case NODE_CALL_IMM: {
-      instructions_with_one_immediate(OP_CALL, n, 0, true);
-      break;
-    }
-    case NODE_JNZ: {
-      instructions_with_one_immediate(OP_JNZ, n, 0, true, true);
-      break;
-    }
-    case NODE_JZ: {
-      instructions_with_one_immediate(OP_JZ, n, 0, true, true);
-      break;
-    }
-    case NODE_JNE: {
-      instructions_with_one_immediate(OP_JNE, n, 0, true, true);
-      break;
-    }
-    case NODE_JE: {
-      instructions_with_one_immediate(OP_JE, n, 0, true, true);
-      break;
-    }
-    case NODE_JNC: {
-      instructions_with_one_immediate(OP_JNC, n, 0, true, true);
-      break;
-    }
-    case NODE_JC: {
-      instructions_with_one_immediate(OP_JC, n, 0, true, true);
-      break;
-    }
-    case NODE_JNO: {
-      instructions_with_one_immediate(OP_JNO, n, 0, true, true);
-      break;
-    }
-    case NODE_JO: {
-      instructions_with_one_immediate(OP_JO, n, 0, true, true);
-      break;
-    }
-    case NODE_JNN: {
-      instructions_with_one_immediate(OP_JNN, n, 0, true, true);
-      break;
-    }
-    case NODE_JN: {
-      instructions_with_one_immediate(OP_JN, n, 0, true, true);
-      break;
-    }
-    case NODE_JNG: {
-      instructions_with_one_immediate(OP_JNG, n, 0, true, true);
-      break;
-    }
-    case NODE_JG: {
-      instructions_with_one_immediate(OP_JG, n, 0, true, true);
-      break;
-    }
-    case NODE_JNS: {
-      instructions_with_one_immediate(OP_JNS, n, 0, true, true);
-      break;
-    }
-    case NODE_JS: {
-      instructions_with_one_immediate(OP_JS, n, 0, true, true);
-      break;
-    }
-    case NODE_JGE: {
-      instructions_with_one_immediate(OP_JGE, n, 0, true, true);
-      break;
-    }
-    case NODE_JSE: {
-      instructions_with_one_immediate(OP_JSE, n, 0, true, true);
-      break;
-    }
-    case NODE_PUSHB: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      if (imm->is_var)
-        single_operand_which_is_variable(OP_PUSH_MEMB, imm->imm);
-      else
-        single_operand_which_is_immediate(OP_PUSH_IMM8, imm->imm, imm->type, 1);
-      break;
-    }
-    case NODE_PUSHW: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      if (imm->is_var)
-        single_operand_which_is_variable(OP_PUSH_MEMW, imm->imm);
-      else
-        single_operand_which_is_immediate(OP_PUSH_IMM16, imm->imm, imm->type,
-                                          2);
-      break;
-    }
-    case NODE_PUSHD: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      if (imm->is_var)
-        single_operand_which_is_variable(OP_PUSH_MEMD, imm->imm);
-      else
-        single_operand_which_is_immediate(OP_PUSH_IMM32, imm->imm, imm->type,
-                                          4);
-      break;
-    }
-    case NODE_PUSHQ: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      if (imm->is_var)
-        single_operand_which_is_variable(OP_PUSH_MEMQ, imm->imm);
-      else
-        single_operand_which_is_immediate(OP_PUSH_IMM64, imm->imm, imm->type,
-                                          8);
-      break;
-    }
-    case NODE_POPB_IMM: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      single_operand_which_is_variable(OP_POP_MEMB, imm->imm);
-      break;
-    }
-    case NODE_POPW_IMM: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      single_operand_which_is_variable(OP_POP_MEMW, imm->imm);
-      break;
-    }
-    case NODE_POPD_IMM: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      single_operand_which_is_variable(OP_POP_MEMD, imm->imm);
-      break;
-    }
-    case NODE_POPQ_IMM: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      single_operand_which_is_variable(OP_POP_MEMQ, imm->imm);
-      break;
-    }
-    case NODE_SIN_IMM:
-    case NODE_SOUT_IMM:
-      sin_and_sout_instructions(n);
-      break;
-      // INST WITH ONE REGR AND IMMEDIATE
-    case NODE_ADD_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      if (imm->is_var)
-        choose_opcode_according_to_variable(
-            imm, {OP_ADD_MEMB, OP_ADD_MEMW, OP_ADD_MEMD, OP_ADD_MEMQ});
-      else
-        two_operand_second_is_immediate(OP_ADD_IMM, imm->immediate, imm->type,
-                                        8, imm->regr);
-      break;
-    }
-    case NODE_SUB_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      if (imm->is_var)
-        choose_opcode_according_to_variable(
-            imm, {OP_SUB_MEMB, OP_SUB_MEMW, OP_SUB_MEMD, OP_SUB_MEMQ});
-      else
-        two_operand_second_is_immediate(OP_SUB_IMM, imm->immediate, imm->type,
-                                        8, imm->regr);
-      break;
-    }
-    case NODE_MUL_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      if (imm->is_var)
-        choose_opcode_according_to_variable(
-            imm, {OP_MUL_MEMB, OP_MUL_MEMW, OP_MUL_MEMD, OP_MUL_MEMQ});
-      else
-        two_operand_second_is_immediate(OP_MUL_IMM, imm->immediate, imm->type,
-                                        8, imm->regr);
-      break;
-    }
-    case NODE_DIV_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      if (imm->is_var)
-        choose_opcode_according_to_variable(
-            imm, {OP_DIV_MEMB, OP_DIV_MEMW, OP_DIV_MEMD, OP_DIV_MEMQ});
-      else
-        two_operand_second_is_immediate(OP_DIV_IMM, imm->immediate, imm->type,
-                                        8, imm->regr);
-      break;
-    }
-    case NODE_MOD_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      if (imm->is_var)
-        choose_opcode_according_to_variable(
-            imm, {OP_MOD_MEMB, OP_MOD_MEMW, OP_MOD_MEMD, OP_MOD_MEMQ});
-      else
-        two_operand_second_is_immediate(OP_MOD_IMM, imm->immediate, imm->type,
-                                        8, imm->regr);
-      break;
-    }
-    case NODE_IADD_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_IADD_IMM, imm->immediate, imm->type, 8,
-                                      imm->regr);
-      break;
-    }
-    case NODE_ISUB_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_ISUB_IMM, imm->immediate, imm->type, 8,
-                                      imm->regr);
-      break;
-    }
-    case NODE_IMUL_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_IMUL_IMM, imm->immediate, imm->type, 8,
-                                      imm->regr);
-      break;
-    }
-    case NODE_IDIV_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_IDIV_IMM, imm->immediate, imm->type, 8,
-                                      imm->regr);
-      break;
-    }
-    case NODE_IMOD_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_IMOD_IMM, imm->immediate, imm->type, 8,
-                                      imm->regr);
-      break;
-    }
-    case NODE_FADD32_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_FADD32_MEM});
-      break;
-    }
-    case NODE_FSUB32_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_FSUB32_MEM});
-      break;
-    }
-    case NODE_FMUL32_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_FMUL32_MEM});
-      break;
-    }
-    case NODE_FDIV32_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_FDIV32_MEM});
-      break;
-    }
-    case NODE_FADD_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_FADD_MEM});
-      break;
-    }
-    case NODE_FSUB_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_FSUB_MEM});
-      break;
-    }
-    case NODE_FMUL_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_FMUL_MEM});
-      break;
-    }
-    case NODE_FDIV_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_FDIV_MEM});
-      break;
-    }
-    case NODE_MOV: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVE_IMM_64, imm->immediate, imm->type,
-                                      8, imm->regr);
-      break;
-    }
-    case NODE_MOVF32: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVE_IMM_64, imm->immediate, imm->type,
-                                      4, imm->regr);
-      break;
-    }
-    case NODE_MOVF: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVE_IMM_64, imm->immediate, imm->type,
-                                      8, imm->regr);
-      break;
-    }
-    case NODE_MOVSXB_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_MOVESX_IMM8, imm->regr, imm->immediate, imm->type, 1);
-      break;
-    }
-    case NODE_MOVSXW_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_MOVESX_IMM16, imm->regr, imm->immediate, imm->type, 2);
-      break;
-    }
-    case NODE_MOVSXD_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_MOVESX_IMM32, imm->regr, imm->immediate, imm->type, 4);
+    case NODE_LABEL: {
+      NodeLabel *lbl = (NodeLabel *)&n.node;
+      symtable[lbl->name].label_address = i;
       break;
     }
-    case NODE_MOVNZ: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVNZ, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case NODE_DQ: {
+      NodeDQ *dq = (NodeDQ *)&n.node;
+      if (placed.count(dq->name))
+        break;
+      symtable[dq->name].data_address = st_address_data;
+      add_data(data, dq, 8);
+      st_address_data += 8;
       break;
     }
-    case NODE_MOVZ: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVZ, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case NODE_DP: {
+      NodeDP *dp = (NodeDP *)&n.node;
+      if (placed.count(dp->name))
+        break;
+      symtable[dp->name].data_address = st_address_data;
+      add_data(data, dp, 0);
+      st_address_data += 8;
       break;
     }
-    case NODE_MOVNE: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVNE, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case NODE_DLF: {
+      NodeDF *dlf = (NodeDF *)&n.node;
+      if (placed.count(dlf->name))
+        break;
+      symtable[dlf->name].data_address = st_address_data;
+      add_data(data, dlf, 8);
+      st_address_data += 8;
       break;
     }
-    case NODE_MOVE: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVE, imm->immediate, imm->type, 8,
-                                      imm->regr);
-      break;
+    default:
+      i += n.len * 8;
     }
-    case NODE_MOVNC: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVNC, imm->immediate, imm->type, 8,
-                                      imm->regr);
+  }
+  // dwords, floats
+  for (Node &n : final_nodes) {
+    switch (n.type) {
+    case NODE_DF: {
+      NodeDF *df = (NodeDF *)&n.node;
+      if (placed.count(df->name))
+        break;
+      symtable[df->name].data_address = st_address_data;
+      add_data(data, df, 4);
+      st_address_data += 4;
       break;
     }
-    case NODE_MOVC: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVC, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case NODE_DD: {
+      NodeDD *dd = (NodeDD *)&n.node;
+      if (placed.count(dd->name))
+        break;
+      symtable[dd->name].data_address = st_address_data;
+      add_data(data, dd, 4);
+      st_address_data += 4;
       break;
     }
-    case NODE_MOVNO: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVNO, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    default:
       break;
     }
-    case NODE_MOVO: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVO, imm->immediate, imm->type, 8,
-                                      imm->regr);
+  }
+  // words only need 2 byte alignment
+  if (!options.pack_data)
+    align_data(data, &st_address_data);
+  // words
+  for (Node &n : final_nodes) {
+    switch (n.type) {
+    case NODE_DW: {
+      NodeDW *dw = (NodeDW *)&n.node;
+      if (placed.count(dw->name))
+        break;
+      symtable[dw->name].data_address = st_address_data;
+      add_data(data, dw, 2);
+      st_address_data += 2;
       break;
     }
-    case NODE_MOVNN: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVNN, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    default:
       break;
     }
-    case NODE_MOVN: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVN, imm->immediate, imm->type, 8,
-                                      imm->regr);
-      break;
+  }
+  if (options.pack_data)
+    pack_tail();
+  align_data(data, &st_address_data);
+  return true;
+}
+
+void masm::GPCGen::pack_tail() {
+  // The data section ends 8 byte aligned. Rather than padding up to that,
+  // fill the gap with variables that need no alignment(bytes and short
+  // strings), which would otherwise go to the string section. The gap is
+  // at most 7 bytes so finding the best fill is a tiny subset sum.
+  size_t gap = (8 - st_address_data % 8) % 8;
+  if (gap == 0)
+    return;
+  std::vector<Node *> fits;
+  for (Node &n : final_nodes) {
+    NodeDB *db = (NodeDB *)&n.node;
+    if (placed.count(db->name))
+      continue;
+    if ((n.type == NODE_DB) ||
+        (n.type == NODE_DS && db->type == VALUE_STRING &&
+         !db->value.empty() && db->value.length() <= gap))
+      fits.push_back(&n);
+  }
+  auto size_of = [](Node *n) {
+    return n->type == NODE_DB ? 1 : ((NodeDS *)&n->node)->value.length();
+  };
+  // by[s]: the item that completes a fill of s bytes(+1; 0 for none)
+  std::vector<size_t> by(gap + 1, 0);
+  std::vector<bool> reached(gap + 1, false);
+  reached[0] = true;
+  for (size_t i = 0; i < fits.size(); i++) {
+    size_t len = size_of(fits[i]);
+    for (size_t s = gap; s >= len; s--) {
+      if (!reached[s] && reached[s - len]) {
+        reached[s] = true;
+        by[s] = i + 1;
+      }
     }
-    case NODE_MOVNG: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVNG, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    if (reached[gap])
+      break;
+  }
+  size_t s = gap;
+  while (!reached[s])
+    s--;
+  // Each item is used at most once since the sums only grow
+  std::vector<Node *> chosen;
+  for (; s != 0; s -= size_of(chosen.back()))
+    chosen.push_back(fits[by[s] - 1]);
+  // keep the order they were defined in
+  std::reverse(chosen.begin(), chosen.end());
+  for (Node *n : chosen) {
+    NodeDB *db = (NodeDB *)&n->node;
+    symtable[db->name].data_address = st_address_data;
+    add_data(data, db, n->type == NODE_DB ? 1 : 0);
+    st_address_data += size_of(n);
+    placed.insert(db->name);
+  }
+}
+
+bool masm::GPCGen::is_isolated(uint32_t name) {
+  // Nothing can contend for a line that is only ever read
+  return options.isolate_atomics && symtable[name].is_atomic &&
+         symtable[name].is_written;
+}
+
+void masm::GPCGen::isolate_atomics() {
+  // The data memory is shared among the cores. A variable that the atomic
+  // instructions work on gets a cache line to itself since a write to
+  // anything else on its line would take the line away from the cores
+  // contending for it.
+  for (Node &n : final_nodes) {
+    size_t len;
+    switch (n.type) {
+    case NODE_DB:
+      len = 1;
       break;
-    }
-    case NODE_MOVG: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVG, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case NODE_DW:
+      len = 2;
       break;
-    }
-    case NODE_MOVNS: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVNS, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case NODE_DD:
+    case NODE_DF:
+      len = 4;
       break;
-    }
-    case NODE_MOVS: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVS, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case NODE_DQ:
+    case NODE_DP:
+    case NODE_DLF:
+      len = 8;
       break;
-    }
-    case NODE_MOVGE: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVGE, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    default:
+      continue;
+    }
+    NodeDB *d = (NodeDB *)&n.node;
+    if (!is_isolated(d->name))
+      continue;
+    align_data(data, &st_address_data, CACHE_LINE_LEN);
+    symtable[d->name].data_address = st_address_data;
+    add_data(data, d, n.type == NODE_DP ? 0 : len);
+    st_address_data += len;
+    align_data(data, &st_address_data, CACHE_LINE_LEN);
+    placed.insert(d->name);
+  }
+}
+
+void masm::GPCGen::isolate_atomic_reservations() {
+  // Same as isolate_atomics but there is nothing to pad with here
+  for (Node &n : final_nodes) {
+    if (n.type < NODE_RESB || n.type > NODE_RESLF)
+      continue;
+    NodeRESB *r = (NodeRESB *)&n.node;
+    if (!is_isolated(r->name))
+      continue;
+    size_t l = (n.type == NODE_RESB)                          ? 1
+               : (n.type == NODE_RESW)                        ? 2
+               : (n.type == NODE_RESD || n.type == NODE_RESF) ? 4
+                                                              : 8;
+    st_address_data = (st_address_data + CACHE_LINE_LEN - 1) &
+                      ~(uint64_t)(CACHE_LINE_LEN - 1);
+    reserve_data(r, l);
+    st_address_data = (st_address_data + CACHE_LINE_LEN - 1) &
+                      ~(uint64_t)(CACHE_LINE_LEN - 1);
+    placed.insert(r->name);
+  }
+}
+
+void masm::GPCGen::collect_layout(std::vector<LayoutItem> &items) {
+  for (Node &n : final_nodes) {
+    if (n.type < NODE_DB || n.type > NODE_RESLF)
+      continue;
+    NodeDB *d = (NodeDB *)&n.node;
+    items.push_back(
+        LayoutItem{d->name, symtable[d->name].data_address, variable_size(n)});
+  }
+}
+
+void masm::GPCGen::pool_strings() {
+  // Only strings the program never writes to can share their bytes.
+  // Identical strings are stored once. A string ending in a NUL that is the
+  // end of another one is stored inside it, found by sorting the strings by
+  // their reverse as linkers do for .rodata.str.
+  std::unordered_map<std::string_view, uint32_t> unique;
+  std::vector<NodeDS *> merge;
+  for (Node &n : final_nodes) {
+    NodeDS *ds = (NodeDS *)&n.node;
+    if (n.type != NODE_DS || ds->type != VALUE_STRING || ds->value.empty() ||
+        symtable[ds->name].is_written)
+      continue;
+    auto [first, inserted] = unique.emplace(ds->value, ds->name);
+    if (inserted) {
+      if (ds->value.back() == '\0')
+        merge.push_back(ds);
+      continue;
+    }
+    string_aliases[ds->name] = StringAlias{first->second, 0};
+    stats.strings_deduplicated++;
+    stats.string_bytes_saved += ds->value.length();
+  }
+
+  std::sort(merge.begin(), merge.end(), [](NodeDS *a, NodeDS *b) {
+    return std::lexicographical_compare(a->value.rbegin(), a->value.rend(),
+                                        b->value.rbegin(), b->value.rend());
+  });
+  // A string can only be the end of those right after it; the next one
+  // is the longest of them that is already placed.
+  for (size_t i = merge.size(); i-- > 1;) {
+    NodeDS *s = merge[i - 1], *next = merge[i];
+    if (!next->value.ends_with(s->value))
+      continue;
+    StringAlias at{next->name, next->value.length() - s->value.length()};
+    auto owner = string_aliases.find(next->name);
+    if (owner != string_aliases.end())
+      at = StringAlias{owner->second.owner, owner->second.offset + at.offset};
+    string_aliases[s->name] = at;
+    stats.strings_tail_merged++;
+    stats.string_bytes_saved += s->value.length();
+  }
+
+  // The duplicates of a string that went inside another go there too
+  for (auto &[name, alias] : string_aliases) {
+    auto owner = string_aliases.find(alias.owner);
+    if (owner != string_aliases.end())
+      alias = StringAlias{owner->second.owner,
+                          owner->second.offset + alias.offset};
+  }
+}
+
+bool masm::GPCGen::first_iteration_second_phase(uint64_t addr_point) {
+  // What is left after the read only section: the strings and bytes that
+  // are written to
+  st_address_data = addr_point;
+  for (auto &n : final_nodes) {
+    switch (n.type) {
+    case NODE_DS: {
+      NodeDS *ds = (NodeDS *)&n.node;
+      if (string_aliases.count(ds->name) || placed.count(ds->name))
+        break;
+      symtable[ds->name].data_address = st_address_data;
+      add_data(string, ds, 0);
+      st_address_data += ds->value.length();
       break;
     }
-    case NODE_MOVSE: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_MOVSE, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case NODE_DB: {
+      NodeDB *db = (NodeDB *)&n.node;
+      if (placed.count(db->name))
+        break;
+      symtable[db->name].data_address = st_address_data;
+      add_data(string, db, 1);
+      st_address_data++;
       break;
     }
-    case NODE_LOOP: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      auto label = label_addresses.find(imm->immediate);
-      Inst64 i;
-      i.bytes.b0 = OP_LOOP;
-      i.bytes.b1 = token_to_regr(imm->regr);
-      i.whole_word |= ((label->second & 0xFFFFFFFFFFFF));
-      instructions.push_back(i);
+    default:
       break;
     }
-    case NODE_INT: {
-      NodeImm *imm = (NodeImm *)n.node.get();
-      single_operand_which_is_immediate(OP_INTR, imm->imm, imm->type, 2);
-      auto i = *instructions.end();
-      instructions.pop_back();
-      instructions.pop_back();
-      i.bytes.b0 = OP_INTR;
-      instructions.push_back(i);
+  }
+  return true;
+}
+
+bool masm::GPCGen::first_iteration_bss_phase(uint64_t addr_point) {
+  // The reservations only get addresses. They come after every data and
+  // string in the order of the data(largest first) and the VM zero fills
+  // them at load.
+  st_address_data = addr_point;
+  if (std::none_of(final_nodes.begin(), final_nodes.end(), [](Node &n) {
+        return n.type >= NODE_RESB && n.type <= NODE_RESLF;
+      }))
+    return true;
+  uint64_t align = 8;
+  if (options.pack_data) {
+    // Only as aligned as the largest reservation needs
+    align = 1;
+    for (Node &n : final_nodes) {
+      if (n.type == NODE_RESW)
+        align = std::max<uint64_t>(align, 2);
+      else if (n.type == NODE_RESD || n.type == NODE_RESF)
+        align = std::max<uint64_t>(align, 4);
+      else if (n.type > NODE_RESB && n.type <= NODE_RESLF)
+        align = 8;
+    }
+  }
+  st_address_data = (st_address_data + align - 1) & ~(align - 1);
+  if (options.isolate_atomics)
+    isolate_atomic_reservations();
+  for (Node &n : final_nodes) {
+    switch (n.type) {
+    case NODE_RESP:
+    case NODE_RESQ:
+    case NODE_RESLF:
+      reserve_data((NodeRESB *)&n.node, 8);
       break;
-    }
-    case NODE_LOADSB: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_LOADSB, imm->regr, imm->immediate, imm->type, 2);
+    default:
       break;
     }
-    case NODE_LOADSW: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_LOADSW, imm->regr, imm->immediate, imm->type, 2);
+  }
+  for (Node &n : final_nodes) {
+    switch (n.type) {
+    case NODE_RESD:
+    case NODE_RESF:
+      reserve_data((NodeRESB *)&n.node, 4);
       break;
-    }
-    case NODE_LOADSD: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_LOADSD, imm->regr, imm->immediate, imm->type, 2);
+    default:
       break;
     }
-    case NODE_LOADSQ: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_LOADSQ, imm->regr, imm->immediate, imm->type, 2);
-      break;
+  }
+  for (Node &n : final_nodes) {
+    if (n.type == NODE_RESW)
+      reserve_data((NodeRESB *)&n.node, 2);
+  }
+  for (Node &n : final_nodes) {
+    if (n.type == NODE_RESB)
+      reserve_data((NodeRESB *)&n.node, 1);
+  }
+  return true;
+}
+
+bool masm::GPCGen::first_iteration_third_phase(uint64_t addr_point) {
+  st_address_data = addr_point;
+  for (Node &n : final_nodes) {
+    if (n.type == NODE_DP) {
+      NodeDP *dp = (NodeDP *)&n.node;
+      Data64 d;
+      d.whole_word = symtable[dp->value_id].data_address;
+      // The read only section starts at 0 and the data section after it
+      size_t this_ptr = symtable[dp->name].data_address;
+      std::vector<uint8_t> &bytes = this_ptr < rodata.size() ? rodata : data;
+      if (this_ptr >= rodata.size())
+        this_ptr -= rodata.size();
+      bytes[this_ptr] = d.bytes.b7;
+      bytes[this_ptr + 1] = d.bytes.b6;
+      bytes[this_ptr + 2] = d.bytes.b5;
+      bytes[this_ptr + 3] = d.bytes.b4;
+      bytes[this_ptr + 4] = d.bytes.b3;
+      bytes[this_ptr + 5] = d.bytes.b2;
+      bytes[this_ptr + 6] = d.bytes.b1;
+      bytes[this_ptr + 7] = d.bytes.b0;
     }
-    case NODE_STORESB: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_STORESB, imm->regr, imm->immediate, imm->type, 2);
+  }
+  return true;
+}
+
+bool masm::GPCGen::second_iteration() {
+  // Now we can go through the nodes and generate Instructions
+  // First instruction is actually a jump instruction to the
+  // entry procedure named main which must be defined
+  // otherwise there will be errors.
+
+  // How a node is encoded comes from the ISA table(see gpc_isa.cpp); all
+  // that is left here is one emit routine per operand layout.
+  position_independent = options.relative_jumps;
+  for (Node &n : final_nodes) {
+    const IsaEntry &e = isa_entry(n.type);
+    // Only jmp has a relative form; everything else that refers to code
+    // has its address
+    switch (e.layout) {
+    case LAYOUT_LABEL:
+      if (n.type != NODE_JMP_IMM)
+        position_independent = false;
+      break;
+    case LAYOUT_OP_LABEL64:
+    case LAYOUT_REG_LABEL:
+      position_independent = false;
+      break;
+    case LAYOUT_NO_CODE:
+      if (n.type == NODE_DP &&
+          symtable[((NodeDP *)&n.node)->value_id].is_label)
+        position_independent = false;
       break;
-    }
-    case NODE_STORESW: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_STORESW, imm->regr, imm->immediate, imm->type, 2);
+    default:
       break;
     }
-    case NODE_STORESD: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_STORESD, imm->regr, imm->immediate, imm->type, 2);
+    switch (e.layout) {
+    case LAYOUT_NO_CODE:
       break;
-    }
-    case NODE_STORESQ: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_STORESQ, imm->regr, imm->immediate, imm->type, 2);
+    case LAYOUT_OP:
+      simple_instructions(e.op);
       break;
-    }
-    case NODE_AND_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_AND_IMM, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case LAYOUT_REG: {
+      NodeReg *r = (NodeReg *)&n.node;
+      instructions_with_single_regr(e.op, token_to_regr(r->reg));
       break;
     }
-    case NODE_OR_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_OR_IMM, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case LAYOUT_REG_REG: {
+      NodeRegReg *rr = (NodeRegReg *)&n.node;
+      instructions_with_two_regr(e.op, token_to_regr(rr->r1),
+                                 token_to_regr(rr->r2));
       break;
     }
-    case NODE_XOR_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate(OP_XOR_IMM, imm->immediate, imm->type, 8,
-                                      imm->regr);
+    case LAYOUT_LABEL:
+      if (n.type == NODE_JMP_IMM && options.relative_jumps)
+        relative_jump(n);
+      else
+        instructions_with_one_immediate(e.op, n, 0, true, true);
       break;
-    }
-    case NODE_SHL_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_LSHIFT, imm->regr, imm->immediate, imm->type, 1);
+    case LAYOUT_OP_LABEL64: {
+      NodeImm *imm = (NodeImm *)&n.node;
+      Inst64 i;
+      i.bytes.b0 = e.op;
+      instructions.push_back(i);
+      i.whole_word = symtable[imm->name].label_address;
+      instructions.push_back(i);
       break;
     }
-    case NODE_SHR_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      two_operand_second_is_immediate_in_same_qword(
-          OP_RSHIFT, imm->regr, imm->immediate, imm->type, 1);
+    case LAYOUT_MEM: {
+      NodeImm *imm = (NodeImm *)&n.node;
+      single_operand_which_is_variable(e.op, imm->name);
       break;
     }
-    case NODE_CMP_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
+    case LAYOUT_IMM_OR_MEM: {
+      NodeImm *imm = (NodeImm *)&n.node;
       if (imm->is_var)
-        choose_opcode_according_to_variable(imm,
-                                            {OP_CMP_IMM_MEMB, OP_CMP_IMM_MEMW,
-                                             OP_CMP_IMM_MEMD, OP_CMP_IMM_MEMQ});
+        single_operand_which_is_variable(e.mem[0], imm->name);
       else
-        two_operand_second_is_immediate(OP_CMP_IMM, imm->immediate, imm->type,
-                                        8, imm->regr);
+        single_operand_which_is_immediate(e.op, imm->lit, imm->type,
+                                          e.imm_len);
       break;
     }
-    case NODE_LOADB_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_LOADB});
-      break;
-    }
-    case NODE_LOADW_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, OP_LOADW});
-      break;
-    }
-    case NODE_LOADD_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, 0, OP_LOADD});
-      break;
-    }
-    case NODE_LOADQ_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, 0, 0, OP_LOADQ});
-      break;
-    }
-    case NODE_STOREB_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_STOREB});
-      break;
-    }
-    case NODE_STOREW_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, OP_STOREW});
-      break;
-    }
-    case NODE_STORED_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, 0, OP_STORED});
-      break;
-    }
-    case NODE_STOREQ_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, 0, 0, OP_STOREQ});
-      break;
-    }
-    case NODE_ATM_LOADB_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_ATOMIC_LOADB});
-      break;
-    }
-    case NODE_ATM_LOADW_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, OP_ATOMIC_LOADW});
-      break;
-    }
-    case NODE_ATM_LOADD_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, 0, OP_ATOMIC_LOADD});
+    case LAYOUT_REG_IMM: {
+      NodeRegrImm *imm = (NodeRegrImm *)&n.node;
+      two_operand_second_is_immediate(e.op, imm->lit, imm->type, e.imm_len,
+                                      imm->regr);
       break;
     }
-    case NODE_ATM_LOADQ_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, 0, 0, OP_ATOMIC_LOADQ});
+    case LAYOUT_REG_IMM_OR_MEM: {
+      NodeRegrImm *imm = (NodeRegrImm *)&n.node;
+      if (imm->is_var)
+        choose_opcode_according_to_variable(imm, e.mem);
+      else
+        two_operand_second_is_immediate(e.op, imm->lit, imm->type, e.imm_len,
+                                        imm->regr);
       break;
     }
-    case NODE_ATM_STOREB_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {OP_ATOMIC_STOREB});
+    case LAYOUT_REG_MEM: {
+      NodeRegrImm *imm = (NodeRegrImm *)&n.node;
+      choose_opcode_according_to_variable(imm, e.mem);
       break;
     }
-    case NODE_ATM_STOREW_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, OP_ATOMIC_STOREW});
+    case LAYOUT_REG_IMM16: {
+      NodeRegrImm *imm = (NodeRegrImm *)&n.node;
+      two_operand_second_is_immediate_in_same_qword(e.op, imm->regr, imm->lit,
+                                                    imm->type, e.imm_len);
       break;
     }
-    case NODE_ATM_STORED_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, 0, OP_ATOMIC_STORED});
+    case LAYOUT_REG_LABEL: {
+      NodeRegrImm *imm = (NodeRegrImm *)&n.node;
+      Inst64 i;
+      i.bytes.b0 = e.op;
+      i.bytes.b1 = token_to_regr(imm->regr);
+      i.whole_word |= ((symtable[imm->name].label_address & 0xFFFFFFFFFFFF));
+      instructions.push_back(i);
       break;
     }
-    case NODE_ATM_STOREQ_IMM: {
-      NodeRegrImm *imm = (NodeRegrImm *)n.node.get();
-      choose_opcode_according_to_variable(imm, {0, 0, 0, OP_ATOMIC_STOREQ});
+    case LAYOUT_INT: {
+      NodeImm *imm = (NodeImm *)&n.node;
+      Inst64 i;
+      i.whole_word = imm->lit.bits(e.imm_len);
+      i.bytes.b0 = e.op;
+      instructions.push_back(i);
       break;
     }
-    case NODE_LEA: {
-      NodeLea *l = (NodeLea *)n.node.get();
+    case LAYOUT_LEA: {
+      NodeLea *l = (NodeLea *)&n.node;
       Inst64 i;
-      i.bytes.b0 = OP_LEA;
+      i.bytes.b0 = e.op;
       i.bytes.b4 = token_to_regr(l->r1);
       i.bytes.b5 = token_to_regr(l->r2);
       i.bytes.b6 = token_to_regr(l->r3);
@@ -1405,50 +708,42 @@ bool masm::GPCGen::second_iteration() {
       instructions.push_back(i);
       break;
     }
-    case NODE_CMPXCHG_IMM: {
-      NodeCMPXCHGImm *ci = (NodeCMPXCHGImm *)n.node.get();
-      auto data = data_addresses.find(ci->imm);
+    case LAYOUT_CMPXCHG_MEM: {
+      NodeCMPXCHGImm *ci = (NodeCMPXCHGImm *)&n.node;
       Inst64 i;
-      i.bytes.b0 = OP_CMPXCHG;
+      i.bytes.b0 = e.op;
       i.bytes.b6 = token_to_regr(ci->r1);
       i.bytes.b7 = token_to_regr(ci->r2);
       instructions.push_back(i);
-      i.whole_word = data->second;
+      i.whole_word = symtable[ci->name].data_address;
       instructions.push_back(i);
       break;
     }
-    case NODE_CMPXCHG_REG: {
-      NodeCMPXCHGReg *ci = (NodeCMPXCHGReg *)n.node.get();
+    case LAYOUT_CMPXCHG_REG: {
+      NodeCMPXCHGReg *ci = (NodeCMPXCHGReg *)&n.node;
       Inst64 i;
-      i.bytes.b0 = OP_CMPXCHG_REGR;
+      i.bytes.b0 = e.op;
       i.bytes.b6 = token_to_regr(ci->r1);
       i.bytes.b7 = token_to_regr(ci->r2);
       i.bytes.b5 = token_to_regr(ci->r3);
       instructions.push_back(i);
       break;
     }
-    default:
-      simple_message("Unknown NODE %u %zu", n.type, n.line);
-      break;
     }
   }
 
   return true;
 }
 
-void masm::GPCGen::add_data(std::string value, value_t type, size_t len) {
+void masm::GPCGen::add_data(std::vector<uint8_t> &bytes, NodeDB *n,
+                            size_t len) {
   Data64 val;
-  switch (type) {
-  case VALUE_HEX: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 16);
-    break;
-  }
-  case VALUE_OCTAL: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 8);
-    break;
-  }
-  case VALUE_BINARY: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 2);
+  switch (n->type) {
+  case VALUE_HEX:
+  case VALUE_OCTAL:
+  case VALUE_BINARY:
+  case VALUE_FLOAT: {
+    val.whole_word = n->lit.bits(len);
     break;
   }
   case VALUE_INTEGER: {
@@ -1457,76 +752,38 @@ void masm::GPCGen::add_data(std::string value, value_t type, size_t len) {
       len = 8;
       break;
     }
-    val.whole_word = std::strtoull(value.c_str(), NULL, 10);
-    break;
-  }
-  case VALUE_FLOAT: {
-    if (len == 8) {
-      union {
-        double d;
-        uint64_t i;
-      } fl;
-      fl.d = std::strtod(value.c_str(), NULL);
-      val.whole_word = fl.i;
-    } else {
-      union {
-        float d;
-        uint32_t i;
-      } fl;
-      fl.d = std::strtof(value.c_str(), NULL);
-      val.whole_word = fl.i;
-    }
+    val.whole_word = n->lit.bits(len);
     break;
   }
   case VALUE_STRING: {
-    for (size_t i = 0; i < value.length(); i++)
-      string.push_back(value[i]);
+    bytes.insert(bytes.end(), n->value.begin(), n->value.end());
     return;
   }
   default:
     return;
   }
-  if (len == 1) {
-    string.push_back(val.bytes.b7);
-  } else {
-    for (size_t i = 0; i < len; i++) {
-      data.push_back(val.whole_word & 255);
-      val.whole_word >>= 8;
-    }
+  for (size_t i = 0; i < len; i++) {
+    bytes.push_back(val.whole_word & 255);
+    val.whole_word >>= 8;
   }
 }
 
-void masm::GPCGen::add_reserved_data(std::string len, value_t type, size_t l) {
+void masm::GPCGen::reserve_data(NodeRESB *n, size_t l) {
   uint64_t val;
-  switch (type) {
-  case VALUE_HEX: {
-    val = std::strtoull(len.c_str(), NULL, 16);
-    break;
-  }
-  case VALUE_OCTAL: {
-    val = std::strtoull(len.c_str(), NULL, 8);
-    break;
-  }
-  case VALUE_BINARY: {
-    val = std::strtoull(len.c_str(), NULL, 2);
-    break;
-  }
+  switch (n->type) {
+  case VALUE_HEX:
+  case VALUE_OCTAL:
+  case VALUE_BINARY:
   case VALUE_INTEGER: {
-    val = std::strtoull(len.c_str(), NULL, 10);
+    val = n->lit.u;
     break;
   }
   default:
     return;
   }
-  if (l != 1) {
-    for (size_t i = 0; i < l * val; i++) {
-      data.push_back(0);
-    }
-  } else {
-    for (size_t i = 0; i < val; i++) {
-      string.push_back(0);
-    }
-  }
+  if (placed.count(n->name))
+    return;
+  symtable[n->name].data_address = st_address_data;
   st_address_data += l * val;
 }
 
@@ -1594,119 +851,59 @@ void masm::GPCGen::instructions_with_two_regr(uint8_t opcode, uint8_t reg1,
 void masm::GPCGen::instructions_with_one_immediate(uint8_t opcode, Node &n,
                                                    size_t len, bool label,
                                                    uint8_t op2, bool jmp) {
-  NodeImm *imm = (NodeImm *)n.node.get();
+  NodeImm *imm = (NodeImm *)&n.node;
   Inst64 inst;
   inst.bytes.b0 = opcode;
   if (imm->is_var) {
-    std::unordered_map<std::string, uint64_t>::iterator i;
-    if (!label) {
-      i = data_addresses.find(imm->imm);
-      // i should be valid since analyzer already analyzed the
-    } else {
-      i = label_addresses.find(imm->imm);
-    }
-    inst.whole_word |= ((i->second & 0xFFFFFFFFFFFF) - ((jmp) ? 8 : 0));
+    // the analyzer already made sure that the symbol is valid
+    Symbol &sym = symtable[imm->name];
+    uint64_t addr = label ? sym.label_address : sym.data_address;
+    inst.whole_word |= ((addr & 0xFFFFFFFFFFFF) - ((jmp) ? 8 : 0));
   } else {
     inst.bytes.b0 = op2;
     instructions.push_back(inst);
     Inst64 val;
-    std::string value = imm->imm;
-    switch (imm->type) {
-    case VALUE_HEX: {
-      val.whole_word = std::strtoull(value.c_str(), NULL, 16);
-      break;
-    }
-    case VALUE_OCTAL: {
-      val.whole_word = std::strtoull(value.c_str(), NULL, 8);
-      break;
-    }
-    case VALUE_BINARY: {
-      val.whole_word = std::strtoull(value.c_str(), NULL, 2);
-      break;
-    }
-    case VALUE_INTEGER: {
-      val.whole_word = std::strtoull(value.c_str(), NULL, 10);
-      break;
-    }
-    case VALUE_FLOAT: {
-      if (len == 8) {
-        union {
-          double d;
-          uint64_t i;
-        } fl;
-        fl.d = std::strtod(value.c_str(), NULL);
-        val.whole_word = fl.i;
-      } else {
-        union {
-          float d;
-          uint32_t i;
-        } fl;
-        fl.d = std::strtof(value.c_str(), NULL);
-        val.whole_word = fl.i;
-      }
-      break;
-    }
-    }
+    val.whole_word = imm->lit.bits(len);
     inst = val;
   }
   instructions.push_back(inst);
 }
 
-void masm::GPCGen::sin_and_sout_instructions(Node &n) {
-  NodeImm *i = (NodeImm *)n.node.get();
-  uint8_t op = n.type == NODE_SIN_IMM ? OP_SIN : OP_SOUT;
-  single_operand_which_is_variable(op, i->imm);
+void masm::GPCGen::relative_jump(Node &n) {
+  // Both forms of jmp take one qword so picking one never moves a label;
+  // the addresses from the first iteration hold and the offset, like the
+  // addresses, always fits in 48 bits. The entry instruction is the first
+  // qword.
+  uint64_t at = (instructions.size() + 1) * 8;
+  Inst64 i;
+  i.bytes.b0 = OP_JMP_OFF;
+  i.whole_word |=
+      (symtable[((NodeImm *)&n.node)->name].label_address - at) &
+      0xFFFFFFFFFFFF;
+  instructions.push_back(i);
 }
 
 void masm::GPCGen::single_operand_which_is_variable(uint8_t opcode,
-                                                    std::string name) {
-  auto var = data_addresses.find(name);
-  if (var == data_addresses.end()) {
-    var = label_addresses.find(name); // This shouldn't fail
-  }
+                                                    uint32_t name) {
+  Symbol &sym = symtable[name];
+  uint64_t addr = sym.is_var ? sym.data_address : sym.label_address;
   Inst64 i;
   i.bytes.b0 = opcode;
-  i.whole_word |= ((var->second & 0xFFFFFFFFFFFF));
+  i.whole_word |= ((addr & 0xFFFFFFFFFFFF));
   instructions.push_back(i);
 }
 
 void masm::GPCGen::single_operand_which_is_immediate(uint8_t opcode,
-                                                     std::string value,
+                                                     const Literal &value,
                                                      value_t type, size_t len) {
   Inst64 val;
   switch (type) {
-  case VALUE_HEX: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 16);
-    break;
-  }
-  case VALUE_OCTAL: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 8);
-    break;
-  }
-  case VALUE_BINARY: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 2);
-    break;
-  }
-  case VALUE_INTEGER: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 10);
-    break;
-  }
+  case VALUE_HEX:
+  case VALUE_OCTAL:
+  case VALUE_BINARY:
+  case VALUE_INTEGER:
   case VALUE_FLOAT: {
-    if (len == 8) {
-      union {
-        double d;
-        uint64_t i;
-      } fl;
-      fl.d = std::strtod(value.c_str(), NULL);
-      val.whole_word = fl.i;
-    } else {
-      union {
-        float d;
-        uint32_t i;
-      } fl;
-      fl.d = std::strtof(value.c_str(), NULL);
-      val.whole_word = fl.i;
-    }
+    val.whole_word = value.bits(len);
     break;
   }
   default:
@@ -1719,43 +916,17 @@ void masm::GPCGen::single_operand_which_is_immediate(uint8_t opcode,
 }
 
 void masm::GPCGen::two_operand_second_is_immediate(uint8_t opcode,
-                                                   std::string value,
+                                                   const Literal &value,
                                                    value_t type, size_t len,
                                                    token_t reg1) {
   Inst64 val;
   switch (type) {
-  case VALUE_HEX: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 16);
-    break;
-  }
-  case VALUE_OCTAL: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 8);
-    break;
-  }
-  case VALUE_BINARY: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 2);
-    break;
-  }
-  case VALUE_INTEGER: {
-    val.whole_word = std::strtoull(value.c_str(), NULL, 10);
-    break;
-  }
+  case VALUE_HEX:
+  case VALUE_OCTAL:
+  case VALUE_BINARY:
+  case VALUE_INTEGER:
   case VALUE_FLOAT: {
-    if (len == 8) {
-      union {
-        double d;
-        uint64_t i;
-      } fl;
-      fl.d = std::strtod(value.c_str(), NULL);
-      val.whole_word = fl.i;
-    } else {
-      union {
-        float d;
-        uint32_t i;
-      } fl;
-      fl.d = std::strtof(value.c_str(), NULL);
-      val.whole_word = fl.i;
-    }
+    val.whole_word = value.bits(len);
     break;
   }
   default:
@@ -1769,13 +940,11 @@ void masm::GPCGen::two_operand_second_is_immediate(uint8_t opcode,
 }
 
 void masm::GPCGen::choose_opcode_according_to_variable(
-    NodeRegrImm *n, std::vector<uint8_t> opcodes) {
-  std::unordered_map<std::string, Symbol>::iterator iter =
-      symtable.find_symbol(n->immediate);
-  auto address = data_addresses.find(n->immediate);
+    NodeRegrImm *n, const uint8_t *opcodes) {
+  Symbol &sym = symtable[n->name];
   Inst64 i;
   i.bytes.b1 = token_to_regr(n->regr);
-  switch (iter->second.type) {
+  switch (sym.type) {
   case BYTE:
   case STRING:
   case RESB: {
@@ -1804,36 +973,29 @@ void masm::GPCGen::choose_opcode_according_to_variable(
   default:
     break;
   }
-  i.whole_word |= ((address->second & 0xFFFFFFFFFFFF));
+  i.whole_word |= ((sym.data_address & 0xFFFFFFFFFFFF));
   instructions.push_back(i);
 }
 
 void masm::GPCGen::two_operand_second_is_immediate_in_same_qword(
-    uint8_t opcode, token_t regr, std::string imm, value_t type, size_t len) {
+    uint8_t opcode, token_t regr, const Literal &imm, value_t type,
+    size_t len) {
   Inst64 i;
   Data64 val;
   i.bytes.b0 = opcode;
   i.bytes.b1 = token_to_regr(regr);
   switch (type) {
-  case VALUE_HEX: {
-    val.whole_word = std::strtoull(imm.c_str(), NULL, 16);
-    break;
-  }
-  case VALUE_OCTAL: {
-    val.whole_word = std::strtoull(imm.c_str(), NULL, 8);
-    break;
-  }
-  case VALUE_BINARY: {
-    val.whole_word = std::strtoull(imm.c_str(), NULL, 2);
-    break;
-  }
+  case VALUE_HEX:
+  case VALUE_OCTAL:
+  case VALUE_BINARY:
   case VALUE_INTEGER: {
-    val.whole_word = std::strtoull(imm.c_str(), NULL, 10);
+    val.whole_word = imm.u;
     break;
   }
   default:
     return;
   }
-  i.half_words.w1 = val.whole_word & 0xFFFF;
+  // movsxd is the only one with more than 16 bits
+  i.half_words.w1 = val.whole_word & (len == 4 ? 0xFFFFFFFF : 0xFFFF);
   instructions.push_back(i);
 }
@@ -0,0 +1,443 @@
+#include <gpc.hpp> // the VM's opcode list
+#include <gpc_gen_base.hpp>
+
+namespace masm {
+#define GPC_OPCODE_MATCHES_VM(name)                                           \
+  static_assert((int)OP_##name == (int)core_dets::OP_##name,                 \
+                "OP_" #name " differs from the VM's numbering");
+GPC_OPCODES(GPC_OPCODE_MATCHES_VM)
+#undef GPC_OPCODE_MATCHES_VM
+
+// The encoding of every kind of node. Adding an instruction that fits an
+// existing layout is an entry here; the analyzer takes the length from it
+// and GPCGen::second_iteration the opcodes.
+static constexpr IsaEntry isa[] = {
+    // No code of their own
+    {INCLUDE_DIR},
+    {CONST_DEF},
+    {NODE_LABEL},
+    {NODE_DB},
+    {NODE_DW},
+    {NODE_DD},
+    {NODE_DQ},
+    {NODE_DP},
+    {NODE_DS},
+    {NODE_DF},
+    {NODE_DLF},
+    {NODE_RESB},
+    {NODE_RESW},
+    {NODE_RESD},
+    {NODE_RESQ},
+    {NODE_RESP},
+    {NODE_RESF},
+    {NODE_RESLF},
+    // The parser never produces the register forms of the atomics
+    {NODE_ATM_LOADB_REG},
+    {NODE_ATM_LOADW_REG},
+    {NODE_ATM_LOADD_REG},
+    {NODE_ATM_LOADQ_REG},
+    {NODE_ATM_STOREB_REG},
+    {NODE_ATM_STOREW_REG},
+    {NODE_ATM_STORED_REG},
+    {NODE_ATM_STOREQ_REG},
+
+    // Instructions
+    {NODE_NOP, LAYOUT_OP, OP_NOP},
+    {NODE_HALT, LAYOUT_OP, OP_HALT},
+    {NODE_RET, LAYOUT_OP, OP_RET},
+    {NODE_RETNZ, LAYOUT_OP, OP_RETNZ},
+    {NODE_RETZ, LAYOUT_OP, OP_RETZ},
+    {NODE_RETNE, LAYOUT_OP, OP_RETNE},
+    {NODE_RETE, LAYOUT_OP, OP_RETE},
+    {NODE_RETNC, LAYOUT_OP, OP_RETNC},
+    {NODE_RETC, LAYOUT_OP, OP_RETC},
+    {NODE_RETNO, LAYOUT_OP, OP_RETNO},
+    {NODE_RETO, LAYOUT_OP, OP_RETO},
+    {NODE_RETNN, LAYOUT_OP, OP_RETNN},
+    {NODE_RETN, LAYOUT_OP, OP_RETN},
+    {NODE_RETNG, LAYOUT_OP, OP_RETNG},
+    {NODE_RETG, LAYOUT_OP, OP_RETG},
+    {NODE_RETNS, LAYOUT_OP, OP_RETNS},
+    {NODE_RETS, LAYOUT_OP, OP_RETS},
+    {NODE_RETGE, LAYOUT_OP, OP_RETGE},
+    {NODE_RETSE, LAYOUT_OP, OP_RETSE},
+    {NODE_PUSHA, LAYOUT_OP, OP_PUSHA},
+    {NODE_POPA, LAYOUT_OP, OP_POPA},
+    {NODE_OUTR, LAYOUT_OP, OP_OUTR},
+    {NODE_UOUTR, LAYOUT_OP, OP_UOUTR},
+    {NODE_CFLAGS, LAYOUT_OP, OP_CFLAGS},
+    {NODE_RESET, LAYOUT_OP, OP_RESET},
+    {NODE_INC, LAYOUT_REG, OP_INC},
+    {NODE_DEC, LAYOUT_REG, OP_DEC},
+    {NODE_CALL_REG, LAYOUT_REG, OP_CALL_REG},
+    {NODE_JMP_REG, LAYOUT_REG, OP_JMP_REGR},
+    {NODE_PUSH, LAYOUT_REG, OP_PUSH_REG},
+    {NODE_POPB_REG, LAYOUT_REG, OP_POP8},
+    {NODE_POPW_REG, LAYOUT_REG, OP_POP16},
+    {NODE_POPD_REG, LAYOUT_REG, OP_POP32},
+    {NODE_POPQ_REG, LAYOUT_REG, OP_POP64},
+    {NODE_NOT, LAYOUT_REG, OP_NOT},
+    {NODE_CIN, LAYOUT_REG, OP_CIN},
+    {NODE_COUT, LAYOUT_REG, OP_COUT},
+    {NODE_IN, LAYOUT_REG, OP_IN},
+    {NODE_OUT, LAYOUT_REG, OP_OUT},
+    {NODE_INW, LAYOUT_REG, OP_INW},
+    {NODE_OUTW, LAYOUT_REG, OP_OUTW},
+    {NODE_IND, LAYOUT_REG, OP_IND},
+    {NODE_OUTD, LAYOUT_REG, OP_OUTD},
+    {NODE_INQ, LAYOUT_REG, OP_INQ},
+    {NODE_OUTQ, LAYOUT_REG, OP_OUTQ},
+    {NODE_UIN, LAYOUT_REG, OP_UIN},
+    {NODE_UOUT, LAYOUT_REG, OP_UOUT},
+    {NODE_UINW, LAYOUT_REG, OP_UINW},
+    {NODE_UOUTW, LAYOUT_REG, OP_UOUTW},
+    {NODE_UIND, LAYOUT_REG, OP_UIND},
+    {NODE_UOUTD, LAYOUT_REG, OP_UOUTD},
+    {NODE_UINQ, LAYOUT_REG, OP_UINQ},
+    {NODE_UOUTQ, LAYOUT_REG, OP_UOUTQ},
+    {NODE_INF, LAYOUT_REG, OP_INF},
+    {NODE_INF32, LAYOUT_REG, OP_INF32},
+    {NODE_OUTF, LAYOUT_REG, OP_OUTF},
+    {NODE_OUTF32, LAYOUT_REG, OP_OUTF32},
+    {NODE_SOUT_REG, LAYOUT_REG, OP_SOUT_REG},
+    {NODE_SIN_REG, LAYOUT_REG, OP_SIN_REG},
+    {NODE_ADD_REGR, LAYOUT_REG_REG, OP_ADD_REG},
+    {NODE_SUB_REGR, LAYOUT_REG_REG, OP_SUB_REG},
+    {NODE_MUL_REGR, LAYOUT_REG_REG, OP_MUL_REG},
+    {NODE_DIV_REGR, LAYOUT_REG_REG, OP_DIV_REG},
+    {NODE_MOD_REGR, LAYOUT_REG_REG, OP_MOD_REG},
+    {NODE_IADD_REGR, LAYOUT_REG_REG, OP_IADD_REG},
+    {NODE_ISUB_REGR, LAYOUT_REG_REG, OP_ISUB_REG},
+    {NODE_IMUL_REGR, LAYOUT_REG_REG, OP_IMUL_REG},
+    {NODE_IDIV_REGR, LAYOUT_REG_REG, OP_IDIV_REG},
+    {NODE_IMOD_REGR, LAYOUT_REG_REG, OP_IMOD_REG},
+    {NODE_FADD_REGR, LAYOUT_REG_REG, OP_FADD},
+    {NODE_FSUB_REGR, LAYOUT_REG_REG, OP_FSUB},
+    {NODE_FMUL_REGR, LAYOUT_REG_REG, OP_FMUL},
+    {NODE_FDIV_REGR, LAYOUT_REG_REG, OP_FDIV},
+    {NODE_FADD32_REGR, LAYOUT_REG_REG, OP_FADD32},
+    {NODE_FSUB32_REGR, LAYOUT_REG_REG, OP_FSUB32},
+    {NODE_FMUL32_REGR, LAYOUT_REG_REG, OP_FMUL32},
+    {NODE_FDIV32_REGR, LAYOUT_REG_REG, OP_FDIV32},
+    {NODE_MOVB, LAYOUT_REG_REG, OP_MOVE_REG8},
+    {NODE_MOVW, LAYOUT_REG_REG, OP_MOVE_REG16},
+    {NODE_MOVD, LAYOUT_REG_REG, OP_MOVE_REG32},
+    {NODE_MOVQ, LAYOUT_REG_REG, OP_MOVE_REG},
+    {NODE_MOVSXB_REG, LAYOUT_REG_REG, OP_MOVESX_REG8},
+    {NODE_MOVSXW_REG, LAYOUT_REG_REG, OP_MOVESX_REG16},
+    {NODE_MOVSXD_REG, LAYOUT_REG_REG, OP_MOVESX_REG32},
+    {NODE_EXCGB, LAYOUT_REG_REG, OP_EXCG8},
+    {NODE_EXCGW, LAYOUT_REG_REG, OP_EXCG16},
+    {NODE_EXCGD, LAYOUT_REG_REG, OP_EXCG32},
+    {NODE_EXCGQ, LAYOUT_REG_REG, OP_EXCG},
+    {NODE_MOVEB, LAYOUT_REG_REG, OP_MOV8},
+    {NODE_MOVEW, LAYOUT_REG_REG, OP_MOV16},
+    {NODE_MOVED, LAYOUT_REG_REG, OP_MOV32},
+    {NODE_MOVEQ, LAYOUT_REG_REG, OP_MOVE_REG},
+    {NODE_AND_REGR, LAYOUT_REG_REG, OP_AND_REG},
+    {NODE_OR_REGR, LAYOUT_REG_REG, OP_OR_REG},
+    {NODE_XOR_REGR, LAYOUT_REG_REG, OP_XOR_REG},
+    {NODE_SHL_REGR, LAYOUT_REG_REG, OP_LSHIFT_REGR},
+    {NODE_SHR_REGR, LAYOUT_REG_REG, OP_RSHIFT_REGR},
+    {NODE_FCMP, LAYOUT_REG_REG, OP_FCMP},
+    {NODE_FCMP32, LAYOUT_REG_REG, OP_FCMP32},
+    {NODE_LOADB_REG, LAYOUT_REG_REG, OP_LOADB_REG},
+    {NODE_LOADW_REG, LAYOUT_REG_REG, OP_LOADW_REG},
+    {NODE_LOADD_REG, LAYOUT_REG_REG, OP_LOADD_REG},
+    {NODE_LOADQ_REG, LAYOUT_REG_REG, OP_LOADQ_REG},
+    {NODE_STOREB_REG, LAYOUT_REG_REG, OP_STOREB_REG},
+    {NODE_STOREW_REG, LAYOUT_REG_REG, OP_STOREW_REG},
+    {NODE_STORED_REG, LAYOUT_REG_REG, OP_STORED_REG},
+    {NODE_STOREQ_REG, LAYOUT_REG_REG, OP_STOREQ_REG},
+    {NODE_CMP_REGR, LAYOUT_REG_REG, OP_CMP_REG},
+    {NODE_JMP_IMM, LAYOUT_LABEL, OP_JMP_ADDR},
+    {NODE_CALL_IMM, LAYOUT_LABEL, OP_CALL},
+    {NODE_JNZ, LAYOUT_LABEL, OP_JNZ},
+    {NODE_JZ, LAYOUT_LABEL, OP_JZ},
+    {NODE_JNE, LAYOUT_LABEL, OP_JNE},
+    {NODE_JE, LAYOUT_LABEL, OP_JE},
+    {NODE_JNC, LAYOUT_LABEL, OP_JNC},
+    {NODE_JC, LAYOUT_LABEL, OP_JC},
+    {NODE_JNO, LAYOUT_LABEL, OP_JNO},
+    {NODE_JO, LAYOUT_LABEL, OP_JO},
+    {NODE_JNN, LAYOUT_LABEL, OP_JNN},
+    {NODE_JN, LAYOUT_LABEL, OP_JN},
+    {NODE_JNG, LAYOUT_LABEL, OP_JNG},
+    {NODE_JG, LAYOUT_LABEL, OP_JG},
+    {NODE_JNS, LAYOUT_LABEL, OP_JNS},
+    {NODE_JS, LAYOUT_LABEL, OP_JS},
+    {NODE_JGE, LAYOUT_LABEL, OP_JGE},
+    {NODE_JSE, LAYOUT_LABEL, OP_JSE},
+    {.node = NODE_PUSHB,
+     .layout = LAYOUT_IMM_OR_MEM,
+     .op = OP_PUSH_IMM8,
+     .imm_len = 1,
+     .mem = {OP_PUSH_MEMB}},
+    {.node = NODE_PUSHW,
+     .layout = LAYOUT_IMM_OR_MEM,
+     .op = OP_PUSH_IMM16,
+     .imm_len = 2,
+     .mem = {OP_PUSH_MEMW}},
+    {.node = NODE_PUSHD,
+     .layout = LAYOUT_IMM_OR_MEM,
+     .op = OP_PUSH_IMM32,
+     .imm_len = 4,
+     .mem = {OP_PUSH_MEMD}},
+    {.node = NODE_PUSHQ,
+     .layout = LAYOUT_IMM_OR_MEM,
+     .op = OP_PUSH_IMM64,
+     .imm_len = 8,
+     .mem = {OP_PUSH_MEMQ}},
+    {NODE_POPB_IMM, LAYOUT_MEM, OP_POP_MEMB},
+    {NODE_POPW_IMM, LAYOUT_MEM, OP_POP_MEMW},
+    {NODE_POPD_IMM, LAYOUT_MEM, OP_POP_MEMD},
+    {NODE_POPQ_IMM, LAYOUT_MEM, OP_POP_MEMQ},
+    {.node = NODE_ADD_IMM,
+     .layout = LAYOUT_REG_IMM_OR_MEM,
+     .op = OP_ADD_IMM,
+     .mem = {OP_ADD_MEMB, OP_ADD_MEMW, OP_ADD_MEMD, OP_ADD_MEMQ}},
+    {.node = NODE_SUB_IMM,
+     .layout = LAYOUT_REG_IMM_OR_MEM,
+     .op = OP_SUB_IMM,
+     .mem = {OP_SUB_MEMB, OP_SUB_MEMW, OP_SUB_MEMD, OP_SUB_MEMQ}},
+    {.node = NODE_MUL_IMM,
+     .layout = LAYOUT_REG_IMM_OR_MEM,
+     .op = OP_MUL_IMM,
+     .mem = {OP_MUL_MEMB, OP_MUL_MEMW, OP_MUL_MEMD, OP_MUL_MEMQ}},
+    {.node = NODE_DIV_IMM,
+     .layout = LAYOUT_REG_IMM_OR_MEM,
+     .op = OP_DIV_IMM,
+     .mem = {OP_DIV_MEMB, OP_DIV_MEMW, OP_DIV_MEMD, OP_DIV_MEMQ}},
+    {.node = NODE_MOD_IMM,
+     .layout = LAYOUT_REG_IMM_OR_MEM,
+     .op = OP_MOD_IMM,
+     .mem = {OP_MOD_MEMB, OP_MOD_MEMW, OP_MOD_MEMD, OP_MOD_MEMQ}},
+    {NODE_IADD_IMM, LAYOUT_REG_IMM, OP_IADD_IMM, 8},
+    {NODE_ISUB_IMM, LAYOUT_REG_IMM, OP_ISUB_IMM, 8},
+    {NODE_IMUL_IMM, LAYOUT_REG_IMM, OP_IMUL_IMM, 8},
+    {NODE_IDIV_IMM, LAYOUT_REG_IMM, OP_IDIV_IMM, 8},
+    {NODE_IMOD_IMM, LAYOUT_REG_IMM, OP_IMOD_IMM, 8},
+    {.node = NODE_FADD32_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_FADD32_MEM}},
+    {.node = NODE_FSUB32_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_FSUB32_MEM}},
+    {.node = NODE_FMUL32_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_FMUL32_MEM}},
+    {.node = NODE_FDIV32_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_FDIV32_MEM}},
+    {.node = NODE_FADD_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_FADD_MEM}},
+    {.node = NODE_FSUB_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_FSUB_MEM}},
+    {.node = NODE_FMUL_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_FMUL_MEM}},
+    {.node = NODE_FDIV_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_FDIV_MEM}},
+    {NODE_MOV, LAYOUT_REG_IMM, OP_MOVE_IMM_64, 8},
+    {NODE_MOVF32, LAYOUT_REG_IMM, OP_MOVE_IMM_64, 4},
+    {NODE_MOVF, LAYOUT_REG_IMM, OP_MOVE_IMM_64, 8},
+    {NODE_MOVSXB_IMM, LAYOUT_REG_IMM16, OP_MOVESX_IMM8, 1},
+    {NODE_MOVSXW_IMM, LAYOUT_REG_IMM16, OP_MOVESX_IMM16, 2},
+    {NODE_MOVSXD_IMM, LAYOUT_REG_IMM16, OP_MOVESX_IMM32, 4},
+    {NODE_MOVNZ, LAYOUT_REG_IMM, OP_MOVNZ, 8},
+    {NODE_MOVZ, LAYOUT_REG_IMM, OP_MOVZ, 8},
+    {NODE_MOVNE, LAYOUT_REG_IMM, OP_MOVNE, 8},
+    {NODE_MOVE, LAYOUT_REG_IMM, OP_MOVE, 8},
+    {NODE_MOVNC, LAYOUT_REG_IMM, OP_MOVNC, 8},
+    {NODE_MOVC, LAYOUT_REG_IMM, OP_MOVC, 8},
+    {NODE_MOVNO, LAYOUT_REG_IMM, OP_MOVNO, 8},
+    {NODE_MOVO, LAYOUT_REG_IMM, OP_MOVO, 8},
+    {NODE_MOVNN, LAYOUT_REG_IMM, OP_MOVNN, 8},
+    {NODE_MOVN, LAYOUT_REG_IMM, OP_MOVN, 8},
+    {NODE_MOVNG, LAYOUT_REG_IMM, OP_MOVNG, 8},
+    {NODE_MOVG, LAYOUT_REG_IMM, OP_MOVG, 8},
+    {NODE_MOVNS, LAYOUT_REG_IMM, OP_MOVNS, 8},
+    {NODE_MOVS, LAYOUT_REG_IMM, OP_MOVS, 8},
+    {NODE_MOVGE, LAYOUT_REG_IMM, OP_MOVGE, 8},
+    {NODE_MOVSE, LAYOUT_REG_IMM, OP_MOVSE, 8},
+    {NODE_LOADSB, LAYOUT_REG_IMM16, OP_LOADSB, 2},
+    {NODE_LOADSW, LAYOUT_REG_IMM16, OP_LOADSW, 2},
+    {NODE_LOADSD, LAYOUT_REG_IMM16, OP_LOADSD, 2},
+    {NODE_LOADSQ, LAYOUT_REG_IMM16, OP_LOADSQ, 2},
+    {NODE_STORESB, LAYOUT_REG_IMM16, OP_STORESB, 2},
+    {NODE_STORESW, LAYOUT_REG_IMM16, OP_STORESW, 2},
+    {NODE_STORESD, LAYOUT_REG_IMM16, OP_STORESD, 2},
+    {NODE_STORESQ, LAYOUT_REG_IMM16, OP_STORESQ, 2},
+    {NODE_AND_IMM, LAYOUT_REG_IMM, OP_AND_IMM, 8},
+    {NODE_OR_IMM, LAYOUT_REG_IMM, OP_OR_IMM, 8},
+    {NODE_XOR_IMM, LAYOUT_REG_IMM, OP_XOR_IMM, 8},
+    {NODE_SHL_IMM, LAYOUT_REG_IMM16, OP_LSHIFT, 1},
+    {NODE_SHR_IMM, LAYOUT_REG_IMM16, OP_RSHIFT, 1},
+    {.node = NODE_CMP_IMM,
+     .layout = LAYOUT_REG_IMM_OR_MEM,
+     .op = OP_CMP_IMM,
+     .mem = {OP_CMP_IMM_MEMB, OP_CMP_IMM_MEMW,
+             OP_CMP_IMM_MEMD, OP_CMP_IMM_MEMQ}},
+    {.node = NODE_LOADB_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_LOADB}},
+    {.node = NODE_LOADW_IMM, .layout = LAYOUT_REG_MEM, .mem = {0, OP_LOADW}},
+    {.node = NODE_LOADD_IMM, .layout = LAYOUT_REG_MEM, .mem = {0, 0, OP_LOADD}},
+    {.node = NODE_LOADQ_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {0, 0, 0, OP_LOADQ}},
+    {.node = NODE_STOREB_IMM, .layout = LAYOUT_REG_MEM, .mem = {OP_STOREB}},
+    {.node = NODE_STOREW_IMM, .layout = LAYOUT_REG_MEM, .mem = {0, OP_STOREW}},
+    {.node = NODE_STORED_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {0, 0, OP_STORED}},
+    {.node = NODE_STOREQ_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {0, 0, 0, OP_STOREQ}},
+    {.node = NODE_ATM_LOADB_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {OP_ATOMIC_LOADB}},
+    {.node = NODE_ATM_LOADW_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {0, OP_ATOMIC_LOADW}},
+    {.node = NODE_ATM_LOADD_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {0, 0, OP_ATOMIC_LOADD}},
+    {.node = NODE_ATM_LOADQ_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {0, 0, 0, OP_ATOMIC_LOADQ}},
+    {.node = NODE_ATM_STOREB_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {OP_ATOMIC_STOREB}},
+    {.node = NODE_ATM_STOREW_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {0, OP_ATOMIC_STOREW}},
+    {.node = NODE_ATM_STORED_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {0, 0, OP_ATOMIC_STORED}},
+    {.node = NODE_ATM_STOREQ_IMM,
+     .layout = LAYOUT_REG_MEM,
+     .mem = {0, 0, 0, OP_ATOMIC_STOREQ}},
+    {NODE_WHDLR, LAYOUT_OP_LABEL64, OP_WHDLR},
+    {NODE_SIN_IMM, LAYOUT_MEM, OP_SIN},
+    {NODE_SOUT_IMM, LAYOUT_MEM, OP_SOUT},
+    {NODE_LOOP, LAYOUT_REG_LABEL, OP_LOOP},
+    {NODE_INT, LAYOUT_INT, OP_INTR, 2},
+    {NODE_LEA, LAYOUT_LEA, OP_LEA},
+    {NODE_CMPXCHG_IMM, LAYOUT_CMPXCHG_MEM, OP_CMPXCHG},
+    {NODE_CMPXCHG_REG, LAYOUT_CMPXCHG_REG, OP_CMPXCHG_REGR},
+};
+
+namespace isa_table {
+struct Table {
+  IsaEntry entries[NODE_COUNT];
+  bool duplicated = false, missing = false;
+};
+
+constexpr Table build() {
+  Table t{};
+  bool seen[NODE_COUNT] = {};
+  for (const IsaEntry &e : isa) {
+    if (seen[e.node])
+      t.duplicated = true;
+    seen[e.node] = true;
+    t.entries[e.node] = e;
+  }
+  for (size_t i = 0; i < NODE_COUNT; i++)
+    if (!seen[i])
+      t.missing = true;
+  return t;
+}
+
+constexpr Table table = build();
+
+static_assert(!table.duplicated, "A node has more than one ISA entry");
+static_assert(!table.missing, "Every node needs an ISA entry");
+}; // namespace isa_table
+}; // namespace masm
+
+const masm::IsaEntry &masm::isa_entry(node_t node) {
+  return isa_table::table.entries[node];
+}
+
+uint32_t masm::encoded_length(Node &n) {
+  const IsaEntry &e = isa_entry(n.type);
+  bool is_var = false;
+  if (e.layout == LAYOUT_IMM_OR_MEM)
+    is_var = ((NodeImm *)&n.node)->is_var;
+  else if (e.layout == LAYOUT_REG_IMM_OR_MEM)
+    is_var = ((NodeRegrImm *)&n.node)->is_var;
+  return e.length(is_var);
+}
+
+bool masm::shorten_immediate(Node &n) {
+  // Only mov has a choice: the sign extending moves carry the immediate in
+  // the instruction itself and load the same value when it fits. There is
+  // no zero extending form so e.g. 0xFFFFFFFF still takes two qwords.
+  if (n.type != NODE_MOV)
+    return false;
+  NodeRegrImm *imm = (NodeRegrImm *)&n.node;
+  if (imm->is_var || imm->lit.is_float)
+    return false;
+  switch (imm->type) {
+  case VALUE_HEX:
+  case VALUE_OCTAL:
+  case VALUE_BINARY:
+  case VALUE_INTEGER:
+    break;
+  default:
+    return false;
+  }
+  int64_t v = (int64_t)imm->lit.u;
+  if (v == (int8_t)v)
+    n.type = NODE_MOVSXB_IMM;
+  else if (v == (int16_t)v)
+    n.type = NODE_MOVSXW_IMM;
+  else if (v == (int32_t)v)
+    n.type = NODE_MOVSXD_IMM;
+  else
+    return false;
+  n.len = encoded_length(n);
+  return true;
+}
+
+uint32_t masm::operand_symbol(Node &n) {
+  switch (isa_entry(n.type).layout) {
+  case LAYOUT_LABEL:
+  case LAYOUT_OP_LABEL64:
+  case LAYOUT_MEM:
+    return ((NodeImm *)&n.node)->name;
+  case LAYOUT_IMM_OR_MEM: {
+    NodeImm *imm = (NodeImm *)&n.node;
+    return imm->is_var ? imm->name : NO_ID;
+  }
+  case LAYOUT_REG_IMM_OR_MEM: {
+    NodeRegrImm *imm = (NodeRegrImm *)&n.node;
+    return imm->is_var ? imm->name : NO_ID;
+  }
+  case LAYOUT_REG_MEM:
+  case LAYOUT_REG_LABEL:
+    return ((NodeRegrImm *)&n.node)->name;
+  case LAYOUT_CMPXCHG_MEM:
+    return ((NodeCMPXCHGImm *)&n.node)->name;
+  default:
+    return NO_ID;
+  }
+}
+
+uint64_t masm::variable_size(Node &n) {
+  NodeDB *d = (NodeDB *)&n.node;
+  switch (n.type) {
+  case NODE_DB:
+    return 1;
+  case NODE_DW:
+    return 2;
+  case NODE_DD:
+  case NODE_DF:
+    return 4;
+  case NODE_DQ:
+  case NODE_DP:
+  case NODE_DLF:
+    return 8;
+  case NODE_DS:
+    return d->value.length();
+  case NODE_RESB:
+    return d->lit.u;
+  case NODE_RESW:
+    return 2 * d->lit.u;
+  case NODE_RESD:
+  case NODE_RESF:
+    return 4 * d->lit.u;
+  case NODE_RESQ:
+  case NODE_RESP:
+  case NODE_RESLF:
+    return 8 * d->lit.u;
+  default:
+    return 0;
+  }
+}
@@ -0,0 +1,181 @@
+#include <gpc_cfg.hpp>
+#include <gpc_gen_base.hpp>
+#include <gpc_jump_threading.hpp>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace masm {
+namespace jump_threading {
+// The conditional jumps and the ones taken exactly when they are not.
+// jge and jse aren't opposites(both are taken on equal) so they are left
+// alone.
+static const node_t opposites[][2] = {
+    {NODE_JNZ, NODE_JZ}, {NODE_JNE, NODE_JE}, {NODE_JNC, NODE_JC},
+    {NODE_JNO, NODE_JO}, {NODE_JNN, NODE_JN}, {NODE_JNG, NODE_JG},
+    {NODE_JNS, NODE_JS},
+};
+
+static node_t opposite(node_t t) {
+  for (auto &pair : opposites) {
+    if (pair[0] == t)
+      return pair[1];
+    if (pair[1] == t)
+      return pair[0];
+  }
+  return NODE_COUNT;
+}
+
+// The next instruction after 'at'(nodes.size() if none)
+static size_t next_instruction(NodeList &nodes, size_t at) {
+  for (at++; at < nodes.size(); at++) {
+    if (isa_entry(nodes[at].type).layout != LAYOUT_NO_CODE)
+      break;
+  }
+  return at;
+}
+
+// Where the jumps and calls to a label refer to
+static uint32_t *target_of(Node &n) {
+  if (n.type == NODE_LOOP)
+    return &((NodeRegrImm *)&n.node)->name;
+  if (n.type == NODE_JMP_IMM || n.type == NODE_CALL_IMM ||
+      (n.type >= NODE_JNZ && n.type <= NODE_JSE))
+    return &((NodeImm *)&n.node)->name;
+  return nullptr;
+}
+
+// Jumps and calls to a jmp go where it goes
+static size_t retarget(NodeList &nodes) {
+  std::unordered_map<uint32_t, size_t> label_at;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (nodes[i].type == NODE_LABEL)
+      label_at[((NodeLabel *)&nodes[i].node)->name] = i;
+  }
+  size_t retargeted = 0;
+  for (Node &n : nodes) {
+    uint32_t *target = target_of(n);
+    if (!target)
+      continue;
+    // 'seen' keeps a loop of jmps from going around forever
+    std::unordered_set<uint32_t> seen{*target};
+    uint32_t to = *target;
+    for (;;) {
+      auto at = label_at.find(to);
+      if (at == label_at.end())
+        break;
+      size_t next = next_instruction(nodes, at->second);
+      if (next == nodes.size() || nodes[next].type != NODE_JMP_IMM)
+        break;
+      uint32_t further = *target_of(nodes[next]);
+      if (!seen.insert(further).second)
+        break;
+      to = further;
+    }
+    if (to != *target) {
+      *target = to;
+      retargeted++;
+    }
+  }
+  return retargeted;
+}
+
+// jX A; jmp B; A: becomes jnX B; A:
+static size_t fold(NodeList &nodes) {
+  size_t folded = 0;
+  std::vector<bool> dropped(nodes.size(), false);
+  for (size_t i = 0; i < nodes.size(); i++) {
+    node_t inverse = opposite(nodes[i].type);
+    if (inverse == NODE_COUNT)
+      continue;
+    size_t jmp = next_instruction(nodes, i);
+    if (jmp == nodes.size() || nodes[jmp].type != NODE_JMP_IMM)
+      continue;
+    // The jmp may be a target itself
+    bool labelled = false;
+    for (size_t k = i + 1; k < jmp; k++)
+      labelled |= nodes[k].type == NODE_LABEL;
+    if (labelled)
+      continue;
+    uint32_t over = *target_of(nodes[i]);
+    bool lands = false;
+    for (size_t k = jmp + 1; k < next_instruction(nodes, jmp); k++)
+      lands |= nodes[k].type == NODE_LABEL &&
+               ((NodeLabel *)&nodes[k].node)->name == over;
+    if (!lands)
+      continue;
+    nodes[i].type = inverse;
+    *target_of(nodes[i]) = *target_of(nodes[jmp]);
+    dropped[jmp] = true;
+    folded++;
+    i = jmp;
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (!dropped[i])
+      nodes[kept++] = nodes[i];
+  }
+  nodes.erase(nodes.begin() + kept, nodes.end());
+  return folded;
+}
+
+// The instructions in blocks that control can no longer get to. Their
+// labels and the variables among them stay.
+static size_t remove_unreachable(NodeList &nodes, SymbolTable &symtable) {
+  CFG cfg(nodes, symtable);
+  std::vector<bool> reached(cfg.blocks.size(), false);
+  std::vector<size_t> work;
+  for (size_t b = 0; b < cfg.blocks.size(); b++) {
+    if (cfg.blocks[b].entry) {
+      reached[b] = true;
+      work.push_back(b);
+    }
+  }
+  while (!work.empty()) {
+    size_t b = work.back();
+    work.pop_back();
+    for (size_t s : cfg.blocks[b].succ) {
+      if (!reached[s]) {
+        reached[s] = true;
+        work.push_back(s);
+      }
+    }
+  }
+  std::vector<bool> dropped(nodes.size(), false);
+  size_t removed = 0;
+  for (size_t b = 0; b < cfg.blocks.size(); b++) {
+    if (reached[b])
+      continue;
+    for (size_t i = cfg.blocks[b].begin; i < cfg.blocks[b].end; i++) {
+      if (isa_entry(nodes[i].type).layout == LAYOUT_NO_CODE)
+        continue;
+      dropped[i] = true;
+      removed++;
+    }
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (!dropped[i])
+      nodes[kept++] = nodes[i];
+  }
+  nodes.erase(nodes.begin() + kept, nodes.end());
+  return removed;
+}
+}; // namespace jump_threading
+}; // namespace masm
+
+void masm::thread_jumps(NodeList &nodes, SymbolTable &symtable,
+                        GenStats &stats) {
+  using namespace jump_threading;
+  // Folding and removing code puts jumps next to others so this goes
+  // until nothing changes
+  bool changed = true;
+  while (changed) {
+    size_t retargeted = retarget(nodes);
+    size_t folded = fold(nodes);
+    size_t removed = remove_unreachable(nodes, symtable);
+    stats.jumps_retargeted += retargeted;
+    stats.jumps_folded += folded;
+    stats.unreachable_removed += removed;
+    changed = retargeted || folded || removed;
+  }
+}
@@ -1,697 +1,303 @@
+#include <array>
 #include <gpc_parser.hpp>
 
-masm::GPCParser::GPCParser(std::string path) { file = path; }
+namespace masm {
+// What follows the first token of a statement. Decides which handle_* builds
+// the node.
+enum shape_t {
+  SHAPE_INVALID, // nothing can start with this token
+  SHAPE_ERROR,   // the lexer already complained
+  SHAPE_INCLUDE,
+  SHAPE_DEFINE,
+  SHAPE_DEFINITION, // variable or label
+  SHAPE_NONE,       // instructions without operands
+  SHAPE_REG,
+  SHAPE_IMM,
+  SHAPE_REG_REG,
+  SHAPE_REG_IMM,
+  SHAPE_IMM_OR_REG,
+  SHAPE_REG_REG_OR_REG_IMM,
+  SHAPE_LEA,
+  SHAPE_CMPXCHG,
+  SHAPE_ATM,
+};
+
+struct Dispatch {
+  token_t token;
+  shape_t shape;
+  node_t node = INCLUDE_DIR; // only for the instruction shapes
+};
+
+// Adding an instruction with one of the existing shapes is an entry here.
+// For the shapes that may take either a register or an immediate the node
+// is the immediate variant; the register variant is the one after it.
+static constexpr Dispatch statements[] = {
+    {TOKEN_ERROR, SHAPE_ERROR},
+    {TOKEN_INCLUDE, SHAPE_INCLUDE},
+    {TOKEN_DEFINE, SHAPE_DEFINE},
+    {TOKEN_IDENTIFIER, SHAPE_DEFINITION},
+    {TOKEN_NOP, SHAPE_NONE, NODE_NOP},
+    {TOKEN_HALT, SHAPE_NONE, NODE_HALT},
+    {TOKEN_RET, SHAPE_NONE, NODE_RET},
+    {TOKEN_RETNZ, SHAPE_NONE, NODE_RETNZ},
+    {TOKEN_RETZ, SHAPE_NONE, NODE_RETZ},
+    {TOKEN_RETNE, SHAPE_NONE, NODE_RETNE},
+    {TOKEN_RETE, SHAPE_NONE, NODE_RETE},
+    {TOKEN_RETNC, SHAPE_NONE, NODE_RETNC},
+    {TOKEN_RETC, SHAPE_NONE, NODE_RETC},
+    {TOKEN_RETNO, SHAPE_NONE, NODE_RETNO},
+    {TOKEN_RETO, SHAPE_NONE, NODE_RETO},
+    {TOKEN_RETN, SHAPE_NONE, NODE_RETN},
+    {TOKEN_RETNN, SHAPE_NONE, NODE_RETNN},
+    {TOKEN_RETNG, SHAPE_NONE, NODE_RETNG},
+    {TOKEN_RETG, SHAPE_NONE, NODE_RETG},
+    {TOKEN_RETNS, SHAPE_NONE, NODE_RETNS},
+    {TOKEN_RETS, SHAPE_NONE, NODE_RETS},
+    {TOKEN_RETGE, SHAPE_NONE, NODE_RETGE},
+    {TOKEN_RETSE, SHAPE_NONE, NODE_RETSE},
+    {TOKEN_PUSHA, SHAPE_NONE, NODE_PUSHA},
+    {TOKEN_POPA, SHAPE_NONE, NODE_POPA},
+    {TOKEN_OUTR, SHAPE_NONE, NODE_OUTR},
+    {TOKEN_UOUTR, SHAPE_NONE, NODE_UOUTR},
+    {TOKEN_CFLAGS, SHAPE_NONE, NODE_CFLAGS},
+    {TOKEN_RESET, SHAPE_NONE, NODE_RESET},
+    {TOKEN_ADD, SHAPE_REG_REG_OR_REG_IMM, NODE_ADD_IMM},
+    {TOKEN_SUB, SHAPE_REG_REG_OR_REG_IMM, NODE_SUB_IMM},
+    {TOKEN_MUL, SHAPE_REG_REG_OR_REG_IMM, NODE_MUL_IMM},
+    {TOKEN_DIV, SHAPE_REG_REG_OR_REG_IMM, NODE_DIV_IMM},
+    {TOKEN_MOD, SHAPE_REG_REG_OR_REG_IMM, NODE_MOD_IMM},
+    {TOKEN_IADD, SHAPE_REG_REG_OR_REG_IMM, NODE_IADD_IMM},
+    {TOKEN_ISUB, SHAPE_REG_REG_OR_REG_IMM, NODE_ISUB_IMM},
+    {TOKEN_IMUL, SHAPE_REG_REG_OR_REG_IMM, NODE_IMUL_IMM},
+    {TOKEN_IDIV, SHAPE_REG_REG_OR_REG_IMM, NODE_IDIV_IMM},
+    {TOKEN_IMOD, SHAPE_REG_REG_OR_REG_IMM, NODE_IMOD_IMM},
+    {TOKEN_FADD, SHAPE_REG_REG_OR_REG_IMM, NODE_FADD_IMM},
+    {TOKEN_FSUB, SHAPE_REG_REG_OR_REG_IMM, NODE_FSUB_IMM},
+    {TOKEN_FMUL, SHAPE_REG_REG_OR_REG_IMM, NODE_FMUL_IMM},
+    {TOKEN_FDIV, SHAPE_REG_REG_OR_REG_IMM, NODE_FDIV_IMM},
+    {TOKEN_FADD32, SHAPE_REG_REG_OR_REG_IMM, NODE_FADD32_IMM},
+    {TOKEN_FSUB32, SHAPE_REG_REG_OR_REG_IMM, NODE_FSUB32_IMM},
+    {TOKEN_FMUL32, SHAPE_REG_REG_OR_REG_IMM, NODE_FMUL32_IMM},
+    {TOKEN_FDIV32, SHAPE_REG_REG_OR_REG_IMM, NODE_FDIV32_IMM},
+    {TOKEN_AND, SHAPE_REG_REG_OR_REG_IMM, NODE_AND_IMM},
+    {TOKEN_OR, SHAPE_REG_REG_OR_REG_IMM, NODE_OR_IMM},
+    {TOKEN_XOR, SHAPE_REG_REG_OR_REG_IMM, NODE_XOR_IMM},
+    {TOKEN_SHL, SHAPE_REG_REG_OR_REG_IMM, NODE_SHL_IMM},
+    {TOKEN_SHR, SHAPE_REG_REG_OR_REG_IMM, NODE_SHR_IMM},
+    {TOKEN_CMP, SHAPE_REG_REG_OR_REG_IMM, NODE_CMP_IMM},
+    {TOKEN_INC, SHAPE_REG, NODE_INC},
+    {TOKEN_DEC, SHAPE_REG, NODE_DEC},
+    {TOKEN_NOT, SHAPE_REG, NODE_NOT},
+    {TOKEN_MOV, SHAPE_REG_IMM, NODE_MOV},
+    {TOKEN_MOVB, SHAPE_REG_REG, NODE_MOVB},
+    {TOKEN_MOVW, SHAPE_REG_REG, NODE_MOVW},
+    {TOKEN_MOVD, SHAPE_REG_REG, NODE_MOVD},
+    {TOKEN_MOVQ, SHAPE_REG_REG, NODE_MOVQ},
+    {TOKEN_MOVF, SHAPE_REG_IMM, NODE_MOVF},
+    {TOKEN_MOVF32, SHAPE_REG_IMM, NODE_MOVF32},
+    {TOKEN_MOVSXB, SHAPE_REG_REG_OR_REG_IMM, NODE_MOVSXB_IMM},
+    {TOKEN_MOVSXW, SHAPE_REG_REG_OR_REG_IMM, NODE_MOVSXW_IMM},
+    {TOKEN_MOVSXD, SHAPE_REG_REG_OR_REG_IMM, NODE_MOVSXD_IMM},
+    {TOKEN_EXCGB, SHAPE_REG_REG, NODE_EXCGB},
+    {TOKEN_EXCGW, SHAPE_REG_REG, NODE_EXCGW},
+    {TOKEN_EXCGD, SHAPE_REG_REG, NODE_EXCGD},
+    {TOKEN_EXCGQ, SHAPE_REG_REG, NODE_EXCGQ},
+    {TOKEN_MOVEB, SHAPE_REG_REG, NODE_MOVEB},
+    {TOKEN_MOVEW, SHAPE_REG_REG, NODE_MOVEW},
+    {TOKEN_MOVED, SHAPE_REG_REG, NODE_MOVED},
+    {TOKEN_MOVEQ, SHAPE_REG_REG, NODE_MOVEQ},
+    {TOKEN_MOVNZ, SHAPE_REG_IMM, NODE_MOVNZ},
+    {TOKEN_MOVZ, SHAPE_REG_IMM, NODE_MOVZ},
+    {TOKEN_MOVNE, SHAPE_REG_IMM, NODE_MOVNE},
+    {TOKEN_MOVE, SHAPE_REG_IMM, NODE_MOVE},
+    {TOKEN_MOVNC, SHAPE_REG_IMM, NODE_MOVNC},
+    {TOKEN_MOVC, SHAPE_REG_IMM, NODE_MOVC},
+    {TOKEN_MOVNO, SHAPE_REG_IMM, NODE_MOVNO},
+    {TOKEN_MOVO, SHAPE_REG_IMM, NODE_MOVO},
+    {TOKEN_MOVNN, SHAPE_REG_IMM, NODE_MOVNN},
+    {TOKEN_MOVN, SHAPE_REG_IMM, NODE_MOVN},
+    {TOKEN_MOVNG, SHAPE_REG_IMM, NODE_MOVNG},
+    {TOKEN_MOVG, SHAPE_REG_IMM, NODE_MOVG},
+    {TOKEN_MOVNS, SHAPE_REG_IMM, NODE_MOVNS},
+    {TOKEN_MOVS, SHAPE_REG_IMM, NODE_MOVS},
+    {TOKEN_MOVGE, SHAPE_REG_IMM, NODE_MOVGE},
+    {TOKEN_MOVSE, SHAPE_REG_IMM, NODE_MOVSE},
+    {TOKEN_JNZ, SHAPE_IMM, NODE_JNZ},
+    {TOKEN_JZ, SHAPE_IMM, NODE_JZ},
+    {TOKEN_JNE, SHAPE_IMM, NODE_JNE},
+    {TOKEN_JE, SHAPE_IMM, NODE_JE},
+    {TOKEN_JNC, SHAPE_IMM, NODE_JNC},
+    {TOKEN_JC, SHAPE_IMM, NODE_JC},
+    {TOKEN_JNO, SHAPE_IMM, NODE_JNO},
+    {TOKEN_JO, SHAPE_IMM, NODE_JO},
+    {TOKEN_JNN, SHAPE_IMM, NODE_JNN},
+    {TOKEN_JN, SHAPE_IMM, NODE_JN},
+    {TOKEN_JNG, SHAPE_IMM, NODE_JNG},
+    {TOKEN_JG, SHAPE_IMM, NODE_JG},
+    {TOKEN_JNS, SHAPE_IMM, NODE_JNS},
+    {TOKEN_JS, SHAPE_IMM, NODE_JS},
+    {TOKEN_JGE, SHAPE_IMM, NODE_JGE},
+    {TOKEN_JSE, SHAPE_IMM, NODE_JSE},
+    {TOKEN_INT, SHAPE_IMM, NODE_INT},
+    {TOKEN_JMP, SHAPE_IMM_OR_REG, NODE_JMP_IMM},
+    {TOKEN_CALL, SHAPE_IMM_OR_REG, NODE_CALL_IMM},
+    {TOKEN_PUSHB, SHAPE_IMM, NODE_PUSHB},
+    {TOKEN_PUSHW, SHAPE_IMM, NODE_PUSHW},
+    {TOKEN_PUSHD, SHAPE_IMM, NODE_PUSHD},
+    {TOKEN_PUSHQ, SHAPE_IMM, NODE_PUSHQ},
+    {TOKEN_PUSH, SHAPE_REG, NODE_PUSH},
+    {TOKEN_POPB, SHAPE_IMM_OR_REG, NODE_POPB_IMM},
+    {TOKEN_POPW, SHAPE_IMM_OR_REG, NODE_POPW_IMM},
+    {TOKEN_POPD, SHAPE_IMM_OR_REG, NODE_POPD_IMM},
+    {TOKEN_POPQ, SHAPE_IMM_OR_REG, NODE_POPQ_IMM},
+    {TOKEN_LOOP, SHAPE_REG_IMM, NODE_LOOP},
+    {TOKEN_LOADSB, SHAPE_REG_IMM, NODE_LOADSB},
+    {TOKEN_LOADSW, SHAPE_REG_IMM, NODE_LOADSW},
+    {TOKEN_LOADSD, SHAPE_REG_IMM, NODE_LOADSD},
+    {TOKEN_LOADSQ, SHAPE_REG_IMM, NODE_LOADSQ},
+    {TOKEN_STORESB, SHAPE_REG_IMM, NODE_STORESB},
+    {TOKEN_STORESW, SHAPE_REG_IMM, NODE_STORESW},
+    {TOKEN_STORESD, SHAPE_REG_IMM, NODE_STORESD},
+    {TOKEN_STORESQ, SHAPE_REG_IMM, NODE_STORESQ},
+    {TOKEN_FCMP, SHAPE_REG_REG, NODE_FCMP},
+    {TOKEN_FCMP32, SHAPE_REG_REG, NODE_FCMP32},
+    {TOKEN_CIN, SHAPE_REG, NODE_CIN},
+    {TOKEN_COUT, SHAPE_REG, NODE_COUT},
+    {TOKEN_SIN, SHAPE_IMM_OR_REG, NODE_SIN_IMM},
+    {TOKEN_SOUT, SHAPE_IMM_OR_REG, NODE_SOUT_IMM},
+    {TOKEN_IN, SHAPE_REG, NODE_IN},
+    {TOKEN_OUT, SHAPE_REG, NODE_OUT},
+    {TOKEN_INW, SHAPE_REG, NODE_INW},
+    {TOKEN_OUTW, SHAPE_REG, NODE_OUTW},
+    {TOKEN_IND, SHAPE_REG, NODE_IND},
+    {TOKEN_OUTD, SHAPE_REG, NODE_OUTD},
+    {TOKEN_INQ, SHAPE_REG, NODE_INQ},
+    {TOKEN_OUTQ, SHAPE_REG, NODE_OUTQ},
+    {TOKEN_UIN, SHAPE_REG, NODE_UIN},
+    {TOKEN_UOUT, SHAPE_REG, NODE_UOUT},
+    {TOKEN_UINW, SHAPE_REG, NODE_UINW},
+    {TOKEN_UOUTW, SHAPE_REG, NODE_UOUTW},
+    {TOKEN_UIND, SHAPE_REG, NODE_UIND},
+    {TOKEN_UOUTD, SHAPE_REG, NODE_UOUTD},
+    {TOKEN_UINQ, SHAPE_REG, NODE_UINQ},
+    {TOKEN_UOUTQ, SHAPE_REG, NODE_UOUTQ},
+    {TOKEN_INF, SHAPE_REG, NODE_INF},
+    {TOKEN_OUTF, SHAPE_REG, NODE_OUTF},
+    {TOKEN_INF32, SHAPE_REG, NODE_INF32},
+    {TOKEN_OUTF32, SHAPE_REG, NODE_OUTF32},
+    {TOKEN_LOADB, SHAPE_REG_REG_OR_REG_IMM, NODE_LOADB_IMM},
+    {TOKEN_LOADW, SHAPE_REG_REG_OR_REG_IMM, NODE_LOADW_IMM},
+    {TOKEN_LOADD, SHAPE_REG_REG_OR_REG_IMM, NODE_LOADD_IMM},
+    {TOKEN_LOADQ, SHAPE_REG_REG_OR_REG_IMM, NODE_LOADQ_IMM},
+    {TOKEN_STOREB, SHAPE_REG_REG_OR_REG_IMM, NODE_STOREB_IMM},
+    {TOKEN_STOREW, SHAPE_REG_REG_OR_REG_IMM, NODE_STOREW_IMM},
+    {TOKEN_STORED, SHAPE_REG_REG_OR_REG_IMM, NODE_STORED_IMM},
+    {TOKEN_STOREQ, SHAPE_REG_REG_OR_REG_IMM, NODE_STOREQ_IMM},
+    {TOKEN_WHDLR, SHAPE_IMM, NODE_WHDLR},
+    {TOKEN_LEA, SHAPE_LEA},
+    {TOKEN_CMPXCHG, SHAPE_CMPXCHG},
+    {TOKEN_ATM, SHAPE_ATM},
+};
+
+// The statements indexed by token so that dispatching is a single load.
+namespace dispatch {
+struct Table {
+  std::array<Dispatch, TOKEN_COUNT> entries{};
+  bool duplicated = false;
+};
+
+constexpr Table build() {
+  Table t;
+  for (size_t i = 0; i < TOKEN_COUNT; i++)
+    t.entries[i] = {(token_t)i, SHAPE_INVALID};
+  for (const Dispatch &d : statements) {
+    if (t.entries[d.token].shape != SHAPE_INVALID)
+      t.duplicated = true;
+    t.entries[d.token] = d;
+  }
+  return t;
+}
 
-bool masm::GPCParser::parse() {
-  bool lex_res = true;
-  Lexer lexer(file.string(), &lex_res);
+constexpr Table table = build();
+
+static_assert(!table.duplicated, "A token has more than one statement entry");
+}; // namespace dispatch
+}; // namespace masm
+
+masm::GPCParser::GPCParser(SourceFile &source, SymbolTable &table,
+                           Arena &arena)
+    : nodes(ArenaAllocator<Node>(arena)), src(source), symtable(table) {
+  file = src.get_path();
+}
 
-  if (!lex_res)
+bool masm::GPCParser::parse() {
+  Lexer lexer(src, symtable.get_interner());
+  if (!lexer.tokenize(tokens))
     return false;
+  // Roughly three tokens per node on average
+  nodes.reserve(tokens.size() / 3 + 1);
 
-  Token curr = lexer.next_token();
+  Token curr = tokens.next_token();
   while (curr.type != TOKEN_EOF) {
-    switch (curr.type) {
-    case TOKEN_ERROR:
+    const Dispatch &d = dispatch::table.entries[curr.type];
+    bool ok = false;
+    switch (d.shape) {
+    case SHAPE_INVALID:
+      detailed_message(file.c_str(), curr.line,
+                       "Cannot build a node from this.", NULL);
       return false;
-    case TOKEN_INCLUDE:
-      if (!handle_include_directory(lexer))
-        return false;
-      break;
-    case TOKEN_DEFINE:
-      if (!handle_const_definition(lexer))
-        return false;
-      break;
-    case TOKEN_IDENTIFIER:
-      if (!handle_variable_defn(lexer, curr))
-        return false;
-      break;
-    case TOKEN_NOP:
-      handle_simple_instructions(NODE_NOP);
-      break;
-    case TOKEN_HALT:
-      handle_simple_instructions(NODE_HALT);
-      break;
-    case TOKEN_RET:
-      handle_simple_instructions(NODE_RET);
-      break;
-    case TOKEN_RETNZ:
-      handle_simple_instructions(NODE_RETNZ);
-      break;
-    case TOKEN_RETZ:
-      handle_simple_instructions(NODE_RETZ);
-      break;
-    case TOKEN_RETNE:
-      handle_simple_instructions(NODE_RETNE);
-      break;
-    case TOKEN_RETE:
-      handle_simple_instructions(NODE_RETE);
-      break;
-    case TOKEN_RETNC:
-      handle_simple_instructions(NODE_RETNC);
-      break;
-    case TOKEN_RETC:
-      handle_simple_instructions(NODE_RETC);
-      break;
-    case TOKEN_RETNO:
-      handle_simple_instructions(NODE_RETNO);
-      break;
-    case TOKEN_RETO:
-      handle_simple_instructions(NODE_RETO);
-      break;
-    case TOKEN_RETN:
-      handle_simple_instructions(NODE_RETN);
-      break;
-    case TOKEN_RETNN:
-      handle_simple_instructions(NODE_RETNN);
-      break;
-    case TOKEN_RETNG:
-      handle_simple_instructions(NODE_RETNG);
-      break;
-    case TOKEN_RETG:
-      handle_simple_instructions(NODE_RETG);
-      break;
-    case TOKEN_RETNS:
-      handle_simple_instructions(NODE_RETNS);
-      break;
-    case TOKEN_RETS:
-      handle_simple_instructions(NODE_RETS);
-      break;
-    case TOKEN_RETGE:
-      handle_simple_instructions(NODE_RETGE);
-      break;
-    case TOKEN_RETSE:
-      handle_simple_instructions(NODE_RETSE);
-      break;
-    case TOKEN_PUSHA:
-      handle_simple_instructions(NODE_PUSHA);
-      break;
-    case TOKEN_POPA:
-      handle_simple_instructions(NODE_POPA);
-      break;
-    case TOKEN_OUTR:
-      handle_simple_instructions(NODE_OUTR);
-      break;
-    case TOKEN_UOUTR:
-      handle_simple_instructions(NODE_UOUTR);
-      break;
-    case TOKEN_CFLAGS:
-      handle_simple_instructions(NODE_CFLAGS);
-      break;
-    case TOKEN_RESET:
-      handle_simple_instructions(NODE_RESET);
-      break;
-    case TOKEN_ADD:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_ADD_IMM))
-        return false;
-      break;
-    case TOKEN_SUB:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_SUB_IMM))
-        return false;
-      break;
-    case TOKEN_MUL:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_MUL_IMM))
-        return false;
-      break;
-    case TOKEN_DIV:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_DIV_IMM))
-        return false;
-      break;
-    case TOKEN_MOD:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_MOD_IMM))
-        return false;
-      break;
-    case TOKEN_IADD:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_IADD_IMM))
-        return false;
-      break;
-    case TOKEN_ISUB:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_ISUB_IMM))
-        return false;
-      break;
-    case TOKEN_IMUL:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_IMUL_IMM))
-        return false;
-      break;
-    case TOKEN_IDIV:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_IDIV_IMM))
-        return false;
-      break;
-    case TOKEN_IMOD:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_IMOD_IMM))
-        return false;
-      break;
-    case TOKEN_FADD:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_FADD_IMM))
-        return false;
-      break;
-    case TOKEN_FSUB:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_FSUB_IMM))
-        return false;
-      break;
-    case TOKEN_FMUL:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_FMUL_IMM))
-        return false;
-      break;
-    case TOKEN_FDIV:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_FDIV_IMM))
-        return false;
-      break;
-    case TOKEN_FADD32:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_FADD32_IMM))
-        return false;
-      break;
-    case TOKEN_FSUB32:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_FSUB32_IMM))
-        return false;
-      break;
-    case TOKEN_FMUL32:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_FMUL32_IMM))
-        return false;
-      break;
-    case TOKEN_FDIV32:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_FDIV32_IMM))
-        return false;
-      break;
-    case TOKEN_AND:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_AND_IMM))
-        return false;
-      break;
-    case TOKEN_OR:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_OR_IMM))
-        return false;
-      break;
-    case TOKEN_XOR:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_XOR_IMM))
-        return false;
-      break;
-    case TOKEN_SHL:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_SHL_IMM))
-        return false;
-      break;
-    case TOKEN_SHR:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_SHR_IMM))
-        return false;
-      break;
-    case TOKEN_CMP:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_CMP_IMM))
-        return false;
-      break;
-    case TOKEN_INC:
-      if (!handle_instructions_with_reg(lexer, NODE_INC))
-        return false;
-      break;
-    case TOKEN_DEC:
-      if (!handle_instructions_with_reg(lexer, NODE_DEC))
-        return false;
-      break;
-    case TOKEN_NOT:
-      if (!handle_instructions_with_reg(lexer, NODE_NOT))
-        return false;
-      break;
-    case TOKEN_MOV:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOV))
-        return false;
-      break;
-    case TOKEN_MOVB:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_MOVB))
-        return false;
-      break;
-    case TOKEN_MOVW:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_MOVW))
-        return false;
-      break;
-    case TOKEN_MOVD:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_MOVD))
-        return false;
-      break;
-    case TOKEN_MOVQ:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_MOVQ))
-        return false;
-      break;
-    case TOKEN_MOVF:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVF))
-        return false;
-      break;
-    case TOKEN_MOVF32:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVF32))
-        return false;
-      break;
-    case TOKEN_MOVSXB:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_MOVSXB_IMM))
-        return false;
-      break;
-    case TOKEN_MOVSXW:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_MOVSXW_IMM))
-        return false;
-      break;
-    case TOKEN_MOVSXD:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_MOVSXD_IMM))
-        return false;
-      break;
-    case TOKEN_EXCGB:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_EXCGB))
-        return false;
-      break;
-    case TOKEN_EXCGW:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_EXCGW))
-        return false;
-      break;
-    case TOKEN_EXCGD:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_EXCGD))
-        return false;
-      break;
-    case TOKEN_EXCGQ:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_EXCGQ))
-        return false;
-      break;
-    case TOKEN_MOVEB:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_MOVEB))
-        return false;
-      break;
-    case TOKEN_MOVEW:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_MOVEW))
-        return false;
-      break;
-    case TOKEN_MOVED:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_MOVED))
-        return false;
-      break;
-    case TOKEN_MOVEQ:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_MOVEQ))
-        return false;
-      break;
-    case TOKEN_MOVNZ:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVNZ))
-        return false;
-      break;
-    case TOKEN_MOVZ:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVZ))
-        return false;
-      break;
-    case TOKEN_MOVNE:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVNE))
-        return false;
-      break;
-    case TOKEN_MOVE:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVE))
-        return false;
-      break;
-    case TOKEN_MOVNC:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVNC))
-        return false;
-      break;
-    case TOKEN_MOVC:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVC))
-        return false;
-      break;
-    case TOKEN_MOVNO:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVNO))
-        return false;
-      break;
-    case TOKEN_MOVO:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVO))
-        return false;
-      break;
-    case TOKEN_MOVNN:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVNN))
-        return false;
-      break;
-    case TOKEN_MOVN:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVN))
-        return false;
-      break;
-    case TOKEN_MOVNG:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVNG))
-        return false;
-      break;
-    case TOKEN_MOVG:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVG))
-        return false;
-      break;
-    case TOKEN_MOVNS:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVNS))
-        return false;
-      break;
-    case TOKEN_MOVS:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVS))
-        return false;
-      break;
-    case TOKEN_MOVGE:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVGE))
-        return false;
-      break;
-    case TOKEN_MOVSE:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_MOVSE))
-        return false;
-      break;
-    case TOKEN_JNZ:
-      if (!handle_instructions_with_imm(lexer, NODE_JNZ))
-        return false;
-      break;
-    case TOKEN_JZ:
-      if (!handle_instructions_with_imm(lexer, NODE_JZ))
-        return false;
-      break;
-    case TOKEN_JNE:
-      if (!handle_instructions_with_imm(lexer, NODE_JNE))
-        return false;
-      break;
-    case TOKEN_JE:
-      if (!handle_instructions_with_imm(lexer, NODE_JE))
-        return false;
-      break;
-    case TOKEN_JNC:
-      if (!handle_instructions_with_imm(lexer, NODE_JNC))
-        return false;
-      break;
-    case TOKEN_JC:
-      if (!handle_instructions_with_imm(lexer, NODE_JC))
-        return false;
-      break;
-    case TOKEN_JNO:
-      if (!handle_instructions_with_imm(lexer, NODE_JNO))
-        return false;
-      break;
-    case TOKEN_JO:
-      if (!handle_instructions_with_imm(lexer, NODE_JO))
-        return false;
-      break;
-    case TOKEN_JNN:
-      if (!handle_instructions_with_imm(lexer, NODE_JNN))
-        return false;
-      break;
-    case TOKEN_JN:
-      if (!handle_instructions_with_imm(lexer, NODE_JN))
-        return false;
-      break;
-    case TOKEN_JNG:
-      if (!handle_instructions_with_imm(lexer, NODE_JNG))
-        return false;
-      break;
-    case TOKEN_JG:
-      if (!handle_instructions_with_imm(lexer, NODE_JG))
-        return false;
-      break;
-    case TOKEN_JNS:
-      if (!handle_instructions_with_imm(lexer, NODE_JNS))
-        return false;
-      break;
-    case TOKEN_JS:
-      if (!handle_instructions_with_imm(lexer, NODE_JS))
-        return false;
-      break;
-    case TOKEN_JGE:
-      if (!handle_instructions_with_imm(lexer, NODE_JGE))
-        return false;
-      break;
-    case TOKEN_JSE:
-      if (!handle_instructions_with_imm(lexer, NODE_JSE))
-        return false;
-      break;
-    case TOKEN_INT:
-      if (!handle_instructions_with_imm(lexer, NODE_INT))
-        return false;
-      break;
-    case TOKEN_JMP:
-      if (!handle_instructions_with_imm_or_reg(lexer, NODE_JMP_IMM))
-        return false;
-      break;
-    case TOKEN_CALL:
-      if (!handle_instructions_with_imm_or_reg(lexer, NODE_CALL_IMM))
-        return false;
-      break;
-    case TOKEN_PUSHB:
-      if (!handle_instructions_with_imm(lexer, NODE_PUSHB))
-        return false;
-      break;
-    case TOKEN_PUSHW:
-      if (!handle_instructions_with_imm(lexer, NODE_PUSHW))
-        return false;
-      break;
-    case TOKEN_PUSHD:
-      if (!handle_instructions_with_imm(lexer, NODE_PUSHD))
-        return false;
-      break;
-    case TOKEN_PUSHQ:
-      if (!handle_instructions_with_imm(lexer, NODE_PUSHQ))
-        return false;
-      break;
-    case TOKEN_PUSH:
-      if (!handle_instructions_with_reg(lexer, NODE_PUSH))
-        return false;
-      break;
-    case TOKEN_POPB:
-      if (!handle_instructions_with_imm_or_reg(lexer, NODE_POPB_IMM))
-        return false;
-      break;
-    case TOKEN_POPW:
-      if (!handle_instructions_with_imm_or_reg(lexer, NODE_POPW_IMM))
-        return false;
-      break;
-    case TOKEN_POPD:
-      if (!handle_instructions_with_imm_or_reg(lexer, NODE_POPD_IMM))
-        return false;
-      break;
-    case TOKEN_POPQ:
-      if (!handle_instructions_with_imm_or_reg(lexer, NODE_POPQ_IMM))
-        return false;
-      break;
-    case TOKEN_LOOP:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_LOOP))
-        return false;
-      break;
-    case TOKEN_LOADSB:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_LOADSB))
-        return false;
-      break;
-    case TOKEN_LOADSW:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_LOADSW))
-        return false;
-      break;
-    case TOKEN_LOADSD:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_LOADSD))
-        return false;
-      break;
-    case TOKEN_LOADSQ:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_LOADSQ))
-        return false;
-      break;
-    case TOKEN_STORESB:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_STORESB))
-        return false;
-      break;
-    case TOKEN_STORESW:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_STORESW))
-        return false;
-      break;
-    case TOKEN_STORESD:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_STORESD))
-        return false;
-      break;
-    case TOKEN_STORESQ:
-      if (!handle_instructions_with_reg_imm(lexer, NODE_STORESQ))
-        return false;
-      break;
-    case TOKEN_FCMP:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_FCMP))
-        return false;
-      break;
-    case TOKEN_FCMP32:
-      if (!handle_instructions_with_reg_reg(lexer, NODE_FCMP32))
-        return false;
-      break;
-    case TOKEN_CIN:
-      if (!handle_instructions_with_reg(lexer, NODE_CIN))
-        return false;
-      break;
-    case TOKEN_COUT:
-      if (!handle_instructions_with_reg(lexer, NODE_COUT))
-        return false;
-      break;
-    case TOKEN_SIN:
-      if (!handle_instructions_with_imm_or_reg(lexer, NODE_SIN_IMM))
-        return false;
-      break;
-    case TOKEN_SOUT:
-      if (!handle_instructions_with_imm_or_reg(lexer, NODE_SOUT_IMM))
-        return false;
-      break;
-    case TOKEN_IN:
-      if (!handle_instructions_with_reg(lexer, NODE_IN))
-        return false;
-      break;
-    case TOKEN_OUT:
-      if (!handle_instructions_with_reg(lexer, NODE_OUT))
-        return false;
-      break;
-    case TOKEN_INW:
-      if (!handle_instructions_with_reg(lexer, NODE_INW))
-        return false;
-      break;
-    case TOKEN_OUTW:
-      if (!handle_instructions_with_reg(lexer, NODE_OUTW))
-        return false;
-      break;
-    case TOKEN_IND:
-      if (!handle_instructions_with_reg(lexer, NODE_IND))
-        return false;
-      break;
-    case TOKEN_OUTD:
-      if (!handle_instructions_with_reg(lexer, NODE_OUTD))
-        return false;
-      break;
-    case TOKEN_INQ:
-      if (!handle_instructions_with_reg(lexer, NODE_INQ))
-        return false;
-      break;
-    case TOKEN_OUTQ:
-      if (!handle_instructions_with_reg(lexer, NODE_OUTQ))
-        return false;
-      break;
-    case TOKEN_UIN:
-      if (!handle_instructions_with_reg(lexer, NODE_UIN))
-        return false;
-      break;
-    case TOKEN_UOUT:
-      if (!handle_instructions_with_reg(lexer, NODE_UOUT))
-        return false;
-      break;
-    case TOKEN_UINW:
-      if (!handle_instructions_with_reg(lexer, NODE_UINW))
-        return false;
-      break;
-    case TOKEN_UOUTW:
-      if (!handle_instructions_with_reg(lexer, NODE_UOUTW))
-        return false;
-      break;
-    case TOKEN_UIND:
-      if (!handle_instructions_with_reg(lexer, NODE_UIND))
-        return false;
-      break;
-    case TOKEN_UOUTD:
-      if (!handle_instructions_with_reg(lexer, NODE_UOUTD))
-        return false;
-      break;
-    case TOKEN_UINQ:
-      if (!handle_instructions_with_reg(lexer, NODE_UINQ))
-        return false;
-      break;
-    case TOKEN_UOUTQ:
-      if (!handle_instructions_with_reg(lexer, NODE_UOUTQ))
-        return false;
-      break;
-    case TOKEN_INF:
-      if (!handle_instructions_with_reg(lexer, NODE_INF))
-        return false;
-      break;
-    case TOKEN_OUTF:
-      if (!handle_instructions_with_reg(lexer, NODE_OUTF))
-        return false;
-      break;
-    case TOKEN_INF32:
-      if (!handle_instructions_with_reg(lexer, NODE_INF32))
-        return false;
-      break;
-    case TOKEN_OUTF32:
-      if (!handle_instructions_with_reg(lexer, NODE_OUTF32))
-        return false;
+    case SHAPE_ERROR:
+      return false;
+    case SHAPE_INCLUDE:
+      ok = handle_include_directory(tokens);
       break;
-    case TOKEN_LOADB:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_LOADB_IMM))
-        return false;
+    case SHAPE_DEFINE:
+      ok = handle_const_definition(tokens);
       break;
-    case TOKEN_LOADW:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_LOADW_IMM))
-        return false;
+    case SHAPE_DEFINITION:
+      ok = handle_variable_defn(tokens, curr);
       break;
-    case TOKEN_LOADD:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_LOADD_IMM))
-        return false;
+    case SHAPE_NONE:
+      ok = handle_simple_instructions(curr, d.node);
       break;
-    case TOKEN_LOADQ:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_LOADQ_IMM))
-        return false;
+    case SHAPE_REG:
+      ok = handle_instructions_with_reg(tokens, d.node);
       break;
-    case TOKEN_STOREB:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_STOREB_IMM))
-        return false;
+    case SHAPE_IMM:
+      ok = handle_instructions_with_imm(tokens, d.node);
       break;
-    case TOKEN_STOREW:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_STOREW_IMM))
-        return false;
+    case SHAPE_REG_REG:
+      ok = handle_instructions_with_reg_reg(tokens, d.node);
       break;
-    case TOKEN_STORED:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_STORED_IMM))
-        return false;
+    case SHAPE_REG_IMM:
+      ok = handle_instructions_with_reg_imm(tokens, d.node);
       break;
-    case TOKEN_STOREQ:
-      if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
-                                                       NODE_STOREQ_IMM))
-        return false;
+    case SHAPE_IMM_OR_REG:
+      ok = handle_instructions_with_imm_or_reg(tokens, d.node);
       break;
-    case TOKEN_WHDLR:
-      if (!handle_instructions_with_imm(lexer, NODE_WHDLR))
-        return false;
+    case SHAPE_REG_REG_OR_REG_IMM:
+      ok = handle_instructions_with_reg_reg_or_reg_imm(tokens, curr, d.node);
       break;
-    case TOKEN_ATM:
-      if (!handle_atm_inst(lexer))
-        return false;
+    case SHAPE_LEA:
+      ok = handle_lea(tokens);
       break;
-    case TOKEN_LEA:
-      if (!handle_lea(lexer))
-        return false;
+    case SHAPE_CMPXCHG:
+      ok = handle_cmpxchg(tokens);
       break;
-    case TOKEN_CMPXCHG:
-      if (!handle_cmpxchg(lexer))
-        return false;
+    case SHAPE_ATM:
+      ok = handle_atm_inst(tokens);
       break;
-    default: {
-      detailed_message(file.c_str(), curr.line,
-                       "Cannot build a node from this.", NULL);
-      return false;
-    }
     }
-    curr = lexer.next_token();
+    if (!ok)
+      return false;
+    curr = tokens.next_token();
   }
   return true;
 }
 
-std::vector<masm::Node> masm::GPCParser::getNodes() { return std::move(nodes); }
+masm::NodeList masm::GPCParser::getNodes() { return std::move(nodes); }
+
+masm::TokenStream &masm::GPCParser::get_tokens() { return tokens; }
 
 masm::value_t masm::GPCParser::figure_out_type(token_t t) {
   value_t type;
@@ -724,16 +330,18 @@ masm::value_t masm::GPCParser::figure_out_type(token_t t) {
   return type;
 }
 
-bool masm::GPCParser::handle_simple_instructions(masm::node_t type) {
+bool masm::GPCParser::handle_simple_instructions(Token inst,
+                                                 masm::node_t type) {
   Node n;
+  n.loc = {src.get_id(), (uint32_t)inst.line};
   n.type = type;
   nodes.push_back(std::move(n));
   return true;
 }
 
-bool masm::GPCParser::handle_include_directory(masm::Lexer &lexer) {
+bool masm::GPCParser::handle_include_directory(masm::TokenStream &tokens) {
   // The last token was the "include" keyword
-  Token path = lexer.next_token();
+  Token path = tokens.next_token();
   if (path.type != TOKEN_STRING) {
     detailed_message(file.c_str(), path.line,
                      "Expected a include string here got something else.",
@@ -741,16 +349,16 @@ bool masm::GPCParser::handle_include_directory(masm::Lexer &lexer) {
     return false;
   }
   Node node;
-  node.file = file;
+  node.loc = {src.get_id(), (uint32_t)path.line};
   node.type = INCLUDE_DIR;
-  node.node = std::make_unique<NodeIncDir>();
-  ((NodeIncDir *)node.node.get())->path_included = path.value;
+  new (&node.node) NodeIncDir();
+  ((NodeIncDir *)&node.node)->path_included = path.value;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_const_definition(Lexer &lexer) {
-  Token const_name = lexer.next_token(), const_value;
+bool masm::GPCParser::handle_const_definition(TokenStream &tokens) {
+  Token const_name = tokens.next_token(), const_value;
 
   if (const_name.type != TOKEN_IDENTIFIER) {
     detailed_message(
@@ -759,7 +367,7 @@ bool masm::GPCParser::handle_const_definition(Lexer &lexer) {
     return false;
   }
 
-  const_value = lexer.next_token();
+  const_value = tokens.next_token();
   value_t type = figure_out_type(const_value.type);
   if (type == VALUE_ERR) {
     detailed_message(file.c_str(), const_name.line,
@@ -768,19 +376,20 @@ bool masm::GPCParser::handle_const_definition(Lexer &lexer) {
   }
 
   Node node;
-  node.file = file;
+  node.loc = {src.get_id(), (uint32_t)const_name.line};
   node.type = CONST_DEF;
-  node.node = std::make_unique<NodeConstDef>();
-  NodeConstDef *n = (NodeConstDef *)node.node.get();
-  n->const_name = const_name.value;
+  new (&node.node) NodeConstDef();
+  NodeConstDef *n = (NodeConstDef *)&node.node;
+  n->const_name = const_name.id;
   n->const_value = const_value.value;
+  n->lit = const_value.lit;
   n->type = type;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_variable_defn(Lexer &lexer, Token name) {
-  Token colon = lexer.next_token(), type = lexer.peek_token();
+bool masm::GPCParser::handle_variable_defn(TokenStream &tokens, Token name) {
+  Token colon = tokens.next_token(), type = tokens.peek_token();
   if (colon.type != TOKEN_COLON) {
     detailed_message(file.c_str(), colon.line,
                      "Expected ':' after identifier name..", NULL);
@@ -793,12 +402,12 @@ bool masm::GPCParser::handle_variable_defn(Lexer &lexer, Token name) {
   case TOKEN_DD:
   case TOKEN_DQ:
   case TOKEN_DP:
-    return handle_dX(lexer, name);
+    return handle_dX(tokens, name);
   case TOKEN_DS:
-    return handle_ds(lexer, name);
+    return handle_ds(tokens, name);
   case TOKEN_DF:
   case TOKEN_DLF:
-    return handle_df_dlf(lexer, name);
+    return handle_df_dlf(tokens, name);
   case TOKEN_RESB:
   case TOKEN_RESW:
   case TOKEN_RESD:
@@ -806,7 +415,7 @@ bool masm::GPCParser::handle_variable_defn(Lexer &lexer, Token name) {
   case TOKEN_RESP:
   case TOKEN_RESF:
   case TOKEN_RESLF:
-    return handle_resX(lexer, name);
+    return handle_resX(tokens, name);
   default:
     return handle_label(name);
   }
@@ -815,18 +424,17 @@ bool masm::GPCParser::handle_variable_defn(Lexer &lexer, Token name) {
 
 bool masm::GPCParser::handle_label(Token name) {
   Node node;
-  node.file = file;
+  node.loc = {src.get_id(), (uint32_t)name.line};
   node.type = NODE_LABEL;
-  node.node = std::make_unique<NodeLabel>();
-  node.line = name.line;
-  ((NodeLabel *)node.node.get())->name = name.value;
+  new (&node.node) NodeLabel();
+  ((NodeLabel *)&node.node)->name = name.id;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_dX(Lexer &lexer, Token name) {
-  Token type = lexer.next_token();
-  Token value = lexer.next_token();
+bool masm::GPCParser::handle_dX(TokenStream &tokens, Token name) {
+  Token type = tokens.next_token();
+  Token value = tokens.next_token();
   value_t t = figure_out_type(value.type);
   if (type.type == TOKEN_DP && t != VALUE_IDEN) {
     detailed_message(file.c_str(), value.line,
@@ -838,25 +446,26 @@ bool masm::GPCParser::handle_dX(Lexer &lexer, Token name) {
     return false;
   }
   Node node;
-  node.file = file;
-  node.line = name.line;
+  node.loc = {src.get_id(), (uint32_t)name.line};
   node.type = (type.type == TOKEN_DB)   ? NODE_DB
               : (type.type == TOKEN_DW) ? NODE_DW
               : (type.type == TOKEN_DD) ? NODE_DD
               : (type.type == TOKEN_DQ) ? NODE_DQ
                                         : NODE_DP;
-  node.node = std::make_unique<NodeDB>();
-  NodeDB *n = (NodeDB *)node.node.get();
-  n->name = name.value;
+  new (&node.node) NodeDB();
+  NodeDB *n = (NodeDB *)&node.node;
+  n->name = name.id;
   n->value = value.value;
+  n->value_id = value.id;
+  n->lit = value.lit;
   n->type = t;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_ds(Lexer &lexer, Token name) {
-  lexer.next_token();
-  Token value = lexer.next_token();
+bool masm::GPCParser::handle_ds(TokenStream &tokens, Token name) {
+  tokens.next_token();
+  Token value = tokens.next_token();
   value_t t = figure_out_type(value.type);
   if (t != VALUE_STRING && t != VALUE_IDEN) {
     detailed_message(file.c_str(), value.line,
@@ -864,21 +473,22 @@ bool masm::GPCParser::handle_ds(Lexer &lexer, Token name) {
     return false;
   }
   Node node;
-  node.file = file;
-  node.line = name.line;
+  node.loc = {src.get_id(), (uint32_t)name.line};
   node.type = NODE_DS;
-  node.node = std::make_unique<NodeDS>();
-  NodeDS *n = (NodeDS *)node.node.get();
-  n->name = name.value;
+  new (&node.node) NodeDS();
+  NodeDS *n = (NodeDS *)&node.node;
+  n->name = name.id;
   n->value = value.value;
+  n->value_id = value.id;
+  n->lit = value.lit;
   n->type = t;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_df_dlf(Lexer &lexer, Token name) {
-  Token type = lexer.next_token();
-  Token value = lexer.next_token();
+bool masm::GPCParser::handle_df_dlf(TokenStream &tokens, Token name) {
+  Token type = tokens.next_token();
+  Token value = tokens.next_token();
   value_t t = figure_out_type(value.type);
   if (t != VALUE_INTEGER && t != VALUE_FLOAT && t != VALUE_IDEN) {
     detailed_message(file.c_str(), value.line,
@@ -886,21 +496,22 @@ bool masm::GPCParser::handle_df_dlf(Lexer &lexer, Token name) {
     return false;
   }
   Node node;
-  node.file = file;
-  node.line = name.line;
+  node.loc = {src.get_id(), (uint32_t)name.line};
   node.type = (type.type == TOKEN_DF) ? NODE_DF : NODE_DLF;
-  node.node = std::make_unique<NodeDF>();
-  NodeDF *n = (NodeDF *)node.node.get();
-  n->name = name.value;
+  new (&node.node) NodeDF();
+  NodeDF *n = (NodeDF *)&node.node;
+  n->name = name.id;
   n->value = value.value;
+  n->value_id = value.id;
+  n->lit = value.lit;
   n->type = t;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_resX(Lexer &lexer, Token name) {
-  Token type = lexer.next_token();
-  Token value = lexer.next_token();
+bool masm::GPCParser::handle_resX(TokenStream &tokens, Token name) {
+  Token type = tokens.next_token();
+  Token value = tokens.next_token();
   value_t t = figure_out_type(value.type);
   if (t == VALUE_FLOAT || t == VALUE_ERR || t == VALUE_STRING) {
     detailed_message(file.c_str(), value.line,
@@ -908,8 +519,7 @@ bool masm::GPCParser::handle_resX(Lexer &lexer, Token name) {
     return false;
   }
   Node node;
-  node.file = file;
-  node.line = name.line;
+  node.loc = {src.get_id(), (uint32_t)name.line};
   node.type = (type.type == TOKEN_RESB)   ? NODE_RESB
               : (type.type == TOKEN_RESW) ? NODE_RESW
               : (type.type == TOKEN_RESD) ? NODE_RESD
@@ -917,26 +527,29 @@ bool masm::GPCParser::handle_resX(Lexer &lexer, Token name) {
               : (type.type == TOKEN_RESF) ? NODE_RESF
               : (type.type == TOKEN_RESP) ? NODE_RESP
                                           : NODE_RESLF;
-  node.node = std::make_unique<NodeRESB>();
-  NodeRESB *n = (NodeRESB *)node.node.get();
-  n->name = name.value;
+  new (&node.node) NodeRESB();
+  NodeRESB *n = (NodeRESB *)&node.node;
+  n->name = name.id;
   n->value = value.value;
+  n->value_id = value.id;
+  n->lit = value.lit;
   n->type = t;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_instructions_with_reg_reg_or_reg_imm(Lexer &lexer,
+bool masm::GPCParser::handle_instructions_with_reg_reg_or_reg_imm(TokenStream &tokens,
                                                                   Token inst,
                                                                   node_t t) {
   node_t type = t;
   token_t first, second;
-  std::string imm; // for immediate
+  uint32_t imm = NO_ID; // for identifiers
+  Literal lit;
 
   bool is_reg = false;
 
   // The first operand
-  Token operand = lexer.next_token();
+  Token operand = tokens.next_token();
   if (!(operand.type >= R0 && operand.type <= ACC)) {
     detailed_message(file.c_str(), inst.line,
                      "GPC: Expected a register as first operand here.", NULL);
@@ -944,7 +557,7 @@ bool masm::GPCParser::handle_instructions_with_reg_reg_or_reg_imm(Lexer &lexer,
   }
 
   first = operand.type;
-  operand = lexer.next_token();
+  operand = tokens.next_token();
 
   value_t val_type = figure_out_type(operand.type);
 
@@ -957,7 +570,8 @@ bool masm::GPCParser::handle_instructions_with_reg_reg_or_reg_imm(Lexer &lexer,
                        NULL);
       return false;
     } else {
-      imm = operand.value;
+      imm = operand.id;
+      lit = operand.lit;
     }
   } else {
     is_reg = true;
@@ -967,17 +581,17 @@ bool masm::GPCParser::handle_instructions_with_reg_reg_or_reg_imm(Lexer &lexer,
 
   Node node;
   node.type = type;
-  node.file = file;
-  node.line = inst.line;
+  node.loc = {src.get_id(), (uint32_t)inst.line};
   if (is_reg) {
-    node.node = std::make_unique<NodeRegReg>();
-    NodeRegReg *n = (NodeRegReg *)node.node.get();
+    new (&node.node) NodeRegReg();
+    NodeRegReg *n = (NodeRegReg *)&node.node;
     n->r1 = first;
     n->r2 = second;
   } else {
-    node.node = std::make_unique<NodeRegrImm>();
-    NodeRegrImm *n = (NodeRegrImm *)node.node.get();
-    n->immediate = imm;
+    new (&node.node) NodeRegrImm();
+    NodeRegrImm *n = (NodeRegrImm *)&node.node;
+    n->name = imm;
+    n->lit = lit;
     n->regr = first;
     n->type = val_type;
   }
@@ -987,34 +601,33 @@ bool masm::GPCParser::handle_instructions_with_reg_reg_or_reg_imm(Lexer &lexer,
   return true;
 }
 
-bool masm::GPCParser::handle_instructions_with_reg(Lexer &lexer, node_t t) {
-  Token regr = lexer.next_token();
+bool masm::GPCParser::handle_instructions_with_reg(TokenStream &tokens, node_t t) {
+  Token regr = tokens.next_token();
   if (!(regr.type >= R0 && regr.type <= ACC)) {
     detailed_message(file.c_str(), regr.line,
                      "GPC: Expected a register as operand here.", NULL);
     return false;
   }
   Node node;
-  node.file = file;
-  node.line = regr.line;
+  node.loc = {src.get_id(), (uint32_t)regr.line};
   node.type = t;
-  node.node = std::make_unique<NodeReg>();
-  NodeReg *n = (NodeReg *)node.node.get();
+  new (&node.node) NodeReg();
+  NodeReg *n = (NodeReg *)&node.node;
   n->reg = regr.type;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_instructions_with_reg_imm(Lexer &lexer,
+bool masm::GPCParser::handle_instructions_with_reg_imm(TokenStream &tokens,
                                                        node_t type) {
-  Token reg1 = lexer.next_token();
+  Token reg1 = tokens.next_token();
   if (!(reg1.type >= R0 && reg1.type <= ACC)) {
     detailed_message(file.c_str(), reg1.line,
                      "GPC: Expected a register as first operand here.", NULL);
     return false;
   }
 
-  Token oper2 = lexer.next_token();
+  Token oper2 = tokens.next_token();
   value_t res = figure_out_type(oper2.type);
   if (res == VALUE_ERR || res == VALUE_STRING) {
     detailed_message(file.c_str(), reg1.line,
@@ -1023,20 +636,20 @@ bool masm::GPCParser::handle_instructions_with_reg_imm(Lexer &lexer,
     return false;
   }
   Node node;
-  node.file = file;
-  node.line = reg1.line;
+  node.loc = {src.get_id(), (uint32_t)reg1.line};
   node.type = type;
-  node.node = std::make_unique<NodeRegrImm>();
-  NodeRegrImm *n = (NodeRegrImm *)node.node.get();
+  new (&node.node) NodeRegrImm();
+  NodeRegrImm *n = (NodeRegrImm *)&node.node;
   n->regr = reg1.type;
-  n->immediate = oper2.value;
+  n->name = oper2.id;
+  n->lit = oper2.lit;
   n->type = res;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_instructions_with_imm(Lexer &lexer, node_t type) {
-  Token imm = lexer.next_token();
+bool masm::GPCParser::handle_instructions_with_imm(TokenStream &tokens, node_t type) {
+  Token imm = tokens.next_token();
   value_t val_type = figure_out_type(imm.type);
   if (val_type == VALUE_ERR || val_type == VALUE_STRING) {
     detailed_message(file.c_str(), imm.line,
@@ -1044,21 +657,21 @@ bool masm::GPCParser::handle_instructions_with_imm(Lexer &lexer, node_t type) {
     return false;
   }
   Node node;
-  node.file = file;
-  node.line = imm.line;
+  node.loc = {src.get_id(), (uint32_t)imm.line};
   node.type = type;
-  node.node = std::make_unique<NodeImm>();
-  NodeImm *n = (NodeImm *)node.node.get();
-  n->imm = imm.value;
+  new (&node.node) NodeImm();
+  NodeImm *n = (NodeImm *)&node.node;
+  n->name = imm.id;
+  n->lit = imm.lit;
   n->type = val_type;
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_instructions_with_imm_or_reg(Lexer &lexer,
+bool masm::GPCParser::handle_instructions_with_imm_or_reg(TokenStream &tokens,
                                                           node_t type) {
   bool is_reg = false;
-  Token oper = lexer.next_token();
+  Token oper = tokens.next_token();
   value_t val_type = figure_out_type(oper.type);
   if (oper.type >= R0 && oper.type <= ACC) {
     is_reg = true;
@@ -1070,27 +683,30 @@ bool masm::GPCParser::handle_instructions_with_imm_or_reg(Lexer &lexer,
     return false;
   }
   Node node;
-  node.file = file;
-  node.line = oper.line;
+  node.loc = {src.get_id(), (uint32_t)oper.line};
   node.type = type;
   if (is_reg) {
-    node.node = std::make_unique<NodeReg>();
-    NodeReg *n = (NodeReg *)node.node.get();
+    new (&node.node) NodeReg();
+    NodeReg *n = (NodeReg *)&node.node;
     n->reg = oper.type;
   } else {
-    node.node = std::make_unique<NodeImm>();
-    NodeImm *n = (NodeImm *)node.node.get();
-    n->imm = oper.value;
+    new (&node.node) NodeImm();
+    NodeImm *n = (NodeImm *)&node.node;
+    n->name = oper.id;
+    n->lit = oper.lit;
     n->type = val_type;
   }
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_lea(Lexer &lexer) {
+bool masm::GPCParser::handle_lea(TokenStream &tokens) {
   token_t r[4];
+  size_t line = 0;
   for (size_t i = 0; i < 4; i++) {
-    Token oper = lexer.next_token();
+    Token oper = tokens.next_token();
+    if (i == 0)
+      line = oper.line;
     if (oper.type >= R0 && oper.type <= ACC) {
       r[i] = oper.type;
     } else {
@@ -1100,8 +716,9 @@ bool masm::GPCParser::handle_lea(Lexer &lexer) {
     }
   }
   Node node;
-  node.node = std::make_unique<NodeLea>();
-  NodeLea *lea = (NodeLea *)node.node.get();
+  node.loc = {src.get_id(), (uint32_t)line};
+  new (&node.node) NodeLea();
+  NodeLea *lea = (NodeLea *)&node.node;
   lea->r1 = r[0];
   lea->r2 = r[1];
   lea->r3 = r[2];
@@ -1111,12 +728,12 @@ bool masm::GPCParser::handle_lea(Lexer &lexer) {
   return true;
 }
 
-bool masm::GPCParser::handle_cmpxchg(Lexer &lexer) {
+bool masm::GPCParser::handle_cmpxchg(TokenStream &tokens) {
   token_t r[2];
   Token oper;
   bool is_reg = false;
   for (size_t i = 0; i < 2; i++) {
-    oper = lexer.next_token();
+    oper = tokens.next_token();
     if (oper.type >= R0 && oper.type <= ACC) {
       r[i] = oper.type;
     } else {
@@ -1125,7 +742,7 @@ bool masm::GPCParser::handle_cmpxchg(Lexer &lexer) {
       return false;
     }
   }
-  oper = lexer.next_token();
+  oper = tokens.next_token();
   value_t val_type = figure_out_type(oper.type);
   if (oper.type >= R0 && oper.type <= ACC) {
     is_reg = true;
@@ -1138,67 +755,67 @@ bool masm::GPCParser::handle_cmpxchg(Lexer &lexer) {
   }
   Node node;
   if (is_reg) {
-    node.node = std::make_unique<NodeCMPXCHGReg>();
-    NodeCMPXCHGReg *cmpxchg = (NodeCMPXCHGReg *)node.node.get();
+    new (&node.node) NodeCMPXCHGReg();
+    NodeCMPXCHGReg *cmpxchg = (NodeCMPXCHGReg *)&node.node;
     cmpxchg->r1 = r[0];
     cmpxchg->r2 = r[1];
     cmpxchg->r3 = oper.type;
     node.type = NODE_CMPXCHG_REG;
   } else {
-    node.node = std::make_unique<NodeCMPXCHGImm>();
-    NodeCMPXCHGImm *cmpxchg = (NodeCMPXCHGImm *)node.node.get();
+    new (&node.node) NodeCMPXCHGImm();
+    NodeCMPXCHGImm *cmpxchg = (NodeCMPXCHGImm *)&node.node;
     cmpxchg->r1 = r[0];
     cmpxchg->r2 = r[1];
-    cmpxchg->imm = oper.value;
+    cmpxchg->name = oper.id;
+    cmpxchg->lit = oper.lit;
     cmpxchg->type = val_type;
     node.type = NODE_CMPXCHG_IMM;
   }
-  node.file = file;
-  node.line = oper.line;
+  node.loc = {src.get_id(), (uint32_t)oper.line};
   nodes.push_back(std::move(node));
   return true;
 }
 
-bool masm::GPCParser::handle_atm_inst(Lexer &lexer) {
-  Token curr = lexer.next_token();
+bool masm::GPCParser::handle_atm_inst(TokenStream &tokens) {
+  Token curr = tokens.next_token();
   switch (curr.type) {
   case TOKEN_LOADB:
-    if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
+    if (!handle_instructions_with_reg_reg_or_reg_imm(tokens, curr,
                                                      NODE_ATM_LOADB_IMM))
       return false;
     break;
   case TOKEN_LOADW:
-    if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
+    if (!handle_instructions_with_reg_reg_or_reg_imm(tokens, curr,
                                                      NODE_ATM_LOADW_IMM))
       return false;
     break;
   case TOKEN_LOADD:
-    if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
+    if (!handle_instructions_with_reg_reg_or_reg_imm(tokens, curr,
                                                      NODE_ATM_LOADD_IMM))
       return false;
     break;
   case TOKEN_LOADQ:
-    if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
+    if (!handle_instructions_with_reg_reg_or_reg_imm(tokens, curr,
                                                      NODE_ATM_LOADQ_IMM))
       return false;
     break;
   case TOKEN_STOREB:
-    if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
+    if (!handle_instructions_with_reg_reg_or_reg_imm(tokens, curr,
                                                      NODE_ATM_STOREB_IMM))
       return false;
     break;
   case TOKEN_STOREW:
-    if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
+    if (!handle_instructions_with_reg_reg_or_reg_imm(tokens, curr,
                                                      NODE_ATM_STOREW_IMM))
       return false;
     break;
   case TOKEN_STORED:
-    if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
+    if (!handle_instructions_with_reg_reg_or_reg_imm(tokens, curr,
                                                      NODE_ATM_STORED_IMM))
       return false;
     break;
   case TOKEN_STOREQ:
-    if (!handle_instructions_with_reg_reg_or_reg_imm(lexer, curr,
+    if (!handle_instructions_with_reg_reg_or_reg_imm(tokens, curr,
                                                      NODE_ATM_STOREQ_IMM))
       return false;
     break;
@@ -1212,17 +829,17 @@ bool masm::GPCParser::handle_atm_inst(Lexer &lexer) {
   return true;
 }
 
-bool masm::GPCParser::handle_instructions_with_reg_reg(Lexer &lexer,
+bool masm::GPCParser::handle_instructions_with_reg_reg(TokenStream &tokens,
                                                        node_t type) {
   token_t r1, r2;
-  Token oper = lexer.next_token();
+  Token oper = tokens.next_token();
   if (!(oper.type >= R0 && oper.type <= ACC)) {
     detailed_message(file.c_str(), oper.line,
                      "GPC: Expected register as first operand", NULL);
     return false;
   }
   r1 = oper.type;
-  oper = lexer.next_token();
+  oper = tokens.next_token();
   if (!(oper.type >= R0 && oper.type <= ACC)) {
     detailed_message(file.c_str(), oper.line,
                      "GPC: Expected register as second operand", NULL);
@@ -1231,9 +848,10 @@ bool masm::GPCParser::handle_instructions_with_reg_reg(Lexer &lexer,
   r2 = oper.type;
 
   Node node;
+  node.loc = {src.get_id(), (uint32_t)oper.line};
   node.type = type;
-  node.node = std::make_unique<NodeRegReg>();
-  NodeRegReg *r = (NodeRegReg *)node.node.get();
+  new (&node.node) NodeRegReg();
+  NodeRegReg *r = (NodeRegReg *)&node.node;
   r->r1 = r1;
   r->r2 = r2;
   nodes.push_back(std::move(node));
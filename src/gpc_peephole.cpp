@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <gpc_gen_base.hpp>
+#include <gpc_peephole.hpp>
+#include <iterator>
+
+namespace masm {
+namespace peephole_rules {
+// The next instruction after 'at'(nodes.size() if none); labels, data and
+// what was dropped are skipped
+static size_t next_instruction(NodeList &nodes, std::vector<bool> &dropped,
+                               size_t at) {
+  for (at++; at < nodes.size(); at++) {
+    if (!dropped[at] && isa_entry(nodes[at].type).layout != LAYOUT_NO_CODE)
+      break;
+  }
+  return at;
+}
+
+static bool reads_flags(node_t t) {
+  return (t >= NODE_JNZ && t <= NODE_JSE) ||
+         (t >= NODE_RETNZ && t <= NODE_RETSE) ||
+         (t >= NODE_MOVNZ && t <= NODE_MOVSE);
+}
+
+// Whether the flags set by the node at 'at' are overwritten before
+// anything could read them. Only the straight line code after it is
+// looked at; wherever control goes elsewhere they are assumed to be read.
+static bool flags_unused_after(NodeList &nodes, std::vector<bool> &dropped,
+                               size_t at) {
+  for (at = next_instruction(nodes, dropped, at); at < nodes.size();
+       at = next_instruction(nodes, dropped, at)) {
+    node_t t = nodes[at].type;
+    if (reads_flags(t))
+      return false;
+    switch (t) {
+    case NODE_CMP_IMM:
+    case NODE_CMP_REGR:
+    case NODE_FCMP:
+    case NODE_FCMP32:
+    case NODE_CFLAGS:
+    case NODE_HALT:
+      return true;
+    case NODE_JMP_IMM:
+    case NODE_JMP_REG:
+    case NODE_CALL_IMM:
+    case NODE_CALL_REG:
+    case NODE_RET:
+    case NODE_LOOP:
+    case NODE_INT:
+      return false;
+    default:
+      break;
+    }
+  }
+  return false;
+}
+
+static bool immediate_is(Node &n, uint64_t value) {
+  NodeRegrImm *imm = (NodeRegrImm *)&n.node;
+  if (imm->is_var || imm->lit.is_float)
+    return false;
+  switch (imm->type) {
+  case VALUE_HEX:
+  case VALUE_OCTAL:
+  case VALUE_BINARY:
+  case VALUE_INTEGER:
+    return imm->lit.u == value;
+  default:
+    return false;
+  }
+}
+
+/* The conditions on the operands; 'next' is the instruction after 'at' */
+
+static bool same_register(NodeList &nodes, size_t at, size_t next) {
+  return ((NodeReg *)&nodes[at].node)->reg ==
+         ((NodeReg *)&nodes[next].node)->reg;
+}
+
+static bool immediate_is_0(NodeList &nodes, size_t at, size_t) {
+  return immediate_is(nodes[at], 0);
+}
+
+static bool immediate_is_1(NodeList &nodes, size_t at, size_t) {
+  return immediate_is(nodes[at], 1);
+}
+
+static bool to_itself(NodeList &nodes, size_t at, size_t) {
+  NodeRegReg *rr = (NodeRegReg *)&nodes[at].node;
+  return rr->r1 == rr->r2;
+}
+
+static bool to_next_instruction(NodeList &nodes, size_t at, size_t next) {
+  uint32_t target = ((NodeImm *)&nodes[at].node)->name;
+  for (size_t i = at + 1; i < next; i++) {
+    if (nodes[i].type == NODE_LABEL &&
+        ((NodeLabel *)&nodes[i].node)->name == target)
+      return true;
+  }
+  return false;
+}
+
+static bool always(NodeList &, size_t, size_t) { return true; }
+
+enum drop_t {
+  DROP_FIRST, // the instruction matched
+  DROP_BOTH,  // and the one after it
+};
+
+struct Rule {
+  const char *name; // for --stats
+  node_t first[4];  // what it applies to(NODE_COUNT for the unused)
+  node_t second;    // the instruction right after; NODE_COUNT for any
+  bool (*when)(NodeList &nodes, size_t at, size_t next);
+  bool sets_flags; // only dropped if the flags it sets are never read
+  drop_t drop;
+};
+
+static const Rule rules[] = {
+    {"push and pop of the same register",
+     {NODE_PUSH, NODE_COUNT, NODE_COUNT, NODE_COUNT},
+     NODE_POPQ_REG, same_register, false, DROP_BOTH},
+    {"add or subtract 0",
+     {NODE_ADD_IMM, NODE_SUB_IMM, NODE_IADD_IMM, NODE_ISUB_IMM},
+     NODE_COUNT, immediate_is_0, true, DROP_FIRST},
+    {"multiply or divide by 1",
+     {NODE_MUL_IMM, NODE_DIV_IMM, NODE_IMUL_IMM, NODE_IDIV_IMM},
+     NODE_COUNT, immediate_is_1, true, DROP_FIRST},
+    {"move to the same register",
+     {NODE_MOVQ, NODE_MOVEQ, NODE_COUNT, NODE_COUNT},
+     NODE_COUNT, to_itself, false, DROP_FIRST},
+    {"jump to the next instruction",
+     {NODE_JMP_IMM, NODE_COUNT, NODE_COUNT, NODE_COUNT},
+     NODE_COUNT, to_next_instruction, false, DROP_FIRST},
+    {"nop",
+     {NODE_NOP, NODE_COUNT, NODE_COUNT, NODE_COUNT},
+     NODE_COUNT, always, false, DROP_FIRST},
+};
+
+static constexpr size_t RULE_COUNT = sizeof(rules) / sizeof(rules[0]);
+
+static bool applies(const Rule &r, NodeList &nodes, std::vector<bool> &dropped,
+                    size_t at, size_t next) {
+  if (std::find(std::begin(r.first), std::end(r.first), nodes[at].type) ==
+      std::end(r.first))
+    return false;
+  if (r.second != NODE_COUNT) {
+    // Nothing may jump in between the two
+    if (next == nodes.size() || nodes[next].type != r.second)
+      return false;
+    for (size_t i = at + 1; i < next; i++) {
+      if (nodes[i].type == NODE_LABEL)
+        return false;
+    }
+  }
+  return r.when(nodes, at, next) &&
+         (!r.sets_flags || flags_unused_after(nodes, dropped, at));
+}
+}; // namespace peephole_rules
+}; // namespace masm
+
+void masm::peephole(NodeList &nodes, GenStats &stats) {
+  using namespace peephole_rules;
+  stats.peephole_hits.resize(RULE_COUNT);
+  for (size_t i = 0; i < RULE_COUNT; i++)
+    stats.peephole_hits[i].first = rules[i].name;
+
+  // Dropping an instruction can put two others next to each other that
+  // match, so this goes until nothing changes
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    std::vector<bool> dropped(nodes.size(), false);
+    for (size_t at = 0; at < nodes.size(); at++) {
+      if (dropped[at] || isa_entry(nodes[at].type).layout == LAYOUT_NO_CODE)
+        continue;
+      size_t next = next_instruction(nodes, dropped, at);
+      for (size_t i = 0; i < RULE_COUNT; i++) {
+        if (!applies(rules[i], nodes, dropped, at, next))
+          continue;
+        dropped[at] = true;
+        if (rules[i].drop == DROP_BOTH)
+          dropped[next] = true;
+        stats.peephole_hits[i].second++;
+        changed = true;
+        break;
+      }
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      if (!dropped[i])
+        nodes[kept++] = nodes[i];
+    }
+    nodes.erase(nodes.begin() + kept, nodes.end());
+  }
+}
@@ -0,0 +1,20 @@
+#include <interner.hpp>
+
+uint32_t masm::Interner::intern(std::string_view name) {
+  auto res = ids.find(name);
+  if (res != ids.end())
+    return res->second;
+  uint32_t id = names.size();
+  names.emplace_back(name);
+  ids.emplace(names.back(), id);
+  return id;
+}
+
+uint32_t masm::Interner::find(std::string_view name) {
+  auto res = ids.find(name);
+  return res == ids.end() ? NO_ID : res->second;
+}
+
+const std::string &masm::Interner::name(uint32_t id) { return names[id]; }
+
+size_t masm::Interner::size() { return names.size(); }
@@ -1,97 +1,103 @@
 #include <lexer.hpp>
 
-masm::Lexer::Lexer(std::string path, bool *err) {
-  std::fstream fd(path, std::ios::in);
-  if (!fd.is_open()) {
-    simple_message("Failed to OPEN file '%s'", path.c_str());
-    *err = false;
-    return;
+masm::Lexer::Lexer(SourceFile &source, Interner &interner)
+    : src(source), names(interner) {
+  iter = src.begin();
+  end = src.end();
+  file = src.get_path().string();
+  line = 1;
+}
+
+bool masm::Lexer::tokenize(TokenStream &tokens) {
+  if (src.length() >= UINT32_MAX) {
+    simple_message("The file '%s' is too large.", file.c_str());
+    return false;
   }
-  while (!fd.eof()) {
-    std::string tmp;
-    std::getline(fd, tmp);
-    stream += tmp + '\n';
+  tokens.set_source(&src, &names);
+  // a rough guess to avoid most of the re-allocations
+  tokens.reserve(src.length() / 4 + 1);
+  while (true) {
+    token_t t = next_token();
+    if (is_numeric_token(t))
+      tokens.push_number(t, tok_offset, tok_len, tok_line, tok_lit);
+    else
+      tokens.push(t, tok_offset, tok_len, tok_line);
+    if (t == TOKEN_EOF)
+      break;
+    if (t == TOKEN_ERROR) {
+      // The parser stops at the error anyway
+      tokens.push(TOKEN_EOF, 0, 0, line);
+      break;
+    }
   }
-
-  iter = stream.begin();
-  *err = true;
-  fd.close();
-  file = path;
-  line = 1;
+  return true;
 }
 
-masm::Token masm::Lexer::next_token() {
-  Token res;
-  std::string::iterator st, ed;
+masm::token_t masm::Lexer::next_token() {
+  token_t res;
+  const char *st;
 
-  while (isspace(*iter) || *iter == ';' || *iter == ',') {
-    if (*iter == ';') {
-      while (iter != stream.end() && *iter != '\n')
-        iter++;
-    } else {
-      if (*iter == '\n')
-        line++;
-      iter++;
-    }
+  while (true) {
+    iter = skip_blank(iter, end, line);
+    if (iter == end || *iter != ';')
+      break;
+    // comments run till the end of the line
+    iter = find_newline(iter, end);
   }
-  res.line = line;
-  if (iter == stream.end()) {
-    res.type = TOKEN_EOF;
+  tok_line = line;
+  tok_offset = iter - src.begin();
+  tok_len = 0;
+  if (iter == end) {
+    res = TOKEN_EOF;
   } else if (isalpha(*iter) || *iter == '_') {
     st = iter;
-    res.type = lex_identifier_or_token();
-    ed = iter;
-    if (res.type == TOKEN_IDENTIFIER)
-      res.value = std::string(st, ed);
+    res = lex_identifier_or_token();
+    if (res == TOKEN_IDENTIFIER) {
+      tok_len = iter - st;
+      tok_offset = names.intern(std::string_view(st, tok_len));
+    }
   } else if (*iter == '-' || (*iter >= '0' && *iter <= '9')) {
     st = iter;
     if (*iter == '-')
       iter++;
+    if (iter == end) {
+      detailed_message(file.c_str(), line, "Expected a number after '-'.",
+                       NULL);
+      return TOKEN_ERROR;
+    }
     std::pair<bool, token_t> num = lex_number();
     if (!num.first) {
-      res.type = TOKEN_ERROR;
+      res = TOKEN_ERROR;
     } else {
-      res.type = num.second;
-      ed = iter;
-      res.value = std::string(st, ed);
+      res = num.second;
+      tok_len = iter - st;
+      tok_lit = parse_literal(std::string_view(st, tok_len),
+                              res == TOKEN_HEX      ? 16
+                              : res == TOKEN_OCTAL  ? 8
+                              : res == TOKEN_BINARY ? 2
+                                                    : 10,
+                              res == TOKEN_FLOAT);
     }
   } else if (*iter == '"') {
-    std::pair<bool, std::string> str = lex_string();
-    if (!str.first) {
-      res.type = TOKEN_ERROR;
-    } else {
-      res.type = TOKEN_STRING;
-      res.value = str.second;
-    }
+    res = lex_string() ? TOKEN_STRING : TOKEN_ERROR;
   } else {
     // could be an operator
-    st = iter;
     std::pair<bool, token_t> oper = lex_operators();
     if (!oper.first) {
       detailed_message(file.c_str(), line,
                        "Couldn't build a token from this '%c'.", *iter);
-      res.type = TOKEN_ERROR;
+      res = TOKEN_ERROR;
     } else {
-      res.type = oper.second;
-      ed = iter;
+      res = oper.second;
     }
   }
 
   return res;
 }
 
-masm::Token masm::Lexer::peek_token() {
-  std::string::iterator curr = iter;
-  size_t l = line;
-  Token res = next_token();
-  iter = curr;
-  line = l;
-  return res;
-}
-
 std::pair<bool, masm::token_t> masm::Lexer::lex_number() {
   // 0x for hex, 0o for octal, 0b for binary
-  if (*iter == '0' && (iter + 1) != stream.end() && isalpha(*(iter + 1))) {
+  if (*iter == '0' && (iter + 1) != end && isalpha(*(iter + 1))) {
     iter++;
     switch (*iter) {
     case 'x':
@@ -115,7 +121,7 @@ std::pair<bool, masm::token_t> masm::Lexer::lex_number() {
 
 bool masm::Lexer::is_hexadecimal() {
   iter++;
-  while (iter != stream.end() &&
+  while (iter != end &&
          ((*iter >= '0' && *iter <= '9') || (*iter >= 'a' && *iter <= 'f')))
     iter++;
   return true;
@@ -123,21 +129,21 @@ bool masm::Lexer::is_hexadecimal() {
 
 bool masm::Lexer::is_octal() {
   iter++;
-  while (iter != stream.end() && *iter >= '0' && *iter <= '7')
+  while (iter != end && *iter >= '0' && *iter <= '7')
     iter++;
   return true;
 }
 
 bool masm::Lexer::is_binary() {
   iter++;
-  while (iter != stream.end() && (*iter == '0' || *iter == '1'))
+  while (iter != end && (*iter == '0' || *iter == '1'))
     iter++;
   return true;
 }
 
 bool masm::Lexer::is_float_or_double_or_integer() {
   dot_count = 0;
-  while (iter != stream.end() &&
+  while (iter != end &&
          ((*iter >= '0' && *iter <= '9') || *iter == '.')) {
     if (*iter == '.' && dot_count > 1) {
       detailed_message(file.c_str(), line,
@@ -152,75 +158,86 @@ bool masm::Lexer::is_float_or_double_or_integer() {
   return true;
 }
 
-std::pair<bool, std::string> masm::Lexer::lex_string() {
+bool masm::Lexer::lex_string() {
+  // Strings without escape sequences are handed out as they are in the
+  // source. Only the ones with escapes need a buffer of their own and even
+  // then, everything between the escapes is copied in one go.
   std::string str;
+  bool escaped = false;
   iter++;
+  const char *st = iter, *run = iter;
   bool end_found = false;
   while (true) {
-    if (iter == stream.end())
+    iter = find_string_special(iter, end, line);
+    if (iter == end)
       break;
-    if (*iter == '\n')
-      line++;
     if (*iter == '"') {
       end_found = true;
+      if (escaped)
+        str.append(run, iter - run);
       break;
-    } else {
-      if (*iter == '\\') {
-        iter++;
-        if (iter == stream.end()) {
-          detailed_message(
-              file.c_str(), line,
-              "Expected something after the escape sequence. Got nothing!",
-              NULL);
-          break;
-        }
-        switch (*iter) {
-        case 'n':
-          str += '\n';
-          break;
-        case 'r':
-          str += '\r';
-          break;
-        case 't':
-          str += '\t';
-          break;
-        case '\\':
-          str += '\\';
-          break;
-        case '0':
-          str += '\0';
-          break;
-        default:
-          str += '\\';
-          str += *iter;
-          break;
-        }
-      } else {
-        str += *iter;
-      }
-      iter++;
     }
+    // an escape sequence
+    str.append(run, iter - run);
+    escaped = true;
+    iter++;
+    if (iter == end) {
+      detailed_message(
+          file.c_str(), line,
+          "Expected something after the escape sequence. Got nothing!", NULL);
+      break;
+    }
+    switch (*iter) {
+    case 'n':
+      str += '\n';
+      break;
+    case 'r':
+      str += '\r';
+      break;
+    case 't':
+      str += '\t';
+      break;
+    case '\\':
+      str += '\\';
+      break;
+    case '0':
+      str += '\0';
+      break;
+    default:
+      str += '\\';
+      str += *iter;
+      break;
+    }
+    iter++;
+    run = iter;
   }
   if (!end_found) {
     detailed_message(file.c_str(), line,
                      "Expected STRING Termination but didn't found one.", NULL);
-    return std::make_pair(false, std::string());
+    return false;
+  }
+  if (escaped) {
+    tok_offset = src.keep_literal(str);
+    tok_len = str.length();
+  } else {
+    tok_offset = st - src.begin();
+    tok_len = iter - st;
   }
   iter++;
-  return std::make_pair(true, str);
+  return true;
 }
 
 masm::token_t masm::Lexer::lex_identifier_or_token() {
   token_t res;
-  std::string::iterator st = iter, ed;
+  const char *st = iter, *ed;
 
-  while (iter != stream.end() &&
+  while (iter != end &&
          (isalpha(*iter) || *iter == '_' || (*iter >= '0' && *iter <= '9'))) {
     iter++;
   }
   ed = iter;
-  std::string tok(st, ed);
-  std::pair<bool, token_t> lookup_res = belongs_to_keymap(tok);
+  std::pair<bool, token_t> lookup_res =
+      belongs_to_keymap(std::string_view(st, ed - st));
   if (lookup_res.first)
     res = lookup_res.second;
   else
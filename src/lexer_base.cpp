@@ -1,7 +1,269 @@
+#include <array>
+#include <cstdint>
 #include <lexer_base.hpp>
 
-std::pair<bool, masm::token_t> masm::belongs_to_keymap(std::string name) {
-  auto res = map.find(name);
-  return std::make_pair(res != map.end(),
-                        (res != map.end()) ? res->second : TOKEN_ERROR);
+namespace masm {
+struct Keyword {
+  std::string_view name;
+  token_t type;
+};
+
+// Every mnemonic, directive and register.
+static constexpr Keyword keywords[] = {
+    {"r0", R0},
+    {"r1", R1},
+    {"r2", R2},
+    {"r3", R3},
+    {"r4", R4},
+    {"r5", R5},
+    {"r6", R6},
+    {"r7", R7},
+    {"r8", R8},
+    {"r9", R9},
+    {"r10", R10},
+    {"r11", R11},
+    {"r12", R12},
+    {"sp", SP},
+    {"bp", BP},
+    {"acc", ACC},
+    {"include", TOKEN_INCLUDE},
+    {"define", TOKEN_DEFINE},
+    {"db", TOKEN_DB},
+    {"dw", TOKEN_DW},
+    {"dd", TOKEN_DD},
+    {"dq", TOKEN_DQ},
+    {"dp", TOKEN_DP},
+    {"df", TOKEN_DF},
+    {"ds", TOKEN_DS},
+    {"dlf", TOKEN_DLF},
+    {"resb", TOKEN_RESB},
+    {"resw", TOKEN_RESW},
+    {"resd", TOKEN_RESD},
+    {"resq", TOKEN_RESQ},
+    {"resp", TOKEN_RESP},
+    {"resf", TOKEN_RESF},
+    {"reslf", TOKEN_RESLF},
+    {"nop", TOKEN_NOP},
+    {"hlt", TOKEN_HALT},
+    {"add", TOKEN_ADD},
+    {"sub", TOKEN_SUB},
+    {"mul", TOKEN_MUL},
+    {"div", TOKEN_DIV},
+    {"mod", TOKEN_MOD},
+    {"iadd", TOKEN_IADD},
+    {"isub", TOKEN_ISUB},
+    {"imul", TOKEN_IMUL},
+    {"idiv", TOKEN_IDIV},
+    {"imod", TOKEN_IMOD},
+    {"fadd", TOKEN_FADD},
+    {"fsub", TOKEN_FSUB},
+    {"fmul", TOKEN_FMUL},
+    {"fdiv", TOKEN_FDIV},
+    {"fadd32", TOKEN_FADD32},
+    {"fsub32", TOKEN_FSUB32},
+    {"fmul32", TOKEN_FMUL32},
+    {"fdiv32", TOKEN_FDIV32},
+    {"and", TOKEN_AND},
+    {"or", TOKEN_OR},
+    {"xor", TOKEN_XOR},
+    {"shl", TOKEN_SHL},
+    {"shr", TOKEN_SHR},
+    {"cmp", TOKEN_CMP},
+    {"ret", TOKEN_RET},
+    {"retnz", TOKEN_RETNZ},
+    {"retz", TOKEN_RETZ},
+    {"retne", TOKEN_RETNE},
+    {"rete", TOKEN_RETE},
+    {"retnc", TOKEN_RETNC},
+    {"retc", TOKEN_RETC},
+    {"retno", TOKEN_RETNO},
+    {"retnn", TOKEN_RETNN},
+    {"retn", TOKEN_RETN},
+    {"reto", TOKEN_RETO},
+    {"retng", TOKEN_RETNG},
+    {"retg", TOKEN_RETG},
+    {"retns", TOKEN_RETNS},
+    {"rets", TOKEN_RETS},
+    {"retge", TOKEN_RETGE},
+    {"retse", TOKEN_RETSE},
+    {"pusha", TOKEN_PUSHA},
+    {"popa", TOKEN_POPA},
+    {"outr", TOKEN_OUTR},
+    {"uoutr", TOKEN_UOUTR},
+    {"cflags", TOKEN_CFLAGS},
+    {"reset", TOKEN_RESET},
+    {"inc", TOKEN_INC},
+    {"dec", TOKEN_DEC},
+    {"not", TOKEN_NOT},
+    {"mov", TOKEN_MOV},
+    {"movb", TOKEN_MOVB},
+    {"movw", TOKEN_MOVW},
+    {"movd", TOKEN_MOVD},
+    {"movq", TOKEN_MOVQ},
+    {"movf", TOKEN_MOVF},
+    {"movf32", TOKEN_MOVF32},
+    {"movsxb", TOKEN_MOVSXB},
+    {"movsxw", TOKEN_MOVSXW},
+    {"movsxd", TOKEN_MOVSXD},
+    {"excgb", TOKEN_EXCGB},
+    {"excgw", TOKEN_EXCGW},
+    {"excgd", TOKEN_EXCGD},
+    {"excgq", TOKEN_EXCGQ},
+    {"moveb", TOKEN_MOVEB},
+    {"movew", TOKEN_MOVEW},
+    {"moved", TOKEN_MOVED},
+    {"moveq", TOKEN_MOVEQ},
+    {"movnz", TOKEN_MOVNZ},
+    {"movz", TOKEN_MOVZ},
+    {"movne", TOKEN_MOVNE},
+    {"move", TOKEN_MOVE},
+    {"movnc", TOKEN_MOVNC},
+    {"movc", TOKEN_MOVC},
+    {"movno", TOKEN_MOVNO},
+    {"movo", TOKEN_MOVO},
+    {"movnn", TOKEN_MOVNN},
+    {"movn", TOKEN_MOVN},
+    {"movng", TOKEN_MOVNG},
+    {"movg", TOKEN_MOVG},
+    {"movns", TOKEN_MOVNS},
+    {"movs", TOKEN_MOVS},
+    {"movge", TOKEN_MOVGE},
+    {"movse", TOKEN_MOVSE},
+    {"jnz", TOKEN_JNZ},
+    {"jz", TOKEN_JZ},
+    {"jne", TOKEN_JNE},
+    {"je", TOKEN_JE},
+    {"jnc", TOKEN_JNC},
+    {"jc", TOKEN_JC},
+    {"jno", TOKEN_JNO},
+    {"jo", TOKEN_JO},
+    {"jnn", TOKEN_JNN},
+    {"jn", TOKEN_JN},
+    {"jng", TOKEN_JNG},
+    {"jg", TOKEN_JG},
+    {"jns", TOKEN_JNS},
+    {"js", TOKEN_JS},
+    {"jge", TOKEN_JGE},
+    {"jse", TOKEN_JSE},
+    {"int", TOKEN_INT},
+    {"jmp", TOKEN_JMP},
+    {"call", TOKEN_CALL},
+    {"pushb", TOKEN_PUSHB},
+    {"pushw", TOKEN_PUSHW},
+    {"pushd", TOKEN_PUSHD},
+    {"pushq", TOKEN_PUSHQ},
+    {"push", TOKEN_PUSH},
+    {"popb", TOKEN_POPB},
+    {"popw", TOKEN_POPW},
+    {"popd", TOKEN_POPD},
+    {"popq", TOKEN_POPQ},
+    {"loop", TOKEN_LOOP},
+    {"loadsb", TOKEN_LOADSB},
+    {"loadsw", TOKEN_LOADSW},
+    {"loadsd", TOKEN_LOADSD},
+    {"loadsq", TOKEN_LOADSQ},
+    {"storesb", TOKEN_STORESB},
+    {"storesw", TOKEN_STORESW},
+    {"storesd", TOKEN_STORESD},
+    {"storesq", TOKEN_STORESQ},
+    {"fcmp", TOKEN_FCMP},
+    {"fcmp32", TOKEN_FCMP32},
+    {"cin", TOKEN_CIN},
+    {"cout", TOKEN_COUT},
+    {"sin", TOKEN_SIN},
+    {"sout", TOKEN_SOUT},
+    {"in", TOKEN_IN},
+    {"out", TOKEN_OUT},
+    {"inw", TOKEN_INW},
+    {"outw", TOKEN_OUTW},
+    {"ind", TOKEN_IND},
+    {"outd", TOKEN_OUTD},
+    {"inq", TOKEN_INQ},
+    {"outq", TOKEN_OUTQ},
+    {"uin", TOKEN_UIN},
+    {"uout", TOKEN_UOUT},
+    {"uinw", TOKEN_UINW},
+    {"uoutw", TOKEN_UOUTW},
+    {"uind", TOKEN_UIND},
+    {"uoutd", TOKEN_UOUTD},
+    {"uinq", TOKEN_UINQ},
+    {"uoutq", TOKEN_UOUTQ},
+    {"inf", TOKEN_INF},
+    {"outf", TOKEN_OUTF},
+    {"inf32", TOKEN_INF32},
+    {"outf32", TOKEN_OUTF32},
+    {"loadb", TOKEN_LOADB},
+    {"loadw", TOKEN_LOADW},
+    {"loadd", TOKEN_LOADD},
+    {"loadq", TOKEN_LOADQ},
+    {"storeb", TOKEN_STOREB},
+    {"storew", TOKEN_STOREW},
+    {"stored", TOKEN_STORED},
+    {"storeq", TOKEN_STOREQ},
+    {"whdlr", TOKEN_WHDLR},
+    {"lea", TOKEN_LEA},
+    {"cmpxchg", TOKEN_CMPXCHG},
+    {"atm", TOKEN_ATM},
+};
+
+// The keywords are looked up through a perfect hash built at compile time:
+// a seed is searched for until every keyword lands in a slot of its own so
+// that a lookup is a single hash and a single comparison.
+namespace keymap {
+constexpr size_t KEYWORD_COUNT = sizeof(keywords) / sizeof(keywords[0]);
+constexpr size_t SLOT_COUNT = 4096; // must be a power of 2
+constexpr uint8_t EMPTY_SLOT = 0xFF;
+
+static_assert(KEYWORD_COUNT < EMPTY_SLOT, "Too many keywords for the keymap");
+
+constexpr uint32_t hash(std::string_view name, uint32_t seed) {
+  // FNV-1a
+  uint32_t h = 2166136261u ^ seed;
+  for (char c : name) {
+    h ^= (uint8_t)c;
+    h *= 16777619u;
+  }
+  return h ^ (h >> 16);
+}
+
+struct Table {
+  uint32_t seed = 0;
+  std::array<uint8_t, SLOT_COUNT> slots{};
+};
+
+constexpr Table build() {
+  Table t;
+  for (uint32_t seed = 1; seed < 100000; seed++) {
+    t.slots.fill(EMPTY_SLOT);
+    bool collided = false;
+    for (size_t i = 0; i < KEYWORD_COUNT && !collided; i++) {
+      uint8_t &slot =
+          t.slots[hash(keywords[i].name, seed) & (SLOT_COUNT - 1)];
+      if (slot != EMPTY_SLOT)
+        collided = true;
+      else
+        slot = i;
+    }
+    if (!collided) {
+      t.seed = seed;
+      return t;
+    }
+  }
+  return t; // seed 0: no perfect hash found
+}
+
+constexpr Table table = build();
+
+static_assert(table.seed != 0, "No perfect hash found for the keywords");
+}; // namespace keymap
+
+}; // namespace masm
+
+std::pair<bool, masm::token_t> masm::belongs_to_keymap(std::string_view name) {
+  uint8_t slot =
+      keymap::table.slots[keymap::hash(name, keymap::table.seed) &
+                          (keymap::SLOT_COUNT - 1)];
+  if (slot == keymap::EMPTY_SLOT || keywords[slot].name != name)
+    return std::make_pair(false, TOKEN_ERROR);
+  return std::make_pair(true, keywords[slot].type);
 }
@@ -0,0 +1,37 @@
+#include <cstdlib>
+#include <cstring>
+#include <literal.hpp>
+#include <string>
+
+uint64_t masm::Literal::bits(size_t len) const {
+  if (!is_float)
+    return u;
+  if (len == 8) {
+    uint64_t b;
+    std::memcpy(&b, &f64, sizeof(b));
+    return b;
+  }
+  uint32_t b;
+  std::memcpy(&b, &f32, sizeof(b));
+  return b;
+}
+
+masm::Literal masm::parse_literal(std::string_view text, uint8_t base,
+                                  bool is_float) {
+  Literal lit;
+  lit.base = base;
+  lit.is_float = is_float;
+  lit.negative = text.starts_with('-');
+  // the strto* family needs a terminated string
+  std::string digits(text);
+  if (is_float) {
+    lit.f64 = std::strtod(digits.c_str(), NULL);
+    lit.f32 = std::strtof(digits.c_str(), NULL);
+    return lit;
+  }
+  // strtoull understands 0x but not 0o and 0b
+  if (base == 8 || base == 2)
+    digits.erase(lit.negative ? 1 : 0, 2);
+  lit.u = std::strtoull(digits.c_str(), NULL, base);
+  return lit;
+}
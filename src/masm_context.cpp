@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <masm_context.hpp>
 
 masm::MasmContext::MasmContext(int argc, char **argv) {
@@ -38,6 +39,35 @@ bool masm::MasmContext::parse_cmd_options() {
       }
       i++;
       output_file = cmd_options[i];
+    } else if (cmd_options[i] == "--mmap") {
+      CMD.mmap = true;
+    } else if (cmd_options[i] == "--stats") {
+      CMD.stats = true;
+    } else if (cmd_options[i] == "--pack") {
+      gen_options.pack_data = true;
+    } else if (cmd_options[i] == "--map") {
+      CMD.map = true;
+    } else if (cmd_options[i] == "--shake") {
+      CMD.shake = true;
+    } else if (cmd_options[i] == "--peephole") {
+      gen_options.peephole = true;
+    } else if (cmd_options[i] == "--no-shorten") {
+      gen_options.shorten_immediates = false;
+    } else if (cmd_options[i] == "--relative") {
+      gen_options.relative_jumps = true;
+    } else if (cmd_options[i] == "--thread") {
+      gen_options.thread_jumps = true;
+    } else if (cmd_options[i] == "--dce") {
+      gen_options.dead_writes = true;
+    } else if (cmd_options[i] == "--cfg") {
+      if (!((i + 1) < cmd_options.size())) {
+        simple_message("Expected output path after --cfg but got EOF.", NULL);
+        return false;
+      }
+      i++;
+      cfg_file = cmd_options[i];
+    } else if (cmd_options[i] == "--no-isolate") {
+      gen_options.isolate_atomics = false;
     } else {
       simple_message("Unknown Option: %s", cmd_options[i].c_str());
       return false;
@@ -58,6 +88,108 @@ void masm::MasmContext::display_version() {
   simple_message("%s", VERSION.c_str());
 }
 
+void masm::MasmContext::display_stats() {
+  GenStats total;
+  size_t instructions = 0;
+  for (FileContext &c : contexts) {
+    const GenStats &s = c.get_stats();
+    total.strings_deduplicated += s.strings_deduplicated;
+    total.strings_tail_merged += s.strings_tail_merged;
+    total.string_bytes_saved += s.string_bytes_saved;
+    total.constants_merged += s.constants_merged;
+    total.constant_bytes_saved += s.constant_bytes_saved;
+    total.immediates_shortened += s.immediates_shortened;
+    total.dead_writes_removed += s.dead_writes_removed;
+    total.jumps_retargeted += s.jumps_retargeted;
+    total.jumps_folded += s.jumps_folded;
+    total.unreachable_removed += s.unreachable_removed;
+    total.peephole_hits.resize(s.peephole_hits.size());
+    for (size_t i = 0; i < s.peephole_hits.size(); i++) {
+      total.peephole_hits[i].first = s.peephole_hits[i].first;
+      total.peephole_hits[i].second += s.peephole_hits[i].second;
+    }
+    instructions += c.get_instructions().size();
+  }
+  simple_message("Statistics:\n"
+                 "  instructions:   %zu bytes\n"
+                 "  rodata section: %zu bytes\n"
+                 "  data section:   %zu bytes\n"
+                 "  string section: %zu bytes\n"
+                 "  bss section:    %zu bytes\n"
+                 "  string pooling: %zu duplicates, %zu tails merged, %zu "
+                 "bytes saved\n"
+                 "  constants:      %zu merged, %zu bytes saved\n"
+                 "  immediates:     %zu shortened, %zu bytes saved\n"
+                 "  dead writes:    %zu removed\n"
+                 "  jumps:          %zu retargeted, %zu folded, %zu "
+                 "unreachable instructions removed",
+                 instructions * 8, rodata.size(), data.size(), string.size(),
+                 details.bss_section_length, total.strings_deduplicated,
+                 total.strings_tail_merged, total.string_bytes_saved,
+                 total.constants_merged, total.constant_bytes_saved,
+                 total.immediates_shortened, total.immediates_shortened * 8,
+                 total.dead_writes_removed, total.jumps_retargeted,
+                 total.jumps_folded, total.unreachable_removed);
+  for (auto &hit : total.peephole_hits)
+    simple_message("  peephole:       %zu x %s", hit.second, hit.first);
+}
+
+void masm::MasmContext::display_shake_report(ShakeReport &report) {
+  uint64_t code = 0, vars = 0;
+  for (auto &p : report.procedures)
+    code += p.size;
+  for (auto &v : report.variables)
+    vars += v.size;
+  simple_message("Tree shaking removed %zu procedures(%lu bytes) and %zu "
+                 "variables(%lu bytes)",
+                 report.procedures.size(), (unsigned long)code,
+                 report.variables.size(), (unsigned long)vars);
+  for (auto &p : report.procedures)
+    simple_message("  procedure %-32s %lu bytes",
+                   p.name == NO_ID ? "(before the first label)"
+                                   : symtable.name(p.name).c_str(),
+                   (unsigned long)p.size);
+  for (auto &v : report.variables)
+    simple_message("  variable  %-32s %lu bytes",
+                   symtable.name(v.name).c_str(), (unsigned long)v.size);
+}
+
+void masm::MasmContext::display_layout() {
+  std::vector<LayoutItem> items;
+  for (FileContext &c : contexts)
+    c.collect_layout(items);
+  std::sort(items.begin(), items.end(),
+            [](const LayoutItem &a, const LayoutItem &b) {
+              return a.address < b.address ||
+                     (a.address == b.address && a.size > b.size);
+            });
+  uint64_t vars = rodata.size(), strings = vars + data.size(),
+           bss = strings + string.size();
+  auto section = [&](uint64_t addr) {
+    return addr < vars      ? "rodata"
+           : addr < strings ? "data"
+           : addr < bss     ? "string"
+                            : "bss";
+  };
+  uint64_t end = 0; // of what was printed so far
+  simple_message("Layout:\n  %-18s %-8s %-7s %s", "ADDRESS", "SIZE",
+                 "SECTION", "NAME");
+  for (LayoutItem &i : items) {
+    // one row of padding per section it is in
+    for (uint64_t at : {vars, strings, bss, i.address}) {
+      if (at <= end || at > i.address)
+        continue;
+      simple_message("  0x%016lx %-8lu %-7s (padding)", (unsigned long)end,
+                     (unsigned long)(at - end), section(end));
+      end = at;
+    }
+    simple_message("  0x%016lx %-8lu %-7s %s", (unsigned long)i.address,
+                   (unsigned long)i.size, section(i.address),
+                   symtable.name(i.name).c_str());
+    end = std::max(end, i.address + i.size);
+  }
+}
+
 bool masm::MasmContext::prepare_for_assembling() {
   include_paths.push_back("./");
   // more for the standard library
@@ -91,8 +223,8 @@ bool masm::MasmContext::prepare_for_assembling() {
 
   // We initialize all FileContext here
   for (auto path : input_files) {
-    FileContext cont(include_paths, CONSTANTS, LABELS, symtable,
-                     label_addresses, data_addresses, data, string, 0);
+    FileContext cont(include_paths, symtable, arena, files, rodata, data,
+                     string, gen_options, 0);
     if (!cont.file_prepare(path) || !cont.should_process_file())
       return false;
     if (is_already_used.find(cont.get_file_type()) != is_already_used.end()) {
@@ -133,6 +265,23 @@ bool masm::MasmContext::assemble() {
       return false;
   }
 
+  // Drop what main never reaches before anything gets an address
+  if (CMD.shake) {
+    ShakeReport report;
+    for (FileContext &c : contexts)
+      c.shake(report);
+    display_shake_report(report);
+  }
+
+  // Read only variables
+  // These come first so that the section starts at address 0 for the VM
+  // to map it shared.
+  for (FileContext &c : contexts) {
+    if (!c.gen_file_first_step_rodata_phase(d_address))
+      return false;
+    d_address = c.get_d_addr();
+  }
+
   // Generating variables
   for (FileContext &c : contexts) {
     if (!c.gen_file_first_step(d_address))
@@ -147,6 +296,16 @@ bool masm::MasmContext::assemble() {
     d_address = c.get_d_addr();
   }
 
+  // For reservations
+  // These come last so that the VM can simply zero fill everything after
+  // the strings.
+  bss_start = d_address;
+  for (FileContext &c : contexts) {
+    if (!c.gen_file_first_step_bss_phase(d_address))
+      return false;
+    d_address = c.get_d_addr();
+  }
+
   // For pointers
   for (FileContext &c : contexts) {
     if (!c.gen_file_first_step_third_phase(d_address))
@@ -164,23 +323,29 @@ bool masm::MasmContext::assemble() {
 }
 
 bool masm::MasmContext::prepare_for_emiting() {
+  details.rodata = rodata;
   details.data = data;
   details.output_file_path = output_file;
   details.string = string;
+  details.bss_section_length = d_address - bss_start;
+  details.mapped_output = CMD.mmap;
 
+  details.position_independent = true;
   for (auto &cont : contexts) {
     details.instructions.push_back(
         std::make_pair(cont.get_file_type(), cont.get_instructions()));
+    details.position_independent &= cont.is_position_independent();
   }
 
-  auto main_proc = label_addresses.find("main");
-  if (main_proc == label_addresses.end()) {
+  uint32_t main_proc = symtable.find("main");
+  if (main_proc == NO_ID || !symtable[main_proc].is_label) {
     simple_message(
         "Entry PROC not found. Expected a main procedure to be defined.", NULL);
     return false;
   }
 
-  details.entry_inst = contexts[0].get_ENTRY_INSTRUCTION(main_proc->second);
+  details.entry_inst = contexts[0].get_ENTRY_INSTRUCTION(
+      symtable[main_proc].label_address);
   return true;
 }
 
@@ -188,7 +353,19 @@ bool masm::MasmContext::emit() {
   Generator GENERATE(details);
   if (!GENERATE.pre_emission() || !GENERATE.emit_header() ||
       !GENERATE.emit_ITIT() || !GENERATE.emit_Instructions() ||
-      !GENERATE.emit_data_section() || !GENERATE.emit_string_section())
+      !GENERATE.emit_rodata_section() || !GENERATE.emit_data_section() ||
+      !GENERATE.emit_string_section() ||
+      !GENERATE.write_out())
     return false;
+  if (CMD.stats)
+    display_stats();
+  if (CMD.map)
+    display_layout();
+  if (!cfg_file.empty()) {
+    for (FileContext &c : contexts) {
+      if (!c.export_cfg(cfg_file))
+        return false;
+    }
+  }
   return true;
 }
@@ -1,7 +1,91 @@
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
 #include <output_gen.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+
+static_assert(sizeof(masm::Inst64) == 8);
+
+// The pieces are split into chunks of this size for the threads
+#define COPY_CHUNK_LEN (4 * 1048576)
+
+void masm::store_qwords(uint8_t *dst, const uint64_t *src, size_t count) {
+  if constexpr (std::endian::native == std::endian::little) {
+    std::memcpy(dst, src, count * 8);
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      uint64_t v = __builtin_bswap64(src[i]);
+      std::memcpy(dst + i * 8, &v, 8);
+    }
+  }
+}
 
 masm::Generator::Generator(GeneratorDetails &det) : details(det) {}
 
+masm::Generator::~Generator() {
+  if (image)
+    munmap(image, image_len);
+  if (fd != -1)
+    close(fd);
+  if (!temp_path.empty())
+    unlink(temp_path.c_str());
+}
+
+void masm::Generator::put(uint64_t value) {
+  uint8_t bytes[8];
+  store_qwords(bytes, &value, 1);
+  put(bytes, 8);
+}
+
+void masm::Generator::put(const uint8_t *bytes, size_t len) {
+  if (!pieces.empty() && !pieces.back().src)
+    pieces.back().len += len;
+  else
+    pieces.push_back(Piece{nullptr, small.size(), len, false});
+  small.insert(small.end(), bytes, bytes + len);
+}
+
+void masm::Generator::plan(const void *src, size_t len, bool qwords) {
+  if (len != 0)
+    pieces.push_back(Piece{(const uint8_t *)src, 0, len, qwords});
+}
+
+bool masm::Generator::map_image() {
+  std::string p = details.output_file_path + ".XXXXXX";
+  fd = mkstemp(p.data());
+  if (fd == -1) {
+    simple_message("Failed to create a temporary file for '%s': %s",
+                   details.output_file_path.c_str(), strerror(errno));
+    return false;
+  }
+  temp_path = p;
+  // mkstemp creates it as 0600; give it the permissions open() would have
+  mode_t mask = umask(0);
+  umask(mask);
+  fchmod(fd, 0666 & ~mask);
+  if (ftruncate(fd, image_len) == -1) {
+    simple_message("Failed to resize '%s': %s", temp_path.c_str(),
+                   strerror(errno));
+    return false;
+  }
+  void *m = mmap(NULL, image_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (m == MAP_FAILED) {
+    simple_message("Failed to map '%s': %s", temp_path.c_str(),
+                   strerror(errno));
+    return false;
+  }
+  image = (uint8_t *)m;
+  return true;
+}
+
 bool masm::Generator::pre_emission() {
   if (std::filesystem::is_directory(details.output_file_path)) {
     simple_message("Given output file: %s : is a directory that exists.",
@@ -9,74 +93,157 @@ bool masm::Generator::pre_emission() {
     return false;
   }
 
+  details.rodata_section_length = details.rodata.size();
   details.data_section_length = details.data.size();
   details.string_section_length = details.string.size();
   details.number_of_different_ISA_used = details.instructions.size();
 
-  file.open(details.output_file_path, std::ios::out | std::ios::binary);
-  return file.is_open();
+  // header, ITIT, the instructions(with the entry jump), read only data,
+  // data and strings
+  image_len = HEADER_LEN + details.number_of_different_ISA_used * ITIT_HEADER_LEN;
+  for (auto &I : details.instructions)
+    image_len += (I.second.size() + 1) * 8;
+  image_len += details.rodata_section_length + details.data_section_length +
+               details.string_section_length;
+  small.reserve(HEADER_LEN + details.number_of_different_ISA_used *
+                         (ITIT_HEADER_LEN + 8));
+
+  if (details.mapped_output)
+    return map_image();
+  fd = open(details.output_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+            0666);
+  return fd != -1;
 }
 
 bool masm::Generator::emit_header() {
-  file << 'b' << 'e' << 'b' << (unsigned char)(details.type) << (char)0
-       << (char)0 << (char)0 << (char)0;
-  Inst64 i;
-  i.whole_word = details.number_of_different_ISA_used * ITIT_HEADER_LEN;
-  file << i.bytes.b7 << i.bytes.b6 << i.bytes.b5 << i.bytes.b4 << i.bytes.b3
-       << i.bytes.b2 << i.bytes.b1 << i.bytes.b0;
-
-  i.whole_word = details.data_section_length;
-  file << i.bytes.b7 << i.bytes.b6 << i.bytes.b5 << i.bytes.b4 << i.bytes.b3
-       << i.bytes.b2 << i.bytes.b1 << i.bytes.b0;
-
-  i.whole_word = details.string_section_length;
-  file << i.bytes.b7 << i.bytes.b6 << i.bytes.b5 << i.bytes.b4 << i.bytes.b3
-       << i.bytes.b2 << i.bytes.b1 << i.bytes.b0;
+  const uint8_t magic[8] = {'b', 'e', 'b', (uint8_t)details.type,
+                            (uint8_t)details.position_independent, 0, 0, 0};
+  put(magic, 8);
+  put(details.number_of_different_ISA_used * ITIT_HEADER_LEN);
+  put(details.rodata_section_length);
+  put(details.data_section_length);
+  put(details.string_section_length);
+  put(details.bss_section_length);
 
   // For DIT, it is all 0 as Masm doesn't support Debug information yet.
-  file << (char)0 << (char)0 << (char)0 << (char)0 << (char)0 << (char)0
-       << (char)0 << (char)0;
+  put(0);
   return true;
 }
 
 bool masm::Generator::emit_ITIT() {
-  Inst64 i;
-  for (auto I : details.instructions) {
-    i.whole_word = (uint64_t)I.first;
-    file << i.bytes.b7 << i.bytes.b6 << i.bytes.b5 << i.bytes.b4 << i.bytes.b3
-         << i.bytes.b2 << i.bytes.b1 << i.bytes.b0;
-    i.whole_word = (I.second.size() + 1) * 8;
-    file << i.bytes.b7 << i.bytes.b6 << i.bytes.b5 << i.bytes.b4 << i.bytes.b3
-         << i.bytes.b2 << i.bytes.b1 << i.bytes.b0;
+  for (auto &I : details.instructions) {
+    put((uint64_t)I.first);
+    put((I.second.size() + 1) * 8);
   }
   return true;
 }
 
 bool masm::Generator::emit_Instructions() {
-  Inst64 bef = details.entry_inst;
-  for (auto I : details.instructions) {
-    file << bef.bytes.b7 << bef.bytes.b6 << bef.bytes.b5 << bef.bytes.b4
-         << bef.bytes.b3 << bef.bytes.b2 << bef.bytes.b1 << bef.bytes.b0;
-
-    for (auto i : I.second) {
-      file << i.bytes.b7 << i.bytes.b6 << i.bytes.b5 << i.bytes.b4 << i.bytes.b3
-           << i.bytes.b2 << i.bytes.b1 << i.bytes.b0;
-    }
-    bef.whole_word = 0;
+  uint64_t bef = details.entry_inst.whole_word;
+  for (auto &I : details.instructions) {
+    put(bef);
+    // Inst64 is nothing but a qword
+    plan(I.second.data(), I.second.size() * 8, true);
+    bef = 0;
   }
   return true;
 }
 
+bool masm::Generator::emit_rodata_section() {
+  plan(details.rodata.data(), details.rodata.size(), false);
+  return true;
+}
+
 bool masm::Generator::emit_data_section() {
-  for (auto i : details.data) {
-    file << i;
-  }
+  plan(details.data.data(), details.data.size(), false);
   return true;
 }
 
 bool masm::Generator::emit_string_section() {
-  for (auto i : details.string) {
-    file << i;
+  plan(details.string.data(), details.string.size(), false);
+  return true;
+}
+
+void masm::Generator::fill_image() {
+  std::vector<Piece> chunks; // 'at' is now the offset in the image
+  size_t at = 0;
+  for (Piece &p : pieces) {
+    const uint8_t *src = p.src ? p.src : small.data() + p.at;
+    // COPY_CHUNK_LEN is a multiple of 8 so no qword is split
+    for (size_t i = 0; i < p.len; i += COPY_CHUNK_LEN)
+      chunks.push_back(Piece{src + i, at + i,
+                             std::min<size_t>(COPY_CHUNK_LEN, p.len - i),
+                             p.qwords});
+    at += p.len;
+  }
+
+  std::atomic<size_t> next = 0;
+  auto worker = [&]() {
+    for (size_t i; (i = next.fetch_add(1)) < chunks.size();) {
+      Piece &c = chunks[i];
+      if (c.qwords)
+        store_qwords(image + c.at, (const uint64_t *)c.src, c.len / 8);
+      else
+        std::memcpy(image + c.at, c.src, c.len);
+    }
+  };
+  size_t threads = std::min<size_t>(std::thread::hardware_concurrency(),
+                                    chunks.size());
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < threads; i++)
+    workers.emplace_back(worker);
+  worker();
+  for (std::thread &t : workers)
+    t.join();
+}
+
+bool masm::Generator::write_pieces() {
+  std::vector<iovec> iov;
+  std::vector<std::unique_ptr<uint8_t[]>> swapped; // big endian hosts only
+  for (Piece &p : pieces) {
+    const uint8_t *src = p.src ? p.src : small.data() + p.at;
+    if (p.qwords && std::endian::native != std::endian::little) {
+      swapped.emplace_back(new uint8_t[p.len]);
+      store_qwords(swapped.back().get(), (const uint64_t *)src, p.len / 8);
+      src = swapped.back().get();
+    }
+    iov.push_back(iovec{(void *)src, p.len});
+  }
+
+  size_t first = 0;
+  while (first < iov.size()) {
+    int count = (int)std::min<size_t>(iov.size() - first, IOV_MAX);
+    ssize_t done = writev(fd, iov.data() + first, count);
+    if (done == -1) {
+      if (errno == EINTR)
+        continue;
+      simple_message("Failed to WRITE to '%s': %s",
+                     details.output_file_path.c_str(), strerror(errno));
+      return false;
+    }
+    // skip what was written, possibly stopping halfway through a piece
+    while (first < iov.size() && (size_t)done >= iov[first].iov_len)
+      done -= iov[first++].iov_len;
+    if (first < iov.size()) {
+      iov[first].iov_base = (uint8_t *)iov[first].iov_base + done;
+      iov[first].iov_len -= done;
+    }
+  }
+  return true;
+}
+
+bool masm::Generator::write_out() {
+  if (!details.mapped_output)
+    return write_pieces();
+
+  fill_image();
+  munmap(image, image_len);
+  image = nullptr;
+  if (rename(temp_path.c_str(), details.output_file_path.c_str()) == -1) {
+    simple_message("Failed to RENAME '%s' to '%s': %s", temp_path.c_str(),
+                   details.output_file_path.c_str(), strerror(errno));
+    return false;
   }
+  temp_path.clear();
   return true;
 }
@@ -0,0 +1,219 @@
+#include <cstring>
+#include <scan.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MASM_SCAN_X86
+#endif
+
+namespace masm {
+/* The portable versions. The vectorized ones also use these for the tail. */
+
+static inline bool is_blank(char c) {
+  // ' ', ',' and '\t' '\n' '\v' '\f' '\r'
+  return c == ' ' || c == ',' || (unsigned char)(c - '\t') <= 4;
+}
+
+static const char *skip_blank_portable(const char *iter, const char *end,
+                                       size_t &line) {
+  while (iter != end && is_blank(*iter)) {
+    if (*iter == '\n')
+      line++;
+    iter++;
+  }
+  return iter;
+}
+
+static const char *find_newline_portable(const char *iter, const char *end) {
+  const void *nl = std::memchr(iter, '\n', end - iter);
+  return nl ? (const char *)nl : end;
+}
+
+static const char *find_string_special_portable(const char *iter,
+                                                const char *end,
+                                                size_t &line) {
+  while (iter != end && *iter != '"' && *iter != '\\') {
+    if (*iter == '\n')
+      line++;
+    iter++;
+  }
+  return iter;
+}
+
+#ifdef MASM_SCAN_X86
+/* SSE2: 16 bytes at a time */
+
+__attribute__((target("sse2"))) static inline unsigned
+blank_mask_sse2(__m128i c) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i four = _mm_set1_epi8(4);
+  // '\t' to '\r' is a range: (c - '\t') <= 4 as unsigned
+  __m128i t = _mm_sub_epi8(c, tab);
+  __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(t, four), t);
+  __m128i blank = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(c, space), _mm_cmpeq_epi8(c, comma)), ctrl);
+  return (unsigned)_mm_movemask_epi8(blank);
+}
+
+__attribute__((target("sse2"))) static const char *
+skip_blank_sse2(const char *iter, const char *end, size_t &line) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  while (end - iter >= 16) {
+    __m128i c = _mm_loadu_si128((const __m128i *)iter);
+    unsigned others = ~blank_mask_sse2(c) & 0xFFFF;
+    unsigned nls = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(c, nl));
+    if (others) {
+      unsigned at = __builtin_ctz(others);
+      line += __builtin_popcount(nls & ((1u << at) - 1));
+      return iter + at;
+    }
+    line += __builtin_popcount(nls);
+    iter += 16;
+  }
+  return skip_blank_portable(iter, end, line);
+}
+
+__attribute__((target("sse2"))) static const char *
+find_newline_sse2(const char *iter, const char *end) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  while (end - iter >= 16) {
+    __m128i c = _mm_loadu_si128((const __m128i *)iter);
+    unsigned nls = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(c, nl));
+    if (nls)
+      return iter + __builtin_ctz(nls);
+    iter += 16;
+  }
+  return find_newline_portable(iter, end);
+}
+
+__attribute__((target("sse2"))) static const char *
+find_string_special_sse2(const char *iter, const char *end, size_t &line) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  const __m128i nl = _mm_set1_epi8('\n');
+  while (end - iter >= 16) {
+    __m128i c = _mm_loadu_si128((const __m128i *)iter);
+    unsigned special = (unsigned)_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, bslash)));
+    unsigned nls = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(c, nl));
+    if (special) {
+      unsigned at = __builtin_ctz(special);
+      line += __builtin_popcount(nls & ((1u << at) - 1));
+      return iter + at;
+    }
+    line += __builtin_popcount(nls);
+    iter += 16;
+  }
+  return find_string_special_portable(iter, end, line);
+}
+
+/* AVX2: 32 bytes at a time */
+
+__attribute__((target("avx2"))) static inline unsigned
+blank_mask_avx2(__m256i c) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i comma = _mm256_set1_epi8(',');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i four = _mm256_set1_epi8(4);
+  __m256i t = _mm256_sub_epi8(c, tab);
+  __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(t, four), t);
+  __m256i blank = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(c, space),
+                      _mm256_cmpeq_epi8(c, comma)),
+      ctrl);
+  return (unsigned)_mm256_movemask_epi8(blank);
+}
+
+__attribute__((target("avx2,popcnt"))) static const char *
+skip_blank_avx2(const char *iter, const char *end, size_t &line) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  while (end - iter >= 32) {
+    __m256i c = _mm256_loadu_si256((const __m256i *)iter);
+    unsigned others = ~blank_mask_avx2(c);
+    unsigned nls = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(c, nl));
+    if (others) {
+      unsigned at = __builtin_ctz(others);
+      line += __builtin_popcount(nls & ((1u << at) - 1));
+      return iter + at;
+    }
+    line += __builtin_popcount(nls);
+    iter += 32;
+  }
+  return skip_blank_sse2(iter, end, line);
+}
+
+__attribute__((target("avx2"))) static const char *
+find_newline_avx2(const char *iter, const char *end) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  while (end - iter >= 32) {
+    __m256i c = _mm256_loadu_si256((const __m256i *)iter);
+    unsigned nls = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(c, nl));
+    if (nls)
+      return iter + __builtin_ctz(nls);
+    iter += 32;
+  }
+  return find_newline_sse2(iter, end);
+}
+
+__attribute__((target("avx2,popcnt"))) static const char *
+find_string_special_avx2(const char *iter, const char *end, size_t &line) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i bslash = _mm256_set1_epi8('\\');
+  const __m256i nl = _mm256_set1_epi8('\n');
+  while (end - iter >= 32) {
+    __m256i c = _mm256_loadu_si256((const __m256i *)iter);
+    unsigned special = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(
+        _mm256_cmpeq_epi8(c, quote), _mm256_cmpeq_epi8(c, bslash)));
+    unsigned nls = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(c, nl));
+    if (special) {
+      unsigned at = __builtin_ctz(special);
+      line += __builtin_popcount(nls & ((1u << at) - 1));
+      return iter + at;
+    }
+    line += __builtin_popcount(nls);
+    iter += 32;
+  }
+  return find_string_special_sse2(iter, end, line);
+}
+#endif
+
+struct Scanner {
+  const char *name;
+  const char *(*skip_blank)(const char *, const char *, size_t &);
+  const char *(*find_newline)(const char *, const char *);
+  const char *(*find_string_special)(const char *, const char *, size_t &);
+};
+
+static Scanner pick_scanner() {
+#ifdef MASM_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return {"avx2", skip_blank_avx2, find_newline_avx2,
+            find_string_special_avx2};
+  if (__builtin_cpu_supports("sse2"))
+    return {"sse2", skip_blank_sse2, find_newline_sse2,
+            find_string_special_sse2};
+#endif
+  return {"portable", skip_blank_portable, find_newline_portable,
+          find_string_special_portable};
+}
+
+static const Scanner scanner = pick_scanner();
+}; // namespace masm
+
+const char *masm::skip_blank(const char *iter, const char *end, size_t &line) {
+  return scanner.skip_blank(iter, end, line);
+}
+
+const char *masm::find_newline(const char *iter, const char *end) {
+  return scanner.find_newline(iter, end);
+}
+
+const char *masm::find_string_special(const char *iter, const char *end,
+                                      size_t &line) {
+  return scanner.find_string_special(iter, end, line);
+}
+
+const char *masm::scan_implementation() { return scanner.name; }
@@ -0,0 +1,86 @@
+#include <fcntl.h>
+#include <fstream>
+#include <source_file.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+masm::SourceFile::SourceFile(std::filesystem::path p, uint32_t id)
+    : path(p), id(id) {}
+
+masm::SourceFile::~SourceFile() {
+  if (mapped)
+    munmap((void *)contents, size);
+}
+
+bool masm::SourceFile::open() {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    simple_message("Failed to OPEN file '%s'", path.c_str());
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m != MAP_FAILED) {
+      madvise(m, st.st_size, MADV_SEQUENTIAL);
+      contents = (const char *)m;
+      size = st.st_size;
+      mapped = true;
+      close(fd);
+      return true;
+    }
+  }
+  close(fd);
+
+  // Fallback: read the whole thing
+  std::ifstream fd_stream(path, std::ios::in | std::ios::binary);
+  if (!fd_stream.is_open()) {
+    simple_message("Failed to OPEN file '%s'", path.c_str());
+    return false;
+  }
+  buffer.assign(std::istreambuf_iterator<char>(fd_stream),
+                std::istreambuf_iterator<char>());
+  contents = buffer.data();
+  size = buffer.size();
+  return true;
+}
+
+const char *masm::SourceFile::begin() { return contents; }
+
+const char *masm::SourceFile::end() { return contents + size; }
+
+std::filesystem::path &masm::SourceFile::get_path() { return path; }
+
+uint32_t masm::SourceFile::get_id() { return id; }
+
+size_t masm::SourceFile::length() { return size; }
+
+uint32_t masm::SourceFile::keep_literal(std::string_view lit) {
+  uint32_t off = size + literals.length();
+  literals += lit;
+  return off;
+}
+
+std::string_view masm::SourceFile::view(uint32_t offset, uint32_t len) {
+  if (offset < size)
+    return std::string_view(contents + offset, len);
+  return std::string_view(literals.data() + (offset - size), len);
+}
+
+masm::SourceFile &masm::FileTable::add(std::filesystem::path p) {
+  files.push_back(std::make_unique<SourceFile>(p, (uint32_t)files.size()));
+  return *files.back();
+}
+
+masm::SourceFile &masm::FileTable::operator[](uint32_t id) {
+  return *files[id];
+}
+
+const char *masm::FileTable::path(uint32_t id) {
+  return files[id]->get_path().c_str();
+}
+
+const char *masm::FileTable::path(SourceLoc loc) { return path(loc.file); }
+
+size_t masm::FileTable::size() { return files.size(); }
@@ -1,23 +1,33 @@
 #include <iostream>
 #include <symboltable.hpp>
 
-void masm::SymbolTable::add_symbol(std::string name, Symbol value) {
-  table[name] = value;
+uint32_t masm::SymbolTable::intern(std::string_view name) {
+  return names.intern(name);
 }
 
-bool masm::SymbolTable::symbol_exists(std::string name) {
-  return find_symbol(name) != table.end();
+uint32_t masm::SymbolTable::find(std::string_view name) {
+  return names.find(name);
 }
 
-std::unordered_map<std::string, masm::Symbol>::iterator
-masm::SymbolTable::find_symbol(std::string name) {
-  return table.find(name);
+const std::string &masm::SymbolTable::name(uint32_t id) {
+  return names.name(id);
+}
+
+masm::Interner &masm::SymbolTable::get_interner() { return names; }
+
+masm::Symbol &masm::SymbolTable::operator[](uint32_t id) {
+  // The lexer interns names without touching the records
+  if (id >= symbols.size())
+    symbols.resize(names.size());
+  return symbols[id];
 }
 
 void masm::SymbolTable::list_symbols() {
-  for (auto sym : table) {
-    std::cout << "NAME: " << sym.first << '\n';
-    std::cout << "VALUE: " << sym.second.value << '\n';
-    std::cout << "TYPE: " << sym.second.type << "\n\n";
+  for (uint32_t i = 0; i < names.size(); i++) {
+    Symbol &sym = (*this)[i];
+    if (!sym.is_var)
+      continue;
+    std::cout << "NAME: " << names.name(i) << '\n';
+    std::cout << "TYPE: " << sym.type << "\n\n";
   }
 }
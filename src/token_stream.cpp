@@ -0,0 +1,64 @@
+#include <token_stream.hpp>
+
+void masm::TokenStream::set_source(SourceFile *source, Interner *interner) {
+  src = source;
+  names = interner;
+}
+
+void masm::TokenStream::reserve(size_t n) {
+  kinds.reserve(n);
+  offsets.reserve(n);
+  lengths.reserve(n);
+  lines.reserve(n);
+}
+
+void masm::TokenStream::push(token_t kind, uint32_t offset, uint32_t len,
+                             uint32_t line) {
+  kinds.push_back(kind);
+  offsets.push_back(offset);
+  lengths.push_back(len);
+  lines.push_back(line);
+}
+
+void masm::TokenStream::push_number(token_t kind, uint32_t offset,
+                                    uint32_t len, uint32_t line, Literal lit) {
+  push(kind, numbers.size(), len, line);
+  numbers.push_back({lit, offset});
+}
+
+size_t masm::TokenStream::size() { return kinds.size(); }
+
+masm::token_t masm::TokenStream::kind(size_t i) { return (token_t)kinds[i]; }
+
+masm::Token masm::TokenStream::at(size_t i) {
+  Token t;
+  t.type = (token_t)kinds[i];
+  if (is_numeric_token(t.type)) {
+    Number &num = numbers[offsets[i]];
+    t.value = src->view(num.offset, lengths[i]);
+    t.lit = num.lit;
+  } else if (t.type == TOKEN_IDENTIFIER) {
+    t.id = offsets[i];
+    t.value = names->name(t.id);
+  } else {
+    t.value = src->view(offsets[i], lengths[i]);
+  }
+  t.line = lines[i];
+  return t;
+}
+
+masm::Token masm::TokenStream::next_token() {
+  Token t = at(pos);
+  if (pos + 1 < kinds.size())
+    pos++;
+  return t;
+}
+
+masm::Token masm::TokenStream::peek_token() { return at(pos); }
+
+void masm::TokenStream::rewind() { pos = 0; }
+
+bool masm::is_numeric_token(token_t t) {
+  return t == TOKEN_INTEGER || t == TOKEN_HEX || t == TOKEN_OCTAL ||
+         t == TOKEN_BINARY || t == TOKEN_FLOAT;
+}